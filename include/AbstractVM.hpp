@@ -15,6 +15,10 @@
 
 // Type system
 #include "eOperandType.hpp"
+#include "eOpcode.hpp"
+#include "Arithmetic.hpp"
+#include "DumpFormat.hpp"
+#include "DumpQueue.hpp"
 #include "Int8.hpp"
 #include "Int16.hpp"
 #include "Int32.hpp"
@@ -29,11 +33,25 @@
 
 // Execution engine
 #include "VirtualMachine.hpp"
+#include "OperandBuffer.hpp"
+#include "BinaryReader.hpp"
+#include "BatchEngine.hpp"
+#include "SuperwordPass.hpp"
+#include "RegisterIR.hpp"
+#include "RegisterEngine.hpp"
+#include "ValueNumbering.hpp"
+#include "Channel.hpp"
+#include "Watcher.hpp"
 
 // Parsing
 #include "Token.hpp"
 #include "Lexer.hpp"
 #include "Parser.hpp"
+#include "ModuleCache.hpp"
+
+// Editor support
+#include "DocumentAnalysis.hpp"
+#include "LanguageServer.hpp"
 
 // Exceptions
 #include "AbstractVMException.hpp"
@@ -6,6 +6,7 @@
 #ifndef ABSTRACTVMEXCEPTION_HPP
 #define ABSTRACTVMEXCEPTION_HPP
 
+#include <cstdint>
 #include <exception>
 #include <string>
 
@@ -181,4 +182,121 @@ public:
     explicit NoExitException(const std::string& message);
 };
 
+/**
+ * @class InputException
+ * @brief Exception thrown when a read instruction cannot be satisfied.
+ *
+ * This exception is thrown when a 'read' instruction is executed without
+ * an input stream attached to the VM, or when the input stream does not
+ * contain enough bytes for the requested type.
+ */
+class InputException : public AbstractVMException {
+public:
+    explicit InputException(const std::string& message);
+};
+
+/**
+ * @class PlaceholderException
+ * @brief Exception thrown when a placeholder cannot be resolved.
+ *
+ * This exception is thrown when a program pushes a placeholder (such as
+ * `$1` or `$rate`) that has not been bound to a value, or when a value
+ * bound to a placeholder is not a valid number.
+ */
+class PlaceholderException : public AbstractVMException {
+public:
+    explicit PlaceholderException(const std::string& message);
+};
+
+/**
+ * @class ForkException
+ * @brief Exception thrown when fork and join do not match.
+ *
+ * This exception is thrown when a 'join' instruction is executed while no
+ * forked block is pending. Errors raised inside a forked block keep their
+ * own type and are raised by the matching 'join'.
+ */
+class ForkException : public AbstractVMException {
+public:
+    explicit ForkException(const std::string& message);
+};
+
+/**
+ * @class ChannelException
+ * @brief Exception thrown when a channel cannot be used.
+ *
+ * This exception is thrown when a 'send' or 'recv' instruction uses a
+ * channel whose other end has finished, or when a channel would get a
+ * second sender or receiver.
+ */
+class ChannelException : public AbstractVMException {
+public:
+    explicit ChannelException(const std::string& message);
+};
+
+/**
+ * @class SavepointException
+ * @brief Exception thrown when a savepoint is missing.
+ *
+ * This exception is thrown when a 'rollback' or 'commit' instruction is
+ * executed while no savepoint is active.
+ */
+class SavepointException : public AbstractVMException {
+public:
+    explicit SavepointException(const std::string& message);
+};
+
+/**
+ * @class OutputException
+ * @brief Exception thrown when a dump cannot be written.
+ *
+ * This exception is thrown when the file named by a 'dump' instruction
+ * cannot be opened or written.
+ */
+class OutputException : public AbstractVMException {
+public:
+    explicit OutputException(const std::string& message);
+};
+
+/**
+ * @class StackLimitException
+ * @brief Exception thrown when a stack exceeds its maximum size.
+ *
+ * This exception is thrown when an instruction leaves more values on a
+ * stack than OperandBuffer::getLimit(). The values past the limit are
+ * removed first. It is also thrown when no memory region is left for a
+ * stack, or when the pages of a region cannot be mapped.
+ */
+class StackLimitException : public AbstractVMException {
+public:
+    explicit StackLimitException(const std::string& message);
+};
+
+/**
+ * @brief Gets the code identifying the class of an error.
+ *
+ * The code is the int8 value pushed for 'onerror' handlers:
+ *
+ * | Code | Exception                   |
+ * |------|-----------------------------|
+ * | 1    | OverflowException           |
+ * | 2    | UnderflowException          |
+ * | 3    | DivisionByZeroException     |
+ * | 4    | EmptyStackException         |
+ * | 5    | InsufficientValuesException |
+ * | 6    | AssertException             |
+ * | 7    | InputException              |
+ * | 8    | PlaceholderException        |
+ * | 9    | ForkException               |
+ * | 10   | ChannelException            |
+ * | 11   | SavepointException          |
+ * | 12   | OutputException             |
+ * | 13   | StackLimitException         |
+ * | 0    | any other AbstractVMException |
+ *
+ * @param error The error
+ * @return int8_t The error code
+ */
+int8_t errorCode(const AbstractVMException& error);
+
 #endif // ABSTRACTVMEXCEPTION_HPP
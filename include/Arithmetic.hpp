@@ -0,0 +1,158 @@
+/**
+ * @file Arithmetic.hpp
+ * @brief Scalar arithmetic kernels shared by the operands and the execution engines.
+ */
+
+#ifndef ARITHMETIC_HPP
+#define ARITHMETIC_HPP
+
+#include <string>
+#include <cstddef>
+#include "eOperandType.hpp"
+#include "eOpcode.hpp"
+
+/**
+ * @struct Scalar
+ * @brief A typed value held by value instead of behind an IOperand pointer.
+ *
+ * Engines that keep their values in flat arrays (BatchEngine, ...) use
+ * Scalar instead of heap-allocated operands. The value is the native value
+ * of the operand widened to long double, so it is exact for every type.
+ */
+struct Scalar {
+    eOperandType type;  ///< The operand type
+    long double value;  ///< The native value, widened to long double
+};
+
+/**
+ * @enum eArithmetic
+ * @brief The binary arithmetic operations of the instruction set.
+ */
+enum class eArithmetic {
+    Add,    ///< Addition
+    Sub,    ///< Subtraction
+    Mul,    ///< Multiplication
+    Div,    ///< Division
+    Mod     ///< Modulo
+};
+
+/**
+ * @brief Maps an arithmetic opcode to its operation.
+ * @param opcode One of add, sub, mul, div or mod
+ * @return eArithmetic The operation
+ */
+inline eArithmetic toArithmetic(eOpcode opcode) {
+    switch (opcode) {
+        case eOpcode::Sub: return eArithmetic::Sub;
+        case eOpcode::Mul: return eArithmetic::Mul;
+        case eOpcode::Div: return eArithmetic::Div;
+        case eOpcode::Mod: return eArithmetic::Mod;
+        default:           return eArithmetic::Add;
+    }
+}
+
+/**
+ * @brief Checks if a type is an integer type.
+ * @param type The operand type
+ * @return bool True for int8, int16 and int32
+ */
+inline bool isInteger(eOperandType type) {
+    return type == eOperandType::Int8 || type == eOperandType::Int16 ||
+           type == eOperandType::Int32;
+}
+
+/**
+ * @brief Gets the result type of an operation between two operand types.
+ *
+ * The result takes the type of the more precise operand.
+ *
+ * @param lhs Type of the left operand
+ * @param rhs Type of the right operand
+ * @return eOperandType The result type
+ */
+inline eOperandType resultType(eOperandType lhs, eOperandType rhs) {
+    return (static_cast<int>(lhs) >= static_cast<int>(rhs)) ? lhs : rhs;
+}
+
+/**
+ * @brief Gets the value a right-hand operand contributes to an operation.
+ *
+ * The right-hand side of an operation is taken from the operand's text
+ * representation, so float and double values are rounded to the number of
+ * digits toString() prints. Integers are returned unchanged.
+ *
+ * @param type The operand type
+ * @param value The native value
+ * @return long double The value as read back from its text representation
+ */
+long double rhsValue(eOperandType type, long double value);
+
+/**
+ * @brief Rounds the raw result of an operation like its text conversion does.
+ *
+ * Results are rounded to six decimal places (the precision of
+ * std::to_string) before being converted to the result type. This function
+ * returns exactly `std::stold(std::to_string(value))` without going through
+ * text in the common case.
+ *
+ * @param value The raw result
+ * @return long double The rounded result
+ */
+long double roundResult(long double value);
+
+/**
+ * @brief Computes a binary operation on raw values.
+ *
+ * Does not check for division by zero nor round the result.
+ *
+ * @param op The operation
+ * @param lhs The left operand value
+ * @param rhs The right operand value (see rhsValue)
+ * @return long double The raw result
+ */
+long double applyArithmetic(eArithmetic op, long double lhs, long double rhs);
+
+/**
+ * @brief Gets the bounds of a type as long double.
+ * @param type The operand type
+ * @param min Receives the lowest value
+ * @param max Receives the highest value
+ */
+void typeBounds(eOperandType type, long double& min, long double& max);
+
+/**
+ * @brief Checks that a value is within the bounds of a type.
+ * @param type The target type
+ * @param value The value to check
+ * @return bool True if the value can be converted without overflow or underflow
+ *              (NaN only fits the floating-point types)
+ */
+bool fitsType(eOperandType type, long double value);
+
+/**
+ * @brief Converts a value to a type, then widens it back to long double.
+ * @param type The target type
+ * @param value The value to convert (must fit the type)
+ * @return long double The value as stored by an operand of that type
+ */
+long double castToType(eOperandType type, long double value);
+
+/**
+ * @brief Formats a native value like IOperand::toString().
+ * @param buffer Destination buffer
+ * @param size Size of the destination buffer
+ * @param type The operand type
+ * @param value The native value
+ * @return size_t Number of characters written (excluding the terminator), 0 if the buffer is too small
+ */
+size_t formatValue(char* buffer, size_t size, eOperandType type, long double value);
+
+/**
+ * @brief Formats a native value like IOperand::toString().
+ * @param type The operand type
+ * @param value The native value
+ * @return std::string The formatted value
+ */
+std::string formatValue(eOperandType type, long double value);
+
+#endif // ARITHMETIC_HPP
@@ -0,0 +1,213 @@
+/**
+ * @file BatchEngine.hpp
+ * @brief Defines the BatchEngine class - lockstep execution over many input sets.
+ */
+
+#ifndef BATCHENGINE_HPP
+#define BATCHENGINE_HPP
+
+#include <vector>
+#include <string>
+#include <cstdint>
+#include <exception>
+#include "Arithmetic.hpp"
+#include "eOpcode.hpp"
+
+// Forward declaration
+class VirtualMachine;
+
+/**
+ * @class BatchEngine
+ * @brief Runs one loaded program over many input sets in lockstep.
+ *
+ * Each input set is a lane: a set of values bound to the program
+ * placeholders. Programs are straight-line, so the stack depth and the type
+ * of every stack slot are the same for all lanes at every instruction. The
+ * engine keeps one column of values per stack slot (structure of arrays,
+ * indexed by lane) and executes each instruction as one kernel over all
+ * lanes, so the per-instruction dispatch is paid once for the whole batch.
+ *
+ * Lanes that raise an AbstractVMException are masked out of the following
+ * kernels and the exception is reported for that lane only. Results are
+ * identical to running the program once per lane with VirtualMachine.
+ *
+ * Supported instructions are push (literals and placeholders), pop, assert,
+ * add, sub, mul, div, mod and exit. Programs using dump, print or read
+ * produce per-lane side effects and are rejected.
+ *
+ * ## Usage Example
+ * ```cpp
+ * VirtualMachine vm;
+ * vm.loadFile("score.avm");
+ *
+ * BatchEngine batch(vm);
+ * batch.bind("1", amounts);   // one value per lane
+ * batch.bind("rate", rates);
+ * for (const BatchEngine::LaneResult& lane : batch.run()) {
+ *     ...
+ * }
+ * ```
+ */
+class BatchEngine {
+public:
+    /**
+     * @struct LaneResult
+     * @brief Outcome of the program for one lane.
+     */
+    struct LaneResult {
+        std::vector<Scalar> stack;  ///< Stack at exit, bottom first (empty on error)
+        std::exception_ptr error;   ///< Exception raised by the lane, or null
+    };
+
+    /**
+     * @brief Compiles the program loaded in a VirtualMachine.
+     * @param vm The VM holding the loaded program and its placeholder slots
+     * @throws std::invalid_argument if the program uses an unsupported instruction
+     */
+    explicit BatchEngine(VirtualMachine& vm);
+
+    /**
+     * @brief Binds one value per lane to a placeholder.
+     *
+     * All bound placeholders must have the same number of values, which is
+     * the number of lanes. Placeholders that are not bound here, and lanes
+     * without a value, use the value bound in the VirtualMachine: a lane
+     * pushing a placeholder bound nowhere fails with "Unbound placeholder",
+     * as a run of the VirtualMachine would.
+     *
+     * @param name Placeholder name without the '$'
+     * @param values The values, indexed by lane
+     * @param present Lanes that have a value, indexed by lane (all lanes if empty)
+     */
+    void bind(const std::string& name, std::vector<long double> values,
+              std::vector<bool> present = {});
+
+    /**
+     * @brief Runs the program over all lanes.
+     * @return std::vector<LaneResult> The result of each lane
+     * @throws std::invalid_argument if bound placeholders have different lane counts
+     */
+    std::vector<LaneResult> run();
+
+private:
+    /**
+     * @struct Step
+     * @brief One compiled instruction with its static stack layout.
+     */
+    struct Step {
+        eOpcode opcode;             ///< The instruction
+        size_t depth;               ///< Stack depth before the instruction
+        eOperandType type;          ///< Pushed / result / asserted type
+        eOperandType lhsType;       ///< Left operand type (arithmetic)
+        eOperandType rhsType;       ///< Right operand type (arithmetic)
+        long double value;          ///< Pushed constant (push)
+        size_t slot;                ///< Placeholder slot (push with placeholder)
+        std::string expected;       ///< Expected text (assert)
+        std::vector<eOperandType> layout; ///< Types of all stack slots (exit)
+        std::exception_ptr error;   ///< Error raised by every lane reaching this step
+    };
+
+    /**
+     * @struct Column
+     * @brief Values of one stack slot for all lanes.
+     *
+     * Integer slots use the ints array and floating-point slots the reals
+     * array, depending on the static type of the slot.
+     */
+    struct Column {
+        std::vector<int64_t> ints;      ///< Values of integer slots
+        std::vector<long double> reals; ///< Values of floating-point slots
+    };
+
+    VirtualMachine& _vm;                            ///< The VM holding the program
+    std::vector<Step> _steps;                       ///< The compiled program
+    size_t _maxDepth;                               ///< Highest stack depth reached
+    std::vector<std::vector<long double>> _inputs;  ///< Lane values, indexed by slot
+    std::vector<bool> _bound;                       ///< Lane binding flags, indexed by slot
+    std::vector<std::vector<bool>> _present;        ///< Lanes with a value, indexed by slot (empty: all)
+
+    std::vector<Column> _columns;                   ///< The lane stacks, indexed by depth
+    std::vector<uint8_t> _active;                   ///< Lane mask (1 while the lane runs)
+    std::vector<uint8_t> _flags;                    ///< Per-lane scratch flags
+    std::vector<int64_t> _raw;                      ///< Per-lane scratch results
+    std::vector<LaneResult> _results;               ///< Results being built
+
+    /**
+     * @brief Translates the VM program into steps.
+     * @throws std::invalid_argument on unsupported instructions
+     */
+    void compile();
+
+    /**
+     * @brief Masks a lane out, recording its error.
+     * @param lane The lane index
+     * @param error The exception raised by the lane
+     */
+    void fail(size_t lane, const std::exception_ptr& error);
+
+    /**
+     * @brief Reads the value of a lane at a stack depth.
+     * @param type Static type of the slot
+     * @param depth Stack slot index
+     * @param lane The lane index
+     * @return long double The native value
+     */
+    long double load(eOperandType type, size_t depth, size_t lane) const;
+
+    /**
+     * @brief Stores the value of a lane at a stack depth.
+     * @param type Static type of the slot
+     * @param depth Stack slot index
+     * @param lane The lane index
+     * @param value The native value (already converted to the type)
+     */
+    void store(eOperandType type, size_t depth, size_t lane, long double value);
+
+    /**
+     * @brief Kernel for push with a literal.
+     * @param step The compiled instruction
+     * @param lanes Number of lanes
+     */
+    void pushConstant(const Step& step, size_t lanes);
+
+    /**
+     * @brief Kernel for push with a placeholder.
+     * @param step The compiled instruction
+     * @param lanes Number of lanes
+     */
+    void pushSlot(const Step& step, size_t lanes);
+
+    /**
+     * @brief Kernel for assert.
+     * @param step The compiled instruction
+     * @param lanes Number of lanes
+     */
+    void assertValue(const Step& step, size_t lanes);
+
+    /**
+     * @brief Kernel for add, sub and mul on integer operands.
+     *
+     * Exact 64-bit integer arithmetic over all lanes without branches,
+     * followed by a bounds check of the result type.
+     *
+     * @param step The compiled instruction
+     * @param lanes Number of lanes
+     */
+    void integerArithmetic(const Step& step, size_t lanes);
+
+    /**
+     * @brief Kernel for every other arithmetic instruction.
+     * @param step The compiled instruction
+     * @param lanes Number of lanes
+     */
+    void genericArithmetic(const Step& step, size_t lanes);
+
+    /**
+     * @brief Records the final stack of every active lane.
+     * @param step The exit instruction
+     * @param lanes Number of lanes
+     */
+    void exitLanes(const Step& step, size_t lanes);
+};
+
+#endif // BATCHENGINE_HPP
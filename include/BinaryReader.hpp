@@ -0,0 +1,118 @@
+/**
+ * @file BinaryReader.hpp
+ * @brief Defines the BinaryReader class used by the 'read' instruction.
+ */
+
+#ifndef BINARYREADER_HPP
+#define BINARYREADER_HPP
+
+#include <string>
+#include <vector>
+#include <cstddef>
+
+/**
+ * @class BinaryReader
+ * @brief Buffered, bounds-checked reader over a binary input stream.
+ *
+ * The BinaryReader feeds the 'read' instruction with raw native values
+ * taken from a file or an already open file descriptor. Values are stored
+ * back to back in native byte order, without any separator or header, so
+ * a data set is simply the concatenation of the values a program reads:
+ *
+ * | Type   | Size    |
+ * |--------|---------|
+ * | int8   | 1 byte  |
+ * | int16  | 2 bytes |
+ * | int32  | 4 bytes |
+ * | float  | 4 bytes |
+ * | double | 8 bytes |
+ *
+ * Reads are served from an internal buffer that is refilled with large
+ * read(2) calls, so no text formatting or parsing is involved.
+ *
+ * ## Usage Example
+ * ```cpp
+ * VirtualMachine vm;
+ * vm.setInput(std::make_unique<BinaryReader>("data.bin"));
+ * vm.runFile("program.avm");
+ * ```
+ */
+class BinaryReader {
+public:
+    /**
+     * @brief Opens a file for reading.
+     * @param path Path of the binary data file
+     * @throws std::runtime_error if the file cannot be opened
+     */
+    explicit BinaryReader(const std::string& path);
+
+    /**
+     * @brief Reads from an already open file descriptor.
+     *
+     * The descriptor is not closed when the reader is destroyed.
+     *
+     * @param fd The file descriptor to read from
+     */
+    explicit BinaryReader(int fd);
+
+    /**
+     * @brief Destructor. Closes the file if it was opened by the reader.
+     */
+    ~BinaryReader();
+
+    /**
+     * @brief Deleted copy constructor (non-copyable).
+     */
+    BinaryReader(const BinaryReader&) = delete;
+
+    /**
+     * @brief Deleted copy assignment operator (non-copyable).
+     */
+    BinaryReader& operator=(const BinaryReader&) = delete;
+
+    /**
+     * @brief Copies the next @p size bytes of the stream into @p dest.
+     * @param dest Destination buffer of at least @p size bytes
+     * @param size Number of bytes to read
+     * @throws InputException if the stream ends before @p size bytes are available
+     */
+    void readBytes(void* dest, size_t size);
+
+    /**
+     * @brief Reads the next native value of type T.
+     * @tparam T A trivially copyable type (int8_t, int16_t, int32_t, float, double)
+     * @return T The value read
+     * @throws InputException if the stream ends before sizeof(T) bytes are available
+     */
+    template <typename T>
+    T read() {
+        T value;
+        readBytes(&value, sizeof(T));
+        return value;
+    }
+
+    /**
+     * @brief Gets the number of bytes consumed so far.
+     * @return size_t Offset of the next byte in the stream
+     */
+    size_t position() const;
+
+private:
+    static const size_t BUFFER_SIZE = 1 << 16; ///< Size of the refill buffer
+
+    int _fd;                    ///< The underlying file descriptor
+    bool _ownsFd;               ///< True if the descriptor must be closed on destruction
+    std::vector<char> _buffer;  ///< Refill buffer
+    size_t _begin;              ///< Offset of the next unread byte in the buffer
+    size_t _end;                ///< Offset past the last valid byte in the buffer
+    size_t _consumed;           ///< Total bytes handed out so far
+    bool _eof;                  ///< True once the descriptor reported end of file
+
+    /**
+     * @brief Refills the buffer from the file descriptor.
+     * @return bool False if no more data is available
+     */
+    bool refill();
+};
+
+#endif // BINARYREADER_HPP
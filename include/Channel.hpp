@@ -0,0 +1,177 @@
+/**
+ * @file Channel.hpp
+ * @brief Defines the Channel and ChannelRegistry classes - value passing between VMs.
+ */
+
+#ifndef CHANNEL_HPP
+#define CHANNEL_HPP
+
+#include <atomic>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "Arithmetic.hpp"
+
+/**
+ * @class Channel
+ * @brief Bounded single-producer single-consumer queue of typed values.
+ *
+ * A channel connects the 'send' instructions of one VM to the 'recv'
+ * instructions of another, usually running on another thread. The queue is
+ * a lock-free ring buffer: the producer only writes the tail index and the
+ * consumer only writes the head index, each on its own cache line.
+ *
+ * Sending to a full channel and receiving from an empty one wait
+ * cooperatively (spinning briefly, then yielding the thread), so a fast
+ * producer is held back by a slow consumer. Each end is closed when its VM
+ * finishes a run: a send waiting on a full channel fails once the receiver
+ * has finished, and a receive fails once the sender has finished and the
+ * remaining values are consumed, so a stage that stops early cannot leave
+ * its peer waiting forever.
+ */
+class Channel {
+public:
+    /**
+     * @brief Default number of values a channel holds.
+     */
+    static constexpr size_t defaultCapacity = 1024;
+
+    /**
+     * @brief Constructor.
+     * @param name The channel name, for error messages
+     * @param capacity Number of values held (rounded up to a power of two)
+     */
+    explicit Channel(const std::string& name, size_t capacity = defaultCapacity);
+
+    /**
+     * @brief Deleted copy constructor (non-copyable).
+     */
+    Channel(const Channel&) = delete;
+
+    /**
+     * @brief Deleted copy assignment operator (non-copyable).
+     */
+    Channel& operator=(const Channel&) = delete;
+
+    /**
+     * @brief Sends a value, waiting while the channel is full.
+     * @param value The value
+     * @throws ChannelException if the channel is full and its receiver has finished or is missing
+     */
+    void send(const Scalar& value);
+
+    /**
+     * @brief Receives a value, waiting while the channel is empty.
+     * @return Scalar The oldest value
+     * @throws ChannelException if the channel is empty and its sender has finished or is missing
+     */
+    Scalar receive();
+
+    /**
+     * @brief Sends a value if there is room.
+     * @param value The value
+     * @return bool False if the channel is full
+     */
+    bool trySend(const Scalar& value);
+
+    /**
+     * @brief Receives a value if one is available.
+     * @param value Receives the oldest value
+     * @return bool False if the channel is empty
+     */
+    bool tryReceive(Scalar& value);
+
+    /**
+     * @brief Marks the ends owned by a VM as running.
+     * @param owner The VM starting a run
+     */
+    void open(const void* owner);
+
+    /**
+     * @brief Marks the ends owned by a VM as finished.
+     * @param owner The VM finishing a run
+     */
+    void close(const void* owner);
+
+    /**
+     * @brief Records the VM sending on or receiving from the channel.
+     *
+     * Called when a program using the channel is parsed.
+     *
+     * @param owner The VM
+     * @param sender True for the sending end, false for the receiving end
+     * @throws ChannelException if that end already belongs to another VM
+     */
+    void attach(const void* owner, bool sender);
+
+    /**
+     * @brief Gets the channel name.
+     * @return const std::string& The name
+     */
+    const std::string& getName() const;
+
+private:
+    std::string _name;                      ///< The channel name
+    std::vector<Scalar> _buffer;            ///< The ring buffer
+    size_t _mask;                           ///< Capacity - 1
+    const void* _sender;                    ///< VM owning the sending end
+    const void* _receiver;                  ///< VM owning the receiving end
+    std::atomic<bool> _senderDone;          ///< Set when the sending VM finishes a run
+    std::atomic<bool> _receiverDone;        ///< Set when the receiving VM finishes a run
+
+    alignas(64) std::atomic<size_t> _head;  ///< Next value to receive (written by the consumer)
+    size_t _tailCache;                      ///< Consumer's last view of _tail
+    alignas(64) std::atomic<size_t> _tail;  ///< Next free position (written by the producer)
+    size_t _headCache;                      ///< Producer's last view of _head
+
+    /**
+     * @brief Waits a little before retrying, spinning first, then yielding.
+     * @param attempt Number of failed attempts so far
+     */
+    static void backoff(size_t attempt);
+};
+
+/**
+ * @class ChannelRegistry
+ * @brief Named channels shared by the VMs of a pipeline.
+ *
+ * VMs sharing a registry (see VirtualMachine::setChannels) resolve the same
+ * channel name to the same Channel when their programs are parsed.
+ *
+ * ## Usage Example
+ * ```cpp
+ * auto channels = std::make_shared<ChannelRegistry>();
+ * VirtualMachine producer, consumer;
+ * producer.setChannels(channels);
+ * consumer.setChannels(channels);
+ * producer.loadFile("parse.avm");      // send values
+ * consumer.loadFile("aggregate.avm");  // recv values
+ * std::thread stage([&]() { producer.execute(); });
+ * consumer.execute();
+ * stage.join();
+ * ```
+ */
+class ChannelRegistry {
+public:
+    /**
+     * @brief Constructor.
+     * @param capacity Capacity of the channels created by the registry
+     */
+    explicit ChannelRegistry(size_t capacity = Channel::defaultCapacity);
+
+    /**
+     * @brief Gets a channel by name, creating it if needed.
+     * @param name The channel name
+     * @return Channel& The channel (valid as long as the registry)
+     */
+    Channel& get(const std::string& name);
+
+private:
+    std::mutex _mutex;                                      ///< Protects _channels
+    std::map<std::string, std::unique_ptr<Channel>> _channels; ///< Channels by name
+    size_t _capacity;                                       ///< Capacity of new channels
+};
+
+#endif // CHANNEL_HPP
@@ -7,16 +7,24 @@
 #define COMMANDS_HPP
 
 #include <memory>
+#include <mutex>
+#include <vector>
 #include "ICommand.hpp"
 #include "IOperand.hpp"
+#include "OperandFactory.hpp"
 #include "AbstractVMException.hpp"
 
+// Forward declarations
+class VirtualMachine;
+class Channel;
+
 /**
  * @class PushCommand
  * @brief Command that pushes a value onto the stack.
  *
  * Implements the 'push' instruction which adds a new operand
- * to the top of the stack.
+ * to the top of the stack. The command keeps its operand and pushes
+ * a copy, so the same parsed program can be executed several times.
  *
  * ## Assembly Syntax
  * ```
@@ -36,10 +44,22 @@ public:
      * @brief Executes the push operation.
      * @param stack The VM stack
      */
-    void execute(std::stack<const IOperand*>& stack) override;
+    void execute(OperandStack& stack) override;
 
     /**
-     * @brief Destructor that cleans up the operand if not pushed.
+     * @brief Gets the instruction implemented by this command.
+     * @return eOpcode eOpcode::Push
+     */
+    eOpcode getOpcode() const override;
+
+    /**
+     * @brief Gets the operand pushed by this command.
+     * @return const IOperand* The operand (still owned by the command)
+     */
+    const IOperand* getOperand() const;
+
+    /**
+     * @brief Destructor that cleans up the operand.
      */
     ~PushCommand() override;
 
@@ -47,6 +67,67 @@ private:
     const IOperand* _operand; ///< The operand to push
 };
 
+/**
+ * @class PushSlotCommand
+ * @brief Command that pushes the value bound to a placeholder.
+ *
+ * Implements the 'push' instruction when its value is a placeholder.
+ * The placeholder is resolved to a slot of the VirtualMachine at parse
+ * time; at execution the bound value is only checked against the bounds
+ * of the requested type.
+ *
+ * ## Assembly Syntax
+ * ```
+ * push int32($1)
+ * push double($rate)
+ * ```
+ *
+ * @throws PlaceholderException if the placeholder is not bound
+ * @throws OverflowException if the bound value exceeds the type maximum
+ * @throws UnderflowException if the bound value is below the type minimum
+ */
+class PushSlotCommand : public ICommand {
+public:
+    /**
+     * @brief Constructor with the VM holding the bindings, the type and the slot.
+     * @param vm Pointer to the VirtualMachine instance
+     * @param type The type of the pushed operand
+     * @param slot The placeholder slot (see VirtualMachine::placeholderSlot)
+     */
+    PushSlotCommand(VirtualMachine* vm, eOperandType type, size_t slot);
+
+    /**
+     * @brief Executes the push operation.
+     * @param stack The VM stack
+     * @throws PlaceholderException if the placeholder is not bound
+     */
+    void execute(OperandStack& stack) override;
+
+    /**
+     * @brief Gets the instruction implemented by this command.
+     * @return eOpcode eOpcode::PushSlot
+     */
+    eOpcode getOpcode() const override;
+
+    /**
+     * @brief Gets the type of the pushed operand.
+     * @return eOperandType The operand type
+     */
+    eOperandType getType() const;
+
+    /**
+     * @brief Gets the placeholder slot of this command.
+     * @return size_t The slot index
+     */
+    size_t getSlot() const;
+
+private:
+    VirtualMachine* _vm;        ///< Pointer to the VirtualMachine
+    eOperandType _type;         ///< The type of the pushed operand
+    size_t _slot;               ///< The placeholder slot
+    OperandFactory _factory;    ///< Factory for creating the pushed operand
+};
+
 /**
  * @class PopCommand
  * @brief Command that removes the top value from the stack.
@@ -73,7 +154,13 @@ public:
      * @param stack The VM stack
      * @throws EmptyStackException if stack is empty
      */
-    void execute(std::stack<const IOperand*>& stack) override;
+    void execute(OperandStack& stack) override;
+
+    /**
+     * @brief Gets the instruction implemented by this command.
+     * @return eOpcode eOpcode::Pop
+     */
+    eOpcode getOpcode() const override;
 };
 
 /**
@@ -81,25 +168,105 @@ public:
  * @brief Command that displays all stack values without modifying the stack.
  *
  * Implements the 'dump' instruction which prints each value on the stack
- * from most recent to oldest, separated by newlines.
+ * from most recent to oldest, separated by newlines. With a count, only
+ * the top n values are printed, and only they are visited.
+ *
+ * The values are written in the dump format of the VM (see
+ * VirtualMachine::setDumpFormat). With a file name, they are written to
+ * that file as a binary dump (see BinaryDumpWriter), replacing its content.
  *
  * ## Assembly Syntax
  * ```
  * dump
+ * dump 10
+ * dump "stack.bin"
  * ```
  */
 class DumpCommand : public ICommand {
 public:
     /**
-     * @brief Default constructor.
+     * @brief Count printing the whole stack.
+     */
+    static constexpr size_t all = static_cast<size_t>(-1);
+
+    /**
+     * @brief Constructor.
+     * @param vm Pointer to the VirtualMachine giving the dump format
+     * @param count Number of values printed from the top
+     * @param path File written instead of the standard output, or empty
      */
-    DumpCommand() = default;
+    explicit DumpCommand(VirtualMachine* vm, size_t count = all, const std::string& path = "");
 
     /**
      * @brief Executes the dump operation.
      * @param stack The VM stack
+     * @throws OutputException if the file cannot be written
+     */
+    void execute(OperandStack& stack) override;
+
+    /**
+     * @brief Gets the instruction implemented by this command.
+     * @return eOpcode eOpcode::Dump
      */
-    void execute(std::stack<const IOperand*>& stack) override;
+    eOpcode getOpcode() const override;
+
+    /**
+     * @brief Gets the number of values printed.
+     * @return size_t The count (DumpCommand::all for the whole stack)
+     */
+    size_t getCount() const;
+
+    /**
+     * @brief Gets the file written by the dump.
+     * @return const std::string& The path, empty for the standard output
+     */
+    const std::string& getPath() const;
+
+private:
+    VirtualMachine* _vm;    ///< The VM giving the dump format
+    size_t _count;          ///< Number of values printed from the top
+    std::string _path;      ///< File written instead of the standard output, or empty
+};
+
+/**
+ * @class DumpDeltaCommand
+ * @brief Command that displays the stack values changed since the last dump.
+ *
+ * Implements the 'dumpdelta' instruction. The VM records the lowest stack
+ * position modified since the previous 'dumpdelta' (or full 'dump') of the
+ * stack; a marker giving that position is printed, followed by the values
+ * from position i to the top, in the same order and dump format as 'dump'
+ * (see appendDeltaMarker). A reader keeps the previous output up to
+ * position i and appends the new values. Only the changed part of the
+ * stack is visited.
+ *
+ * ## Assembly Syntax
+ * ```
+ * dumpdelta
+ * ```
+ */
+class DumpDeltaCommand : public ICommand {
+public:
+    /**
+     * @brief Constructor with VM reference.
+     * @param vm Pointer to the VirtualMachine tracking changes
+     */
+    explicit DumpDeltaCommand(VirtualMachine* vm);
+
+    /**
+     * @brief Executes the dumpdelta operation.
+     * @param stack The VM stack
+     */
+    void execute(OperandStack& stack) override;
+
+    /**
+     * @brief Gets the instruction implemented by this command.
+     * @return eOpcode eOpcode::DumpDelta
+     */
+    eOpcode getOpcode() const override;
+
+private:
+    VirtualMachine* _vm;    ///< The VM tracking changes
 };
 
 /**
@@ -132,7 +299,19 @@ public:
      * @throws AssertException if values don't match
      * @throws EmptyStackException if stack is empty
      */
-    void execute(std::stack<const IOperand*>& stack) override;
+    void execute(OperandStack& stack) override;
+
+    /**
+     * @brief Gets the instruction implemented by this command.
+     * @return eOpcode eOpcode::Assert
+     */
+    eOpcode getOpcode() const override;
+
+    /**
+     * @brief Gets the operand this command asserts against.
+     * @return const IOperand* The expected operand (still owned by the command)
+     */
+    const IOperand* getExpected() const;
 
     /**
      * @brief Destructor.
@@ -170,7 +349,13 @@ public:
      * @param stack The VM stack
      * @throws InsufficientValuesException if fewer than 2 values on stack
      */
-    void execute(std::stack<const IOperand*>& stack) override;
+    void execute(OperandStack& stack) override;
+
+    /**
+     * @brief Gets the instruction implemented by this command.
+     * @return eOpcode eOpcode::Add
+     */
+    eOpcode getOpcode() const override;
 };
 
 /**
@@ -200,7 +385,13 @@ public:
      * @param stack The VM stack
      * @throws InsufficientValuesException if fewer than 2 values on stack
      */
-    void execute(std::stack<const IOperand*>& stack) override;
+    void execute(OperandStack& stack) override;
+
+    /**
+     * @brief Gets the instruction implemented by this command.
+     * @return eOpcode eOpcode::Sub
+     */
+    eOpcode getOpcode() const override;
 };
 
 /**
@@ -230,7 +421,13 @@ public:
      * @param stack The VM stack
      * @throws InsufficientValuesException if fewer than 2 values on stack
      */
-    void execute(std::stack<const IOperand*>& stack) override;
+    void execute(OperandStack& stack) override;
+
+    /**
+     * @brief Gets the instruction implemented by this command.
+     * @return eOpcode eOpcode::Mul
+     */
+    eOpcode getOpcode() const override;
 };
 
 /**
@@ -261,7 +458,13 @@ public:
      * @throws InsufficientValuesException if fewer than 2 values on stack
      * @throws DivisionByZeroException if divisor is zero
      */
-    void execute(std::stack<const IOperand*>& stack) override;
+    void execute(OperandStack& stack) override;
+
+    /**
+     * @brief Gets the instruction implemented by this command.
+     * @return eOpcode eOpcode::Div
+     */
+    eOpcode getOpcode() const override;
 };
 
 /**
@@ -292,7 +495,13 @@ public:
      * @throws InsufficientValuesException if fewer than 2 values on stack
      * @throws DivisionByZeroException if divisor is zero
      */
-    void execute(std::stack<const IOperand*>& stack) override;
+    void execute(OperandStack& stack) override;
+
+    /**
+     * @brief Gets the instruction implemented by this command.
+     * @return eOpcode eOpcode::Mod
+     */
+    eOpcode getOpcode() const override;
 };
 
 /**
@@ -313,9 +522,10 @@ public:
 class PrintCommand : public ICommand {
 public:
     /**
-     * @brief Default constructor.
+     * @brief Constructor with VM reference.
+     * @param vm Pointer to the VirtualMachine whose output is written
      */
-    PrintCommand() = default;
+    explicit PrintCommand(VirtualMachine* vm);
 
     /**
      * @brief Executes the print operation.
@@ -323,11 +533,17 @@ public:
      * @throws AssertException if top is not Int8
      * @throws EmptyStackException if stack is empty
      */
-    void execute(std::stack<const IOperand*>& stack) override;
-};
+    void execute(OperandStack& stack) override;
 
-// Forward declaration
-class VirtualMachine;
+    /**
+     * @brief Gets the instruction implemented by this command.
+     * @return eOpcode eOpcode::Print
+     */
+    eOpcode getOpcode() const override;
+
+private:
+    VirtualMachine* _vm;    ///< The VM whose output is written
+};
 
 /**
  * @class ExitCommand
@@ -353,10 +569,622 @@ public:
      * @brief Executes the exit operation.
      * @param stack The VM stack
      */
-    void execute(std::stack<const IOperand*>& stack) override;
+    void execute(OperandStack& stack) override;
+
+    /**
+     * @brief Gets the instruction implemented by this command.
+     * @return eOpcode eOpcode::Exit
+     */
+    eOpcode getOpcode() const override;
 
 private:
     VirtualMachine* _vm; ///< Pointer to the VirtualMachine
 };
 
+/**
+ * @class ReadCommand
+ * @brief Command that pushes the next value of the VM input stream.
+ *
+ * Implements the 'read' instruction which takes the next native value of
+ * the requested type from the binary input stream attached to the VM
+ * (see BinaryReader) and pushes it onto the stack.
+ *
+ * ## Assembly Syntax
+ * ```
+ * read int32
+ * read double
+ * ```
+ *
+ * @throws InputException if no input stream is attached or it is exhausted
+ * @throws OverflowException if a floating-point value read is infinite
+ */
+class ReadCommand : public ICommand {
+public:
+    /**
+     * @brief Constructor with the VM owning the input stream and the value type.
+     * @param vm Pointer to the VirtualMachine instance
+     * @param type The type of the value to read
+     */
+    ReadCommand(VirtualMachine* vm, eOperandType type);
+
+    /**
+     * @brief Executes the read operation.
+     * @param stack The VM stack
+     * @throws InputException if no input is available
+     */
+    void execute(OperandStack& stack) override;
+
+    /**
+     * @brief Gets the instruction implemented by this command.
+     * @return eOpcode eOpcode::Read
+     */
+    eOpcode getOpcode() const override;
+
+    /**
+     * @brief Gets the type of the pushed operand.
+     * @return eOperandType The operand type
+     */
+    eOperandType getType() const;
+
+private:
+    VirtualMachine* _vm;        ///< Pointer to the VirtualMachine
+    eOperandType _type;         ///< The type of the value to read
+    OperandFactory _factory;    ///< Factory for creating the read operand
+};
+
+/**
+ * @class ForkCommand
+ * @brief Command that runs a block of instructions on another thread.
+ *
+ * Implements the 'fork' instruction. The top n values are popped and become
+ * the initial stack of a child VM, which runs the instructions up to the
+ * matching 'endfork' on its own thread while the parent continues. A later
+ * 'join' waits for the child and pushes its final stack.
+ *
+ * The child has its own VirtualMachine, stack and operands: it shares
+ * nothing with the parent but the placeholder values, copied when the fork
+ * starts, and the queue of asynchronous dumps. Forks may be nested. 'exit' is not allowed in a fork block.
+ *
+ * A fork executed again before its previous run finished (from an error
+ * handler, for instance) queues on the child VM: each run starts on an
+ * empty stack once the previous one has returned its results.
+ *
+ * ## Assembly Syntax
+ * ```
+ * push int32(6)
+ * push int32(7)
+ * fork 2
+ *     mul
+ * endfork
+ * ...
+ * join
+ * ```
+ *
+ * @throws InsufficientValuesException if fewer than n values are on the stack
+ */
+class ForkCommand : public ICommand {
+public:
+    /**
+     * @brief Constructor with the parent VM, the child VM and its block.
+     * @param vm Pointer to the parent VirtualMachine (pending forks)
+     * @param child The VirtualMachine the block was parsed for (takes ownership)
+     * @param commands The instructions between 'fork' and 'endfork'
+     * @param count Number of values passed to the child
+     */
+    ForkCommand(VirtualMachine* vm, std::unique_ptr<VirtualMachine> child,
+                std::vector<std::unique_ptr<ICommand>> commands, size_t count);
+
+    /**
+     * @brief Destructor. Waits for the child if it is still running.
+     */
+    ~ForkCommand();
+
+    /**
+     * @brief Executes the fork operation.
+     * @param stack The VM stack
+     * @throws InsufficientValuesException if fewer than n values are on the stack
+     */
+    void execute(OperandStack& stack) override;
+
+    /**
+     * @brief Gets the instruction implemented by this command.
+     * @return eOpcode eOpcode::Fork
+     */
+    eOpcode getOpcode() const override;
+
+    /**
+     * @brief Gets the number of values passed to the child.
+     * @return size_t The value count
+     */
+    size_t getCount() const;
+
+private:
+    VirtualMachine* _vm;                                ///< Pointer to the parent VirtualMachine
+    std::unique_ptr<VirtualMachine> _child;             ///< The VM running the block
+    std::vector<std::unique_ptr<ICommand>> _commands;   ///< The forked block
+    size_t _count;                                      ///< Number of values passed to the child
+    std::mutex _running;                                ///< Held by the run of the block on the child
+};
+
+/**
+ * @class JoinCommand
+ * @brief Command that waits for a forked block and pushes its results.
+ *
+ * Implements the 'join' instruction. Joins are matched with forks in the
+ * order the forks started: the first 'join' waits for the first pending
+ * fork. The final stack of the child is pushed, bottom value first, after
+ * checking that it fits under the stack limit. If the child raised an
+ * error, 'join' raises it.
+ *
+ * ## Assembly Syntax
+ * ```
+ * join
+ * ```
+ *
+ * @throws ForkException if no fork is pending
+ */
+class JoinCommand : public ICommand {
+public:
+    /**
+     * @brief Constructor with the VM holding the pending forks.
+     * @param vm Pointer to the VirtualMachine instance
+     */
+    explicit JoinCommand(VirtualMachine* vm);
+
+    /**
+     * @brief Executes the join operation.
+     * @param stack The VM stack
+     * @throws ForkException if no fork is pending
+     * @throws AbstractVMException raised by the forked block
+     */
+    void execute(OperandStack& stack) override;
+
+    /**
+     * @brief Gets the instruction implemented by this command.
+     * @return eOpcode eOpcode::Join
+     */
+    eOpcode getOpcode() const override;
+
+private:
+    VirtualMachine* _vm;    ///< Pointer to the VirtualMachine
+};
+
+/**
+ * @class SendCommand
+ * @brief Command that sends the top value to a channel.
+ *
+ * Implements the 'send' instruction: the top value is popped and appended
+ * to the named channel, waiting while the channel is full. The receiving
+ * VM gets a value of the same type.
+ *
+ * ## Assembly Syntax
+ * ```
+ * send results
+ * ```
+ *
+ * @throws EmptyStackException if the stack is empty
+ * @throws ChannelException if the receiving VM has finished
+ */
+class SendCommand : public ICommand {
+public:
+    /**
+     * @brief Constructor with the channel resolved by the parser.
+     * @param channel The channel
+     */
+    explicit SendCommand(Channel* channel);
+
+    /**
+     * @brief Executes the send operation.
+     * @param stack The VM stack
+     * @throws EmptyStackException if the stack is empty
+     * @throws ChannelException if the channel is closed
+     */
+    void execute(OperandStack& stack) override;
+
+    /**
+     * @brief Gets the instruction implemented by this command.
+     * @return eOpcode eOpcode::Send
+     */
+    eOpcode getOpcode() const override;
+
+private:
+    Channel* _channel;  ///< The channel
+};
+
+/**
+ * @class RecvCommand
+ * @brief Command that pushes the next value of a channel.
+ *
+ * Implements the 'recv' instruction: the oldest value of the named channel
+ * is pushed, waiting while the channel is empty.
+ *
+ * ## Assembly Syntax
+ * ```
+ * recv results
+ * ```
+ *
+ * @throws ChannelException if the sending VM has finished and the channel is empty
+ */
+class RecvCommand : public ICommand {
+public:
+    /**
+     * @brief Constructor with the channel resolved by the parser.
+     * @param channel The channel
+     */
+    explicit RecvCommand(Channel* channel);
+
+    /**
+     * @brief Executes the receive operation.
+     * @param stack The VM stack
+     * @throws ChannelException if the channel is closed and empty
+     */
+    void execute(OperandStack& stack) override;
+
+    /**
+     * @brief Gets the instruction implemented by this command.
+     * @return eOpcode eOpcode::Recv
+     */
+    eOpcode getOpcode() const override;
+
+private:
+    Channel* _channel;          ///< The channel
+    OperandFactory _factory;    ///< Factory for creating the received operand
+};
+
+/**
+ * @class UseCommand
+ * @brief Command that selects the stack used by the next instructions.
+ *
+ * Implements the 'use' instruction. A VM has any number of named stacks;
+ * the program starts on the stack named "main", and every other
+ * instruction works on the selected one. Names are resolved to indices
+ * when the program is parsed.
+ *
+ * ## Assembly Syntax
+ * ```
+ * use accumulator
+ * push int32(0)
+ * use main
+ * ```
+ */
+class UseCommand : public ICommand {
+public:
+    /**
+     * @brief Constructor with VM reference and stack index.
+     * @param vm Pointer to the VirtualMachine owning the stacks
+     * @param stack Index of the stack to select
+     */
+    UseCommand(VirtualMachine* vm, size_t stack);
+
+    /**
+     * @brief Executes the use operation.
+     * @param stack The current stack (unused)
+     */
+    void execute(OperandStack& stack) override;
+
+    /**
+     * @brief Gets the instruction implemented by this command.
+     * @return eOpcode eOpcode::Use
+     */
+    eOpcode getOpcode() const override;
+
+private:
+    VirtualMachine* _vm;    ///< The VM owning the stacks
+    size_t _stack;          ///< Index of the selected stack
+};
+
+/**
+ * @class MoveCommand
+ * @brief Command that transfers the top values of a stack to another one.
+ *
+ * Implements the 'move' instruction: the top n values of the source stack
+ * are placed on top of the destination stack, keeping their order. The
+ * values themselves are not copied (see VirtualMachine::moveValues).
+ *
+ * ## Assembly Syntax
+ * ```
+ * move main accumulator 3
+ * ```
+ *
+ * @throws InsufficientValuesException if the source has fewer than n values
+ */
+class MoveCommand : public ICommand {
+public:
+    /**
+     * @brief Constructor with VM reference, stack indices and count.
+     * @param vm Pointer to the VirtualMachine owning the stacks
+     * @param from Index of the source stack
+     * @param to Index of the destination stack
+     * @param count Number of values to move
+     */
+    MoveCommand(VirtualMachine* vm, size_t from, size_t to, size_t count);
+
+    /**
+     * @brief Executes the move operation.
+     * @param stack The current stack (unused)
+     * @throws InsufficientValuesException if the source has fewer than n values
+     */
+    void execute(OperandStack& stack) override;
+
+    /**
+     * @brief Gets the instruction implemented by this command.
+     * @return eOpcode eOpcode::Move
+     */
+    eOpcode getOpcode() const override;
+
+private:
+    VirtualMachine* _vm;    ///< The VM owning the stacks
+    size_t _from;           ///< Index of the source stack
+    size_t _to;             ///< Index of the destination stack
+    size_t _count;          ///< Number of values to move
+};
+
+/**
+ * @class SavepointCommand
+ * @brief Command that saves the state of the stacks.
+ *
+ * Implements the 'savepoint' instruction. A later 'rollback' restores the
+ * stacks as they are now; 'commit' keeps the changes made since. Savepoints
+ * nest, and each 'rollback' or 'commit' ends the most recent one. Taking a
+ * savepoint copies nothing (see VirtualMachine::savepoint).
+ *
+ * ## Assembly Syntax
+ * ```
+ * savepoint
+ * push int32(0)
+ * div
+ * rollback
+ * ```
+ */
+class SavepointCommand : public ICommand {
+public:
+    /**
+     * @brief Constructor with VM reference.
+     * @param vm Pointer to the VirtualMachine owning the stacks
+     */
+    explicit SavepointCommand(VirtualMachine* vm);
+
+    /**
+     * @brief Executes the savepoint operation.
+     * @param stack The current stack (unused)
+     */
+    void execute(OperandStack& stack) override;
+
+    /**
+     * @brief Gets the instruction implemented by this command.
+     * @return eOpcode eOpcode::Savepoint
+     */
+    eOpcode getOpcode() const override;
+
+private:
+    VirtualMachine* _vm;    ///< The VM owning the stacks
+};
+
+/**
+ * @class RollbackCommand
+ * @brief Command that restores the stacks to the most recent savepoint.
+ *
+ * Implements the 'rollback' instruction. The savepoint ends.
+ *
+ * @throws SavepointException if no savepoint is active
+ */
+class RollbackCommand : public ICommand {
+public:
+    /**
+     * @brief Constructor with VM reference.
+     * @param vm Pointer to the VirtualMachine owning the stacks
+     */
+    explicit RollbackCommand(VirtualMachine* vm);
+
+    /**
+     * @brief Executes the rollback operation.
+     * @param stack The current stack (unused)
+     * @throws SavepointException if no savepoint is active
+     */
+    void execute(OperandStack& stack) override;
+
+    /**
+     * @brief Gets the instruction implemented by this command.
+     * @return eOpcode eOpcode::Rollback
+     */
+    eOpcode getOpcode() const override;
+
+private:
+    VirtualMachine* _vm;    ///< The VM owning the stacks
+};
+
+/**
+ * @class CommitCommand
+ * @brief Command that ends the most recent savepoint, keeping the changes.
+ *
+ * Implements the 'commit' instruction.
+ *
+ * @throws SavepointException if no savepoint is active
+ */
+class CommitCommand : public ICommand {
+public:
+    /**
+     * @brief Constructor with VM reference.
+     * @param vm Pointer to the VirtualMachine owning the stacks
+     */
+    explicit CommitCommand(VirtualMachine* vm);
+
+    /**
+     * @brief Executes the commit operation.
+     * @param stack The current stack (unused)
+     * @throws SavepointException if no savepoint is active
+     */
+    void execute(OperandStack& stack) override;
+
+    /**
+     * @brief Gets the instruction implemented by this command.
+     * @return eOpcode eOpcode::Commit
+     */
+    eOpcode getOpcode() const override;
+
+private:
+    VirtualMachine* _vm;    ///< The VM owning the stacks
+};
+
+/**
+ * @class OnErrorCommand
+ * @brief Command that installs an error handler block.
+ *
+ * Implements 'onerror' ... 'endonerror'. Once the command has run, an
+ * AbstractVMException raised by a later instruction of the same program
+ * or fork block no longer stops it: the stacks are left as they were
+ * before the failing instruction, the error code (see errorCode()) is
+ * pushed as an int8, the handler block runs, and execution resumes after
+ * the failing instruction. A later 'onerror' replaces the handler. Errors
+ * raised by the handler itself are not handled.
+ *
+ * Installing a handler is a pointer store, and the instructions it covers
+ * run with no extra work: the VM catches errors with a C++ try block,
+ * which costs nothing until an exception is thrown.
+ *
+ * ## Assembly Syntax
+ * ```
+ * onerror
+ *     pop             ; drop the error code
+ *     push int32(0)   ; use 0 instead of the failed result
+ * endonerror
+ * ```
+ */
+class OnErrorCommand : public ICommand {
+public:
+    /**
+     * @brief Constructor with VM reference and handler block.
+     * @param vm Pointer to the VirtualMachine running the program
+     * @param handler The instructions between 'onerror' and 'endonerror'
+     */
+    OnErrorCommand(VirtualMachine* vm, std::vector<std::unique_ptr<ICommand>> handler);
+
+    /**
+     * @brief Installs the handler.
+     * @param stack The current stack (unused)
+     */
+    void execute(OperandStack& stack) override;
+
+    /**
+     * @brief Gets the instruction implemented by this command.
+     * @return eOpcode eOpcode::OnError
+     */
+    eOpcode getOpcode() const override;
+
+private:
+    VirtualMachine* _vm;                                ///< The VM running the program
+    std::vector<std::unique_ptr<ICommand>> _handler;    ///< The handler block
+};
+
+/**
+ * @class PackedCommand
+ * @brief Command that evaluates several isomorphic expressions together.
+ *
+ * Produced by SuperwordPass, never by the parser. It replaces a run of
+ * independent expressions that have the same shape (same instructions and
+ * types, different values), such as:
+ * ```
+ * push int32(2)
+ * push int32(3)
+ * mul
+ * push int32(4)
+ * push int32(5)
+ * mul
+ * ```
+ * Each expression is a lane. Every instruction of the shape is executed
+ * once for all lanes over flat arrays of values, without allocating
+ * intermediate operands, and the lane results are pushed in program order.
+ *
+ * If any lane raises an error, the packed results are discarded and the
+ * original commands are executed one by one instead, so the error raised
+ * and the stack left behind are exactly those of the unoptimised program.
+ */
+class PackedCommand : public ICommand {
+public:
+    /**
+     * @brief Constructor with the original commands of all lanes.
+     * @param vm Pointer to the VirtualMachine instance (placeholder bindings)
+     * @param commands The original commands, lane after lane (takes ownership)
+     * @param lanes Number of lanes; every lane has commands.size() / lanes commands
+     */
+    PackedCommand(VirtualMachine* vm, std::vector<std::unique_ptr<ICommand>> commands,
+                  size_t lanes);
+
+    /**
+     * @brief Executes all lanes and pushes their results.
+     * @param stack The VM stack
+     * @throws AbstractVMException exactly as the original commands would
+     */
+    void execute(OperandStack& stack) override;
+
+    /**
+     * @brief Gets the instruction implemented by this command.
+     * @return eOpcode eOpcode::Packed
+     */
+    eOpcode getOpcode() const override;
+
+    /**
+     * @brief Gets the original commands, lane after lane.
+     * @return const std::vector<std::unique_ptr<ICommand>>& The commands
+     */
+    const std::vector<std::unique_ptr<ICommand>>& getCommands() const;
+
+    /**
+     * @brief Takes back the original commands, leaving the command empty.
+     * @return std::vector<std::unique_ptr<ICommand>> The commands, lane after lane
+     */
+    std::vector<std::unique_ptr<ICommand>> releaseCommands();
+
+    /**
+     * @brief Gets the number of lanes.
+     * @return size_t The number of packed expressions
+     */
+    size_t getLanes() const;
+
+    /**
+     * @brief Lists the commands of a program, expanding packed commands.
+     * @param commands The program
+     * @param flat Receives the commands in execution order
+     */
+    static void flatten(const std::vector<std::unique_ptr<ICommand>>& commands,
+                        std::vector<const ICommand*>& flat);
+
+private:
+    /**
+     * @struct Step
+     * @brief One instruction of the shape shared by all lanes.
+     */
+    struct Step {
+        eOpcode opcode;         ///< The instruction
+        size_t depth;           ///< Depth before the instruction, relative to the expression
+        eOperandType type;      ///< Pushed or result type
+        eOperandType rhsType;   ///< Right operand type (arithmetic)
+    };
+
+    VirtualMachine* _vm;                                ///< Pointer to the VirtualMachine
+    std::vector<std::unique_ptr<ICommand>> _commands;   ///< The original commands
+    size_t _lanes;                                      ///< Number of lanes
+    std::vector<Step> _steps;                           ///< The shape of one lane
+    std::vector<long double> _values;                   ///< Pushed constants, step-major
+    std::vector<size_t> _slots;                         ///< Pushed placeholder slots, step-major
+    std::vector<long double> _columns;                  ///< Lane values, depth-major
+    OperandFactory _factory;                            ///< Factory for the results
+
+    /**
+     * @brief Evaluates all lanes into _columns.
+     * @return bool False if any lane raises an error
+     */
+    bool evaluate();
+
+    /**
+     * @brief Executes the original commands one by one.
+     *
+     * The stacks are settled after each command, like the VM does after
+     * each instruction: many commands may push more than a plain push.
+     *
+     * @param stack The VM stack
+     */
+    void replay(OperandStack& stack);
+};
+
 #endif // COMMANDS_HPP
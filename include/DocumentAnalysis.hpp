@@ -0,0 +1,228 @@
+/**
+ * @file DocumentAnalysis.hpp
+ * @brief Defines the DocumentAnalysis class - incremental diagnostics and stack types of a source.
+ */
+
+#ifndef DOCUMENTANALYSIS_HPP
+#define DOCUMENTANALYSIS_HPP
+
+#include <cstdint>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+#include "eOpcode.hpp"
+#include "eOperandType.hpp"
+#include "VirtualMachine.hpp"
+
+/**
+ * @class DocumentAnalysis
+ * @brief Static analysis of a program being edited, updated line by line.
+ *
+ * Each line is lexed and parsed alone, once, when it is set. The result is
+ * cached: the syntax errors of the line (without the "at line N" of the
+ * messages, which the range of a diagnostic gives) and the stack effect of its
+ * instructions (push of a type, pop, arithmetic, assert of a type...).
+ *
+ * The stack before each line is computed by applying these effects from the
+ * first line, as a list of operand types, and kept in a prefix table. The
+ * stacks share their common bottom: they are nodes of a persistent stack,
+ * so the table costs one entry per line whatever the stack depth. This
+ * finds the errors that do not depend on values (pop on an empty stack,
+ * missing operands, assert or print of the wrong type) and gives the depth
+ * and types at each line.
+ *
+ * When lines are replaced, only they are parsed again, and the stacks are
+ * computed again from the first replaced line until the stack after a line
+ * is the same as before the edit: the following stacks and errors are
+ * unchanged. An edit in a long program usually reconverges within a few
+ * lines.
+ *
+ * The stack is not tracked after an instruction whose effect depends on
+ * other lines or on run time: blocks (fork, onerror), join, channels, named
+ * stacks, rollback, includes and macro uses. Lines between 'macro' and
+ * 'endmacro' are not executed where they are written and are not checked.
+ *
+ * ## Usage Example
+ * ```cpp
+ * DocumentAnalysis analysis;
+ * analysis.setText("push int32(1)\nadd\nexit\n");
+ * analysis.getDiagnostics();  // line 1: "Add requires at least 2 values on stack"
+ * analysis.replace(1, 2, {"push int8(2)", "add"});
+ * analysis.describe(2);        // stack after line 2: int32
+ * ```
+ */
+class DocumentAnalysis {
+public:
+    /**
+     * @struct Diagnostic
+     * @brief An error found on a line.
+     */
+    struct Diagnostic {
+        size_t line;            ///< Line index, from 0
+        std::string message;    ///< The error message
+    };
+
+    /**
+     * @brief Constructor for an empty document.
+     */
+    DocumentAnalysis();
+
+    /**
+     * @brief Analyses a whole document.
+     * @param text The source
+     */
+    void setText(const std::string& text);
+
+    /**
+     * @brief Replaces lines and updates the analysis.
+     * @param first Index of the first line replaced
+     * @param last One past the last line replaced (at least first + 1)
+     * @param lines The new lines, without newline (at least one)
+     */
+    void replace(size_t first, size_t last, const std::vector<std::string>& lines);
+
+    /**
+     * @brief Gets the number of lines.
+     * @return size_t Number of lines of the document
+     */
+    size_t getLineCount() const;
+
+    /**
+     * @brief Gets the errors of the document, in line order.
+     * @return std::vector<Diagnostic> The errors
+     */
+    std::vector<Diagnostic> getDiagnostics() const;
+
+    /**
+     * @brief Describes the stack after a line.
+     * @param line Line index, from 0
+     * @return std::string Depth and types of the stack, top first
+     */
+    std::string describe(size_t line) const;
+
+    /**
+     * @brief Gets the number of lines analysed by the last update.
+     * @return size_t Lines whose stack was computed again
+     */
+    size_t getAnalysedCount() const;
+
+private:
+    /**
+     * @struct Effect
+     * @brief Stack effect of one instruction.
+     */
+    struct Effect {
+        eOpcode opcode;         ///< The instruction
+        eOperandType type;      ///< Pushed, read or asserted type
+    };
+
+    /**
+     * @struct Line
+     * @brief Cached analysis of one line.
+     */
+    struct Line {
+        std::vector<Effect> effects;    ///< Effects of the instructions of the line
+        std::string syntax;             ///< Syntax errors, one per line of text, or empty
+        std::string stack;              ///< Stack error found with the stack before the line, or empty
+        std::string call;               ///< Name starting the line: a use if such a macro is defined
+        std::string macro;              ///< Name of the macro the line defines, or empty
+        bool endmacro;                  ///< True if the line ends a macro definition
+        bool opaque;                    ///< True if the stack is not tracked after the line
+        size_t exits;                   ///< Number of exit instructions
+    };
+
+    /**
+     * @struct Node
+     * @brief One value of a persistent stack.
+     */
+    struct Node {
+        uint32_t below;         ///< Node of the value below, 0 for the bottom
+        uint32_t depth;         ///< Number of values up to this one
+        eOperandType type;      ///< Type of the value
+    };
+
+    /**
+     * @brief State of the stack before or after a line.
+     */
+    enum class eState : uint8_t {
+        Known,      ///< The stack is the node list from top
+        Unknown,    ///< The stack is not tracked
+        Exited,     ///< The program has exited
+        Macro       ///< Inside a macro definition
+    };
+
+    /**
+     * @struct Stack
+     * @brief Entry of the prefix table.
+     */
+    struct Stack {
+        uint32_t top;           ///< Top node, 0 for an empty stack
+        eState state;           ///< Whether the stack is known
+    };
+
+    std::vector<Line> _lines;           ///< Cached analysis of each line
+    std::vector<Stack> _stacks;         ///< Stack before each line, plus after the last one
+    std::vector<Node> _nodes;           ///< Nodes of all the stacks; node 0 is the bottom
+    std::set<size_t> _errors;           ///< Lines with a syntax or stack error
+    std::map<std::string, size_t> _macros;  ///< Number of definitions of each macro name
+    size_t _exits;                      ///< Number of exit instructions of the document
+    size_t _analysed;                   ///< Lines analysed by the last update
+    size_t _compacted;                  ///< Number of nodes after the last full analysis
+    VirtualMachine _vm;                 ///< VM the lines are parsed for (channels, stacks, placeholders)
+
+    /**
+     * @brief Lexes and parses one line alone.
+     * @param text The line, without newline
+     * @param index Index of the line, for error messages
+     * @return Line The cached analysis, without stack error
+     */
+    Line parse(const std::string& text, size_t index);
+
+    /**
+     * @brief Applies the effects of a line to the stack before it.
+     * @param line The line
+     * @param before The stack before the line
+     * @param error Receives the first stack error of the line, or is cleared
+     * @return Stack The stack after the line
+     */
+    Stack apply(const Line& line, Stack before, std::string& error);
+
+    /**
+     * @brief Computes the stacks from a line until they reconverge.
+     * @param first Index of the first line whose effects changed
+     * @param last One past the last line whose effects changed
+     */
+    void propagate(size_t first, size_t last);
+
+    /**
+     * @brief Compares two stacks by value.
+     * @param lhs A stack
+     * @param rhs Another stack
+     * @return bool True if both have the same state, depth and types
+     */
+    bool equal(Stack lhs, Stack rhs) const;
+
+    /**
+     * @brief Counts the macro definitions of a line.
+     * @param line The line
+     * @param count 1 to add them, -1 to remove them
+     * @return bool True if a name became defined or undefined
+     */
+    bool countMacros(const Line& line, int count);
+
+    /**
+     * @brief Checks if the syntax errors of a line are reported.
+     * @param index Index of the line
+     * @return bool False for lines in macro definitions and uses of defined macros
+     */
+    bool reportsSyntax(size_t index) const;
+
+    /**
+     * @brief Records whether a line has errors.
+     * @param index Index of the line
+     */
+    void updateErrors(size_t index);
+};
+
+#endif // DOCUMENTANALYSIS_HPP
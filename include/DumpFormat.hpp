@@ -0,0 +1,200 @@
+/**
+ * @file DumpFormat.hpp
+ * @brief Output formats of the 'dump' instruction and the binary dump encoder.
+ */
+
+#ifndef DUMPFORMAT_HPP
+#define DUMPFORMAT_HPP
+
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include "eOperandType.hpp"
+#include "IOperand.hpp"
+#include "OperandBuffer.hpp"
+
+/**
+ * @enum eDumpFormat
+ * @brief How 'dump' writes the stack to the standard output.
+ */
+enum class eDumpFormat {
+    Text,   ///< One value per line, formatted like IOperand::toString() (default)
+    Binary, ///< Typed binary array (see BinaryDumpWriter)
+    Jsonl,  ///< One JSON object per line: {"type":"int32","value":42}
+    Csv     ///< One CSV record per line: int32,42
+};
+
+/**
+ * @brief Parses the name of a dump format.
+ * @param name The name ("text", "binary", "jsonl" or "csv")
+ * @param format Receives the format
+ * @return bool False if the name is unknown
+ */
+bool parseDumpFormat(const std::string& name, eDumpFormat& format);
+
+/**
+ * @brief Number of values formatted at once by each thread of a text dump.
+ */
+constexpr size_t textChunkSize = 1 << 16;
+
+/**
+ * @brief Largest line of a text, JSON Lines or CSV dump.
+ */
+constexpr size_t maxEntrySize = 64;
+
+/**
+ * @brief Formats one line of a text, JSON Lines or CSV dump.
+ *
+ * The line is assembled in place from the type name and the text of the
+ * value, without allocating. JSON has no nan or inf: JSON Lines writes
+ * such values as strings ({"type":"double","value":"nan"}).
+ *
+ * @param buffer Destination buffer, of at least maxEntrySize characters
+ * @param format Text, Jsonl or Csv
+ * @param type The operand type
+ * @param text The value, formatted like IOperand::toString()
+ * @param length Length of the value text
+ * @return size_t Number of characters written, including the newline
+ */
+size_t formatEntry(char* buffer, eDumpFormat format, eOperandType type, const char* text,
+                   size_t length);
+
+/**
+ * @brief Writes values as text, one per line, and flushes the stream.
+ *
+ * Each line is the IOperand::toString() of a value, or a JSON Lines or CSV
+ * entry (see formatEntry). Dumps of more than one chunk are split into
+ * chunks of textChunkSize values formatted concurrently into per-thread
+ * buffers, which are then written in order, one round of chunks at a time,
+ * so the memory used does not grow with the size of the dump.
+ *
+ * @param output The stream written to
+ * @param begin First value written (the oldest)
+ * @param end One past the last value written
+ * @param threads Number of threads formatting chunks (1 formats on the calling thread)
+ * @param format Text, Jsonl or Csv
+ */
+void writeTextDump(std::ostream& output, OperandBuffer::const_iterator begin,
+                   OperandBuffer::const_iterator end, size_t threads,
+                   eDumpFormat format = eDumpFormat::Text);
+
+/**
+ * @brief Gets the size of the native representation of a type.
+ * @param type The operand type
+ * @return size_t 1, 2 or 4 for the integer types, 4 for float, 8 for double
+ */
+size_t nativeSize(eOperandType type);
+
+/**
+ * @brief Appends the header of a binary dump to a buffer.
+ * @param buffer The buffer
+ * @param count Number of values that follow
+ */
+void appendBinaryHeader(std::string& buffer, uint64_t count);
+
+/**
+ * @brief Appends the marker of an incremental dump to a buffer.
+ *
+ * The marker gives the lowest stack position changed since the previous
+ * dump; the values from that position to the top follow as a dump in the
+ * same format. Text writes "@i", JSON Lines {"offset":i} and CSV offset,i,
+ * each on its own line. Binary writes a 16-byte header laid out like that
+ * of a dump (see BinaryDumpWriter), with the magic "AVMO" and the position
+ * in place of the number of values.
+ *
+ * @param buffer The buffer
+ * @param format The dump format
+ * @param first Lowest position changed
+ */
+void appendDeltaMarker(std::string& buffer, eDumpFormat format, uint64_t first);
+
+/**
+ * @brief Appends one value of a binary dump to a buffer.
+ * @param buffer The buffer
+ * @param type The operand type
+ * @param value The value, which fits the type
+ */
+void appendBinaryValue(std::string& buffer, eOperandType type, long double value);
+
+/**
+ * @brief Largest encoded value of a binary dump: a type byte and a double.
+ */
+constexpr size_t maxBinaryValueSize = 1 + sizeof(double);
+
+/**
+ * @brief Reads one value of a binary dump written on this machine.
+ * @param data The encoded value
+ * @param type Receives the operand type
+ * @param value Receives the value
+ * @return size_t Number of bytes read
+ * @throws OutputException if the type byte is not an operand type
+ */
+size_t readBinaryValue(const char* data, eOperandType& type, long double& value);
+
+/**
+ * @class BinaryDumpWriter
+ * @brief Streams a binary dump to an output stream.
+ *
+ * A binary dump is a 16-byte header followed by the values, oldest first:
+ *
+ * | Offset | Size | Content                                          |
+ * |--------|------|--------------------------------------------------|
+ * | 0      | 4    | Magic "AVMD"                                     |
+ * | 4      | 1    | Format version (1)                               |
+ * | 5      | 1    | Byte order of the values: 1 little, 2 big endian |
+ * | 6      | 2    | Reserved (0)                                     |
+ * | 8      | 8    | Number of values (uint64, in that byte order)    |
+ *
+ * Each value is a type byte (the eOperandType: 0 int8 to 4 double)
+ * followed by the value in its native representation and size (int8_t,
+ * int16_t, int32_t, float or double) in the byte order of the header.
+ *
+ * Values are encoded into a buffer written with one large write each time
+ * it fills up, so no value is ever formatted as text.
+ *
+ * ## Usage Example
+ * ```cpp
+ * BinaryDumpWriter writer(file, values.size());
+ * for (const IOperand* value : values) {
+ *     writer.write(value->getType(), value->getValue());
+ * }
+ * writer.finish();
+ * ```
+ */
+class BinaryDumpWriter {
+public:
+    /**
+     * @brief Size of the buffer written at once.
+     */
+    static constexpr size_t bufferSize = 1 << 20;
+
+    /**
+     * @brief Constructor, which encodes the header.
+     * @param output The stream written to
+     * @param count Number of values that will be written
+     */
+    BinaryDumpWriter(std::ostream& output, uint64_t count);
+
+    /**
+     * @brief Writes a value.
+     * @param type The operand type
+     * @param value The value, which fits the type
+     */
+    void write(eOperandType type, long double value);
+
+    /**
+     * @brief Writes the buffered values and flushes the stream.
+     */
+    void finish();
+
+private:
+    std::ostream& _output;  ///< The stream written to
+    std::string _buffer;    ///< Encoded values not written yet
+
+    /**
+     * @brief Writes the buffer to the stream.
+     */
+    void flushBuffer();
+};
+
+#endif // DUMPFORMAT_HPP
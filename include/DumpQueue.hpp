@@ -0,0 +1,150 @@
+/**
+ * @file DumpQueue.hpp
+ * @brief Defines the DumpQueue class - dumps written by a background thread.
+ */
+
+#ifndef DUMPQUEUE_HPP
+#define DUMPQUEUE_HPP
+
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <thread>
+#include "DumpFormat.hpp"
+
+/**
+ * @class DumpQueue
+ * @brief Output of a VM written in order by a background thread.
+ *
+ * A dump takes a snapshot of the values, encoded like a binary dump (a type
+ * byte and the native value, 2 to 9 bytes per value, see BinaryDumpWriter),
+ * and queues it; the writer thread formats and writes it while execution
+ * continues. Characters printed between dumps are queued after them, so the
+ * output is written in program order.
+ *
+ * The snapshots queued and not written yet use at most the memory limit: a
+ * dump that would exceed it waits for the writer (a single snapshot larger
+ * than the limit waits until the queue is empty). finish() waits until the
+ * queue is written, and must be called before anything else is written to
+ * the stream or to the error stream, such as an error message.
+ *
+ * A job the writer fails on (an unknown type byte in a snapshot) stops the
+ * output: the error is raised by the next call of dump(), write() or
+ * finish(), and the jobs queued after it are dropped.
+ *
+ * ## Usage Example
+ * ```cpp
+ * DumpQueue queue(std::cout);
+ * queue.dump(values.begin(), values.end(), eDumpFormat::Text);
+ * queue.write("!", 1);
+ * queue.finish();
+ * ```
+ */
+class DumpQueue {
+public:
+    /**
+     * @brief Default limit of the memory used by queued snapshots.
+     */
+    static constexpr size_t defaultMemoryLimit = 64 << 20;
+
+    /**
+     * @brief Values of a dump, oldest first.
+     */
+    using Values = OperandBuffer::const_iterator;
+
+    /**
+     * @brief Constructor, which starts the writer thread.
+     * @param output The stream written to
+     * @param memoryLimit Limit of the memory used by queued snapshots, in bytes
+     */
+    explicit DumpQueue(std::ostream& output, size_t memoryLimit = defaultMemoryLimit);
+
+    /**
+     * @brief Destructor, which writes the queue and stops the writer thread.
+     */
+    ~DumpQueue();
+
+    /**
+     * @brief Deleted copy constructor (non-copyable).
+     */
+    DumpQueue(const DumpQueue&) = delete;
+
+    /**
+     * @brief Deleted copy assignment operator (non-copyable).
+     */
+    DumpQueue& operator=(const DumpQueue&) = delete;
+
+    /**
+     * @brief Queues a dump of values.
+     * @param begin First value (the oldest)
+     * @param end One past the last value
+     * @param format The dump format
+     * @throws OutputException if the writer failed on an earlier job
+     */
+    void dump(Values begin, Values end, eDumpFormat format);
+
+    /**
+     * @brief Queues text, written after the dumps queued before it.
+     * @param text The text
+     * @param length Number of characters
+     * @throws OutputException if the writer failed on an earlier job
+     */
+    void write(const char* text, size_t length);
+
+    /**
+     * @brief Waits until the queue is written, and flushes the stream.
+     * @throws OutputException if the writer failed on a job
+     */
+    void finish();
+
+    /**
+     * @brief Gets the limit of the memory used by queued snapshots.
+     * @return size_t The limit, in bytes
+     */
+    size_t getMemoryLimit() const;
+
+private:
+    /**
+     * @struct Job
+     * @brief Output waiting to be written.
+     */
+    struct Job {
+        bool values;            ///< True for a dump, false for text
+        eDumpFormat format;     ///< Format of the dump
+        uint64_t count;         ///< Number of values of the dump
+        std::string data;       ///< Encoded values, or the text
+    };
+
+    std::ostream& _output;              ///< The stream written to
+    size_t _memoryLimit;                ///< Limit of the memory used by queued snapshots
+    size_t _pending;                    ///< Bytes of snapshots queued or being written
+    std::deque<Job> _jobs;              ///< Output waiting to be written, oldest first
+    bool _busy;                         ///< True while the writer is writing a job
+    bool _stopping;                     ///< Set by the destructor
+    std::exception_ptr _error;          ///< Error of the writer, raised by the next call
+    std::mutex _mutex;                  ///< Protects the fields above
+    std::condition_variable _queued;    ///< Signalled when a job is queued or stopping
+    std::condition_variable _written;   ///< Signalled when a job is written
+    std::thread _writer;                ///< The writer thread
+
+    /**
+     * @brief Body of the writer thread.
+     */
+    void run();
+
+    /**
+     * @brief Raises the error of the writer, if any; the mutex must be held.
+     */
+    void raiseError();
+
+    /**
+     * @brief Formats and writes a job.
+     * @param job The job
+     */
+    void writeJob(const Job& job);
+};
+
+#endif // DUMPQUEUE_HPP
@@ -6,9 +6,10 @@
 #ifndef ICOMMAND_HPP
 #define ICOMMAND_HPP
 
-#include <stack>
 #include <memory>
 #include "IOperand.hpp"
+#include "OperandBuffer.hpp"
+#include "eOpcode.hpp"
 
 /**
  * @interface ICommand
@@ -27,7 +28,7 @@
  *
  * ## Usage Example
  * ```cpp
- * std::stack<const IOperand*> stack;
+ * OperandStack stack;
  * std::unique_ptr<ICommand> cmd = std::make_unique<PushCommand>(operand);
  * cmd->execute(stack);
  * ```
@@ -43,7 +44,13 @@ public:
      * @param stack Reference to the VM's operand stack
      * @throws AbstractVMException or derived exceptions on error
      */
-    virtual void execute(std::stack<const IOperand*>& stack) = 0;
+    virtual void execute(OperandStack& stack) = 0;
+
+    /**
+     * @brief Gets the instruction implemented by this command.
+     * @return eOpcode The opcode of the instruction
+     */
+    virtual eOpcode getOpcode() const = 0;
 
     /**
      * @brief Virtual destructor for proper polymorphic deletion.
@@ -121,6 +121,16 @@ public:
      */
     virtual const IOperand* operator%(const IOperand& rhs) const = 0;
 
+    /**
+     * @brief Gets the native value of this operand.
+     *
+     * The value is widened to long double, which represents every value of
+     * every operand type exactly. Used by engines that work on raw values.
+     *
+     * @return long double The value of this operand
+     */
+    virtual long double getValue(void) const = 0;
+
     /**
      * @brief Gets the string representation of this operand's value.
      *
@@ -131,6 +141,16 @@ public:
      */
     virtual const std::string& toString(void) const = 0;
 
+    /**
+     * @brief Creates a copy of this operand.
+     *
+     * Used by commands that keep their operand across executions, so a
+     * parsed program can be run several times.
+     *
+     * @return const IOperand* Pointer to a new operand of the same type and value
+     */
+    virtual const IOperand* clone(void) const = 0;
+
     /**
      * @brief Virtual destructor for proper polymorphic deletion.
      *
@@ -0,0 +1,112 @@
+/**
+ * @file LanguageServer.hpp
+ * @brief Defines the LanguageServer class - diagnostics and hovers for editors.
+ */
+
+#ifndef LANGUAGESERVER_HPP
+#define LANGUAGESERVER_HPP
+
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+#include "DocumentAnalysis.hpp"
+
+/**
+ * @class LanguageServer
+ * @brief Language Server Protocol server for AbstractVM programs.
+ *
+ * Reads JSON-RPC messages framed by Content-Length headers from an input
+ * stream and writes responses and notifications to an output stream, as
+ * editors expect from a server started on stdin/stdout.
+ *
+ * Open documents are kept as lines and synchronised incrementally: each
+ * change replaces a range of lines, and only those lines are analysed again
+ * (see DocumentAnalysis). After each change the server publishes the
+ * errors of the document. Hovering a line shows the depth and the types of
+ * the stack after it.
+ *
+ * Supported methods: initialize, initialized, shutdown, exit,
+ * textDocument/didOpen, textDocument/didChange, textDocument/didClose and
+ * textDocument/hover. Other requests get a "method not found" error.
+ * Positions are counted in bytes, which matches the UTF-16 units of the
+ * protocol for the ASCII sources of the language.
+ *
+ * ## Usage Example
+ * ```cpp
+ * LanguageServer server(std::cin, std::cout);
+ * return server.run();
+ * ```
+ */
+class LanguageServer {
+public:
+    /**
+     * @brief Constructor.
+     * @param input Stream the client writes requests to
+     * @param output Stream the client reads responses from
+     */
+    LanguageServer(std::istream& input, std::ostream& output);
+
+    /**
+     * @brief Serves requests until the client sends exit or closes the input.
+     *
+     * Reports the lines analysed by each change on the error stream.
+     *
+     * @return int The process exit status: 0 if shutdown preceded exit, 1 otherwise
+     */
+    int run();
+
+private:
+    /// Parsed JSON value (defined in the source file)
+    struct Json;
+
+    /**
+     * @struct Document
+     * @brief An open document.
+     */
+    struct Document {
+        std::vector<std::string> lines;     ///< Text of each line, without newline
+        DocumentAnalysis analysis;          ///< Analysis of the lines
+    };
+
+    std::istream& _input;                       ///< Requests from the client
+    std::ostream& _output;                      ///< Responses to the client
+    std::map<std::string, Document> _documents; ///< Open documents by URI
+    bool _shutdown;                             ///< True once shutdown was requested
+
+    /**
+     * @brief Reads the content of one message.
+     * @param content Receives the JSON text
+     * @return bool False at the end of the input
+     */
+    bool receive(std::string& content);
+
+    /**
+     * @brief Writes one message with its header.
+     * @param content The JSON text
+     */
+    void send(const std::string& content);
+
+    /**
+     * @brief Handles one request or notification.
+     * @param message The message
+     * @return bool False if the message is exit
+     */
+    bool handle(const Json& message);
+
+    /**
+     * @brief Applies a change to a document.
+     * @param document The document
+     * @param change One element of contentChanges
+     */
+    void change(Document& document, const Json& change);
+
+    /**
+     * @brief Sends the errors of a document.
+     * @param uri URI of the document
+     * @param document The document, or nullptr to clear its errors
+     */
+    void publish(const std::string& uri, const Document* document);
+};
+
+#endif // LANGUAGESERVER_HPP
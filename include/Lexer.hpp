@@ -85,6 +85,17 @@ public:
      */
     bool hasErrors() const;
 
+    /**
+     * @brief Checks if a text is a numeric literal, as read in a program.
+     *
+     * An optional sign, digits, and an optional '.' followed by digits:
+     * "nan", "inf", exponents and hexadecimal numbers are not literals.
+     *
+     * @param text The text
+     * @return bool True if the whole text is a numeric literal
+     */
+    static bool isNumber(const std::string& text);
+
 private:
     std::istream& _input;                ///< Reference to the input stream
     bool _fromStdin;                     ///< Flag for stdin input (handles ";;" terminator)
@@ -128,6 +139,19 @@ private:
      */
     Token readNumber();
 
+    /**
+     * @brief Reads a placeholder ('$' followed by a name or a position).
+     * @return Token The placeholder token, whose value is the name without '$'
+     */
+    Token readPlaceholder();
+
+    /**
+     * @brief Reads a double-quoted string, which ends on the same line.
+     * @return Token The string token, whose value is the text between the quotes
+     * @throws LexicalException if the closing quote is missing (fail-fast mode)
+     */
+    Token readString();
+
     /**
      * @brief Determines if a character is a valid identifier start.
      * @param c The character to check
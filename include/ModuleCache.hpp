@@ -0,0 +1,72 @@
+/**
+ * @file ModuleCache.hpp
+ * @brief Defines the ModuleCache class - lexed modules shared by 'include'.
+ */
+
+#ifndef MODULECACHE_HPP
+#define MODULECACHE_HPP
+
+#include <cstdint>
+#include <filesystem>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "Token.hpp"
+
+/**
+ * @struct Module
+ * @brief A source file lexed once for all the programs including it.
+ */
+struct Module {
+    std::string path;                           ///< Canonical path of the file
+    std::vector<Token> tokens;                  ///< Tokens of the file, ending with END_FILE
+    std::filesystem::file_time_type modified;   ///< Modification time when lexed
+    std::uintmax_t size;                        ///< File size when lexed
+};
+
+/**
+ * @class ModuleCache
+ * @brief Process-wide cache of the modules named by 'include' instructions.
+ *
+ * A module is lexed the first time it is included, and its tokens are
+ * reused by every later include, from any program or VM of the process. A
+ * file modified since it was lexed (different modification time or size)
+ * is lexed again. The tokens, not the commands, are cached: commands are
+ * bound to the VM that parsed them (placeholders, channels, stacks), so
+ * each include parses the cached tokens into the commands of its program.
+ *
+ * ## Usage Example
+ * ```cpp
+ * std::shared_ptr<const Module> module = ModuleCache::instance().get("common.avm");
+ * Parser parser(module->tokens, true, vm);
+ * ```
+ */
+class ModuleCache {
+public:
+    /**
+     * @brief Gets the cache of the process.
+     * @return ModuleCache& The cache
+     */
+    static ModuleCache& instance();
+
+    /**
+     * @brief Gets a module, lexing the file if needed.
+     * @param path Path of the file
+     * @return std::shared_ptr<const Module> The module (valid even if the cache is cleared)
+     * @throws std::runtime_error if the file cannot be read
+     */
+    std::shared_ptr<const Module> get(const std::filesystem::path& path);
+
+    /**
+     * @brief Forgets all modules.
+     */
+    void clear();
+
+private:
+    std::mutex _mutex;                                              ///< Protects _modules
+    std::map<std::string, std::shared_ptr<const Module>> _modules;  ///< Modules by canonical path
+};
+
+#endif // MODULECACHE_HPP
@@ -7,11 +7,10 @@
 #define OPERAND_HPP
 
 #include <string>
-#include <sstream>
 #include <cmath>
 #include <limits>
-#include <iomanip>
 #include "IOperand.hpp"
+#include "Arithmetic.hpp"
 #include "AbstractVMException.hpp"
 #include "OperandFactory.hpp"
 
@@ -66,6 +65,22 @@ public:
         _strValue = valueToString(_value);
     }
 
+    /**
+     * @brief Constructor that creates an operand from a native value.
+     *
+     * Used when the value is already available in binary form (for example
+     * from the 'read' instruction), which avoids a round trip through text.
+     *
+     * @param value The numeric value
+     * @throws OverflowException if value exceeds type maximum
+     * @throws UnderflowException if value is below type minimum
+     */
+    explicit Operand(long double value) {
+        validateBounds(value);
+        _value = static_cast<T>(value); // Safe after bounds check
+        _strValue = valueToString(_value);
+    }
+
     /**
      * @brief Copy constructor.
      * @param other The operand to copy from
@@ -113,11 +128,11 @@ public:
     const IOperand* operator+(const IOperand& rhs) const override {
         eOperandType resultType = (getPrecision() >= rhs.getPrecision()) ? Type : rhs.getType();
         long double leftValue = static_cast<long double>(_value);
-        long double rightValue = std::stold(rhs.toString());
+        long double rightValue = rhsValue(rhs.getType(), rhs.getValue());
         long double resultValue = leftValue + rightValue;
 
         OperandFactory factory;
-        return factory.createOperand(resultType, std::to_string(resultValue));
+        return factory.createOperand(resultType, roundResult(resultValue));
     }
 
     /**
@@ -129,11 +144,11 @@ public:
     const IOperand* operator-(const IOperand& rhs) const override {
         eOperandType resultType = (getPrecision() >= rhs.getPrecision()) ? Type : rhs.getType();
         long double leftValue = static_cast<long double>(_value);
-        long double rightValue = std::stold(rhs.toString());
+        long double rightValue = rhsValue(rhs.getType(), rhs.getValue());
         long double resultValue = leftValue - rightValue;
 
         OperandFactory factory;
-        return factory.createOperand(resultType, std::to_string(resultValue));
+        return factory.createOperand(resultType, roundResult(resultValue));
     }
 
     /**
@@ -145,11 +160,11 @@ public:
     const IOperand* operator*(const IOperand& rhs) const override {
         eOperandType resultType = (getPrecision() >= rhs.getPrecision()) ? Type : rhs.getType();
         long double leftValue = static_cast<long double>(_value);
-        long double rightValue = std::stold(rhs.toString());
+        long double rightValue = rhsValue(rhs.getType(), rhs.getValue());
         long double resultValue = leftValue * rightValue;
 
         OperandFactory factory;
-        return factory.createOperand(resultType, std::to_string(resultValue));
+        return factory.createOperand(resultType, roundResult(resultValue));
     }
 
     /**
@@ -159,7 +174,7 @@ public:
      * @throws DivisionByZeroException if divisor is zero
      */
     const IOperand* operator/(const IOperand& rhs) const override {
-        long double rightValue = std::stold(rhs.toString());
+        long double rightValue = rhsValue(rhs.getType(), rhs.getValue());
         if (rightValue == 0.0) {
             throw DivisionByZeroException("Division by zero error.");
         }
@@ -169,7 +184,7 @@ public:
         long double resultValue = leftValue / rightValue;
 
         OperandFactory factory;
-        return factory.createOperand(resultType, std::to_string(resultValue));
+        return factory.createOperand(resultType, roundResult(resultValue));
     }
 
     /**
@@ -179,7 +194,7 @@ public:
      * @throws DivisionByZeroException if divisor is zero
      */
     const IOperand* operator%(const IOperand& rhs) const override {
-        long double rightValue = std::stold(rhs.toString());
+        long double rightValue = rhsValue(rhs.getType(), rhs.getValue());
         if (rightValue == 0.0) {
             throw DivisionByZeroException("Division by zero error.");
         }
@@ -189,7 +204,15 @@ public:
         long double resultValue = fmodl(leftValue, rightValue);
 
         OperandFactory factory;
-        return factory.createOperand(resultType, std::to_string(resultValue));
+        return factory.createOperand(resultType, roundResult(resultValue));
+    }
+
+    /**
+     * @brief Gets the native value of this operand.
+     * @return long double The value widened to long double
+     */
+    long double getValue(void) const override {
+        return static_cast<long double>(_value);
     }
 
     /**
@@ -200,6 +223,14 @@ public:
         return _strValue;
     }
 
+    /**
+     * @brief Creates a copy of this operand.
+     * @return const IOperand* Pointer to a new operand with the same value
+     */
+    const IOperand* clone(void) const override {
+        return new Operand(*this);
+    }
+
     /**
      * @brief Destructor.
      */
@@ -212,13 +243,18 @@ private:
     /**
      * @brief Validates that a long double value fits within type T bounds.
      * @param value The value to validate
-     * @throws OverflowException if value is too large
+     * @throws OverflowException if value is too large, or NaN for an integer type
      * @throws UnderflowException if value is too small
      */
     void validateBounds(long double value) const {
         long double typeMin = static_cast<long double>(std::numeric_limits<T>::lowest());
         long double typeMax = static_cast<long double>(std::numeric_limits<T>::max());
 
+        if (std::numeric_limits<T>::is_integer && std::isnan(value)) {
+            // NaN passes both comparisons, and converting it to T is undefined
+            throw OverflowException("Overflow: Value nan is not a number for an integer type.");
+        }
+
         if (value < typeMin) {
             throw UnderflowException("Underflow: Value " + std::to_string(value) +
                                      " is below minimum for type.");
@@ -235,13 +271,7 @@ private:
      * @return std::string The formatted string
      */
     std::string valueToString(T value) const {
-        std::ostringstream oss;
-        if (Type == eOperandType::Float || Type == eOperandType::Double) {
-            oss << std::setprecision(std::numeric_limits<T>::digits10 + 1) << value;
-        } else {
-            oss << static_cast<int64_t>(value);
-        }
-        return oss.str();   
+        return formatValue(Type, static_cast<long double>(value));
     }
 };
 
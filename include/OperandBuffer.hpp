@@ -0,0 +1,438 @@
+/**
+ * @file OperandBuffer.hpp
+ * @brief Defines the OperandBuffer class - operand stack storage grown by guard-page faults.
+ */
+
+#ifndef OPERANDBUFFER_HPP
+#define OPERANDBUFFER_HPP
+
+#include <csignal>
+#include <cstddef>
+#include <stack>
+#include <string>
+#include "IOperand.hpp"
+
+#ifndef AVM_STACK_REGION_BITS
+/**
+ * @brief Log2 of the virtual memory reserved per stack by default (28: 256 MiB).
+ *
+ * Can be set at build time (-D AVM_STACK_REGION_BITS=30) to trade the
+ * default stack limit against the number of stacks the address space
+ * holds; OperandBuffer::setLimit() chooses the size at run time.
+ */
+# define AVM_STACK_REGION_BITS 28
+#endif
+
+static_assert(AVM_STACK_REGION_BITS >= 24 && AVM_STACK_REGION_BITS <= 36,
+              "AVM_STACK_REGION_BITS must be between 24 and 36");
+
+/**
+ * @class OperandBuffer
+ * @brief Contiguous container of operand pointers whose push_back has no capacity check.
+ *
+ * Each buffer takes a region of virtual memory (a power of two, sized for
+ * the limit, see setLimit()) where only the beginning is accessible. Pushing past the accessible part
+ * touches a protected page: a SIGSEGV handler, installed with the first
+ * buffer, recognises the region from the faulting address, makes more of
+ * it accessible and returns, and the push is executed again. A push is
+ * therefore a store and an increment, without a branch or an allocation.
+ *
+ * The values of a buffer never move, which also gives random access and
+ * block transfers like a vector. Savepoints freeze the values in place
+ * (freeze()) and take no other region. Regions are
+ * reserved by batches and never unmapped: released regions give back their
+ * pages and are protected again, so that free regions merge back into one
+ * mapping, and are kept for the next buffers.
+ *
+ * A buffer built with OperandBuffer::deferred takes its region only when
+ * reserveRegion() is called: VirtualMachine builds its stacks this way
+ * and reserves them when it runs, so that the child VMs created for each
+ * fork at parse time cost nothing until their block runs, and give their
+ * regions back when it ends.
+ *
+ * The handler only opens pages prepared outside of it, where a failure
+ * can be raised: the first page of a region is opened when the buffer
+ * takes it, so that growing only extends that mapping, and without
+ * overcommit the pages are charged ahead. When the room prepared runs
+ * low, or when a buffer passes its limit of getLimit() values, the
+ * handler records it (faulted()): VirtualMachine checks the flag after
+ * each instruction and calls settle() on its buffers, which prepares more
+ * room, or removes the values past the limit. Past the limit, the handler
+ * opens a spare area (spareSize bytes) so that the instruction completes,
+ * and VirtualMachine then throws StackLimitException.
+ *
+ * A plain push stores at most a few values per instruction; instructions
+ * pushing many values at once call reserve() first, which raises the
+ * limit or memory error before any value is stored. Faults outside the
+ * room prepared, and at other addresses, are passed to the previous
+ * handler.
+ *
+ * Used as the container of OperandStack, in place of std::deque.
+ *
+ * ## Usage Example
+ * ```cpp
+ * OperandStack stack;
+ * stack.push(operand);          // plain store, grows on fault
+ * if (OperandBuffer::faulted()) {
+ *     // settle() the buffers of this thread, then clearFault()
+ * }
+ * ```
+ */
+class OperandBuffer {
+public:
+    using value_type = const IOperand*;                 ///< Stored values
+    using size_type = size_t;                           ///< Sizes
+    using difference_type = std::ptrdiff_t;             ///< Distances
+    using reference = value_type&;                      ///< Reference to a value
+    using const_reference = const value_type&;          ///< Const reference to a value
+    using iterator = value_type*;                       ///< Iterator, bottom first
+    using const_iterator = const value_type*;           ///< Const iterator, bottom first
+
+    /**
+     * @brief Size of the area opened past the limit, in bytes.
+     */
+    static constexpr size_t spareSize = size_t(1) << 20;
+
+    /**
+     * @struct Deferred
+     * @brief Tag of the constructor that does not reserve a region.
+     */
+    struct Deferred {};
+
+    /**
+     * @brief Tag value for OperandBuffer(Deferred).
+     */
+    static constexpr Deferred deferred{};
+
+    /**
+     * @brief Constructor, which reserves the region of the buffer.
+     * @throws StackLimitException if the region cannot be reserved
+     */
+    OperandBuffer();
+
+    /**
+     * @brief Constructor without a region: reserveRegion() must be called before push_back().
+     */
+    explicit OperandBuffer(Deferred);
+
+    /**
+     * @brief Copy constructor, into a new region.
+     * @param other The buffer copied
+     */
+    OperandBuffer(const OperandBuffer& other);
+
+    /**
+     * @brief Move constructor; the moved-from buffer has no region.
+     * @param other The buffer moved
+     */
+    OperandBuffer(OperandBuffer&& other) noexcept;
+
+    /**
+     * @brief Assignment, by copy or move and swap.
+     * @param other The buffer assigned
+     * @return OperandBuffer& This buffer
+     */
+    OperandBuffer& operator=(OperandBuffer other) noexcept;
+
+    /**
+     * @brief Destructor, which releases the region (kept for the next buffer).
+     */
+    ~OperandBuffer();
+
+    /**
+     * @brief Appends a value; passing the limit is detected afterwards (see faulted()).
+     * @param value The value
+     */
+    void push_back(value_type value) {
+        *_end++ = value;
+    }
+
+    /**
+     * @brief Removes the last value.
+     */
+    void pop_back() {
+        --_end;
+    }
+
+    /**
+     * @brief Gets the last value.
+     * @return reference The last value
+     */
+    reference back() {
+        return _end[-1];
+    }
+
+    /**
+     * @brief Gets the last value.
+     * @return const_reference The last value
+     */
+    const_reference back() const {
+        return _end[-1];
+    }
+
+    /**
+     * @brief Gets a value by index.
+     * @param index Index from the bottom
+     * @return reference The value
+     */
+    reference operator[](size_t index) {
+        return _begin[index];
+    }
+
+    /**
+     * @brief Gets a value by index.
+     * @param index Index from the bottom
+     * @return const_reference The value
+     */
+    const_reference operator[](size_t index) const {
+        return _begin[index];
+    }
+
+    /**
+     * @brief Gets the first (bottom) value.
+     * @return iterator The first value
+     */
+    iterator begin() {
+        return _begin;
+    }
+
+    /**
+     * @brief Gets the end of the values.
+     * @return iterator One past the last value
+     */
+    iterator end() {
+        return _end;
+    }
+
+    /**
+     * @brief Gets the first (bottom) value.
+     * @return const_iterator The first value
+     */
+    const_iterator begin() const {
+        return _begin;
+    }
+
+    /**
+     * @brief Gets the end of the values.
+     * @return const_iterator One past the last value
+     */
+    const_iterator end() const {
+        return _end;
+    }
+
+    /**
+     * @brief Gets the first (bottom) value.
+     * @return const_iterator The first value
+     */
+    const_iterator cbegin() const {
+        return _begin;
+    }
+
+    /**
+     * @brief Gets the end of the values.
+     * @return const_iterator One past the last value
+     */
+    const_iterator cend() const {
+        return _end;
+    }
+
+    /**
+     * @brief Gets the number of values.
+     * @return size_t Number of values
+     */
+    size_t size() const {
+        return static_cast<size_t>(_end - _begin);
+    }
+
+    /**
+     * @brief Checks if the buffer is empty.
+     * @return bool True if there is no value
+     */
+    bool empty() const {
+        return _end == _begin;
+    }
+
+    /**
+     * @brief Removes all values (they are not deleted).
+     */
+    void clear() {
+        _end = _begin;
+    }
+
+    /**
+     * @brief Inserts copies of a value.
+     * @param position Where the values are inserted
+     * @param count Number of values
+     * @param value The value
+     * @return iterator The first inserted value
+     * @throws StackLimitException if the buffer would exceed its limit
+     */
+    iterator insert(const_iterator position, size_t count, value_type value);
+
+    /**
+     * @brief Inserts a range of values.
+     * @param position Where the values are inserted
+     * @param first First value inserted
+     * @param last One past the last value inserted
+     * @return iterator The first inserted value
+     * @throws StackLimitException if the buffer would exceed its limit
+     */
+    iterator insert(const_iterator position, const_iterator first, const_iterator last);
+
+    /**
+     * @brief Removes a range of values.
+     * @param first First value removed
+     * @param last One past the last value removed
+     * @return iterator The value after the removed ones
+     */
+    iterator erase(const_iterator first, const_iterator last);
+
+    /**
+     * @brief Shrinks the buffer (values past the new size are not deleted).
+     * @param count New number of values, at most size()
+     */
+    void resize(size_t count);
+
+    /**
+     * @brief Makes room for values at the end, opening their pages now.
+     * @param count Number of values that will be pushed
+     * @throws StackLimitException if the buffer would exceed its limit or its pages cannot be mapped
+     */
+    void reserve(size_t count);
+
+    /**
+     * @brief Exchanges the regions of two buffers.
+     * @param other The other buffer
+     */
+    void swap(OperandBuffer& other) noexcept;
+
+    /**
+     * @brief Freezes the values: they keep their place in the region, below an empty buffer.
+     *
+     * Frozen values are not values of the buffer any more, and are not
+     * deleted with them; base() gives access to them and restore() makes a
+     * range of them values again.
+     */
+    void freeze() {
+        _begin = _end;
+    }
+
+    /**
+     * @brief Gets the start of the region, where frozen values lie below begin().
+     * @return iterator The first value of the region (null without a region)
+     */
+    iterator base() {
+        return reinterpret_cast<value_type*>(_region);
+    }
+
+    /**
+     * @brief Makes a range of the region the values of the buffer.
+     *
+     * The values in the range are kept; the values of the buffer are not
+     * deleted.
+     *
+     * @param first Index in the region of the first value
+     * @param last Index in the region one past the last value
+     */
+    void restore(size_t first, size_t last) {
+        _begin = base() + first;
+        _end = base() + last;
+    }
+
+    /**
+     * @brief Checks if the buffer has a region.
+     * @return bool False if built deferred or released, and not reserved since
+     */
+    bool hasRegion() const {
+        return _region != nullptr;
+    }
+
+    /**
+     * @brief Reserves the region of the buffer if it has none.
+     * @throws StackLimitException if the region cannot be reserved
+     */
+    void reserveRegion();
+
+    /**
+     * @brief Gives the region back; the buffer must be empty, without frozen values.
+     */
+    void releaseRegion();
+
+    /**
+     * @brief Sets the maximum number of values of a buffer, before the first buffer takes a region.
+     *
+     * The regions are then the smallest power of two holding the values,
+     * the spare area and a guard page (16 MiB to 64 GiB). The limit is
+     * rounded up to whole pages.
+     *
+     * @param values The limit
+     * @return bool False if a region was already taken, or the limit is 0 or above 2^33 values
+     */
+    static bool setLimit(size_t values);
+
+    /**
+     * @brief Gets the maximum number of values of a buffer.
+     * @return size_t The limit
+     */
+    static size_t getLimit();
+
+    /**
+     * @brief Gets the message of the error raised past the limit.
+     * @return std::string "Stack limit of <n> values exceeded"
+     */
+    static std::string limitMessage();
+
+    /**
+     * @brief Checks if a buffer used on this thread passed its limit or needs more room.
+     * @return bool True until clearFault()
+     */
+    static bool faulted() {
+        return _fault != 0;
+    }
+
+    /**
+     * @brief Deletes the values past the limit and closes the spare area, or prepares more room.
+     *
+     * Call on each buffer of the thread after faulted() returned true,
+     * then clear the flag.
+     *
+     * @return bool True if this buffer had passed its limit
+     * @throws StackLimitException if no more room can be prepared
+     */
+    bool settle();
+
+    /**
+     * @brief Clears the fault flag of this thread.
+     */
+    static void clearFault() {
+        _fault = 0;
+    }
+
+private:
+    static inline thread_local volatile std::sig_atomic_t _fault = 0; ///< Set by the handler, see faulted()
+
+    char* _region;          ///< Start of the reserved region, or null
+    value_type* _begin;     ///< First value, above the frozen ones (null without a region)
+    value_type* _end;       ///< One past the last value
+
+    /**
+     * @brief Installs the fault handler and maps the region tables (once per process).
+     * @throws StackLimitException if the tables cannot be mapped
+     */
+    static void install();
+
+    /**
+     * @brief Opens prepared pages of a region when a push reaches them.
+     * @param signal SIGSEGV or SIGBUS
+     * @param info Fault information (the faulting address)
+     * @param context Context of the faulting thread
+     */
+    static void handleFault(int signal, siginfo_t* info, void* context);
+};
+
+/**
+ * @brief The operand stack of the VM: a std::stack whose pushes are plain stores.
+ */
+using OperandStack = std::stack<const IOperand*, OperandBuffer>;
+
+#endif // OPERANDBUFFER_HPP
@@ -60,6 +60,11 @@ public:
      */
     using CreateFn = const IOperand* (OperandFactory::*)(const std::string&) const;
 
+    /**
+     * @brief Type definition for member function pointers creating operands from native values.
+     */
+    using CreateFromValueFn = const IOperand* (OperandFactory::*)(long double) const;
+
     /**
      * @brief Default constructor.
      */
@@ -96,6 +101,20 @@ public:
      */
     const IOperand* createOperand(eOperandType type, const std::string& value) const;
 
+    /**
+     * @brief Creates a new operand of the specified type from a native value.
+     *
+     * Same as the string overload but skips text parsing: only the bounds
+     * of the target type are checked.
+     *
+     * @param type The type of operand to create
+     * @param value The numeric value
+     * @return const IOperand* Pointer to the newly created operand
+     * @throws OverflowException if the value exceeds the maximum for the type
+     * @throws UnderflowException if the value is below the minimum for the type
+     */
+    const IOperand* createOperand(eOperandType type, long double value) const;
+
     /**
      * @brief Destructor.
      */
@@ -152,6 +171,41 @@ private:
      */
     const IOperand* createDouble(const std::string& value) const;
 
+    /**
+     * @brief Creates an Int8 operand from a native value.
+     * @param value The numeric value
+     * @return const IOperand* Pointer to the created Int8 operand
+     */
+    const IOperand* createInt8(long double value) const;
+
+    /**
+     * @brief Creates an Int16 operand from a native value.
+     * @param value The numeric value
+     * @return const IOperand* Pointer to the created Int16 operand
+     */
+    const IOperand* createInt16(long double value) const;
+
+    /**
+     * @brief Creates an Int32 operand from a native value.
+     * @param value The numeric value
+     * @return const IOperand* Pointer to the created Int32 operand
+     */
+    const IOperand* createInt32(long double value) const;
+
+    /**
+     * @brief Creates a Float operand from a native value.
+     * @param value The numeric value
+     * @return const IOperand* Pointer to the created Float operand
+     */
+    const IOperand* createFloat(long double value) const;
+
+    /**
+     * @brief Creates a Double operand from a native value.
+     * @param value The numeric value
+     * @return const IOperand* Pointer to the created Double operand
+     */
+    const IOperand* createDouble(long double value) const;
+
     /**
      * @brief Static array of function pointers for operand creation.
      *
@@ -166,6 +220,13 @@ private:
      * to enable efficient type-based dispatching.
      */
     static const std::array<CreateFn, 5> _createFunctions;
+
+    /**
+     * @brief Static array of function pointers for operand creation from native values.
+     *
+     * Indexed by eOperandType, like _createFunctions.
+     */
+    static const std::array<CreateFromValueFn, 5> _createFromValueFunctions;
 };
 
 #endif // OPERANDFACTORY_HPP
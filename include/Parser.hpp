@@ -7,7 +7,10 @@
 #define PARSER_HPP
 
 #include <vector>
+#include <map>
 #include <memory>
+#include <string>
+#include <filesystem>
 #include "Token.hpp"
 #include "ICommand.hpp"
 #include "OperandFactory.hpp"
@@ -26,13 +29,32 @@ class VirtualMachine;
  */
 class Parser {
 public:
+    /**
+     * @brief Tokens that macro uses may expand to in one program.
+     *
+     * Each nesting level of macros can double the expansion: a program of
+     * a few lines could otherwise expand to billions of commands, or parse
+     * billions of uses of macros expanding to nothing. Each use counts the
+     * tokens of its body, and one for itself.
+     */
+    static constexpr size_t maxExpansion = 10000000;
+
+    /**
+     * @brief Macro uses that may be nested in one another.
+     *
+     * Each level parses its body recursively: a chain of thousands of
+     * distinct macros, each using the previous one, would otherwise
+     * overflow the stack of the parsing thread.
+     */
+    static constexpr size_t maxNesting = 1000;
+
     /**
      * @brief Constructor with token vector.
      * @param tokens Vector of tokens to parse
      * @param collectErrors If true, collects all errors instead of failing fast
-     * @param vm Pointer to the VirtualMachine instance (needed for ExitCommand)
+     * @param vm VirtualMachine the commands run on (stacks, placeholders, channels, output)
      */
-    explicit Parser(const std::vector<Token>& tokens, bool collectErrors = false, VirtualMachine* vm = nullptr);
+    Parser(const std::vector<Token>& tokens, bool collectErrors, VirtualMachine& vm);
 
     /**
      * @brief Parses the tokens and generates commands.
@@ -45,6 +67,26 @@ public:
      */
     std::vector<std::unique_ptr<ICommand>> parse();
 
+    /**
+     * @brief Parses the tokens of a part of a program.
+     *
+     * Like parse(), without requiring an exit instruction.
+     *
+     * @return std::vector<std::unique_ptr<ICommand>> Vector of parsed commands
+     * @throws SyntaxException if a syntax error is encountered (fail-fast mode)
+     */
+    std::vector<std::unique_ptr<ICommand>> parseStatements();
+
+    /**
+     * @brief Gets where each command parsed starts in the tokens.
+     *
+     * Commands of blocks, included files and macros are not listed: the
+     * offset is that of the statement producing the top-level command.
+     *
+     * @return const std::vector<size_t>& Index of the first token of each returned command
+     */
+    const std::vector<size_t>& getOffsets() const;
+
     /**
      * @brief Gets all collected errors (in error collection mode).
      * @return const std::vector<std::string>& Vector of error messages
@@ -57,14 +99,46 @@ public:
      */
     bool hasErrors() const;
 
+    /**
+     * @brief Sets the file the tokens come from.
+     *
+     * Relative 'include' paths are resolved from its directory (from the
+     * working directory if no file is set), and it cannot include itself.
+     *
+     * @param path Path of the program file
+     */
+    void setPath(const std::string& path);
+
 private:
+    /**
+     * @struct Macro
+     * @brief A macro definition.
+     */
+    struct Macro {
+        std::vector<std::string> parameters;        ///< Parameter names
+        std::vector<Token> body;                    ///< Tokens of the body, ending with END_FILE
+        std::string file;                           ///< Included file defining the macro, or empty
+    };
+
     std::vector<Token> _tokens;                     ///< The tokens to parse
-    size_t _currentIndex;                           ///< Current position in token vector
+    const std::vector<Token>* _stream;              ///< Tokens being parsed: _tokens or an included module
+    size_t _currentIndex;                           ///< Current position in _stream
+    std::string _file;                              ///< Included file being parsed, empty for the program
+    std::filesystem::path _directory;               ///< Directory of relative includes
+    std::vector<std::string> _includes;             ///< Canonical paths of the files being parsed
+    std::map<std::string, Macro> _macros;           ///< Macros defined so far, by name
+    std::vector<std::string> _expanding;            ///< Names of the macros being expanded
+    size_t _expanded;                               ///< Tokens expanded by macro uses so far
+    std::vector<size_t> _offsets;                   ///< First token of each top-level command
     bool _collectErrors;                            ///< Error collection mode flag
     std::vector<std::string> _errors;               ///< Collected error messages
     OperandFactory _factory;                        ///< Factory for creating operands
     bool _hasExitInstruction;                       ///< Flag tracking if exit was found
-    VirtualMachine* _vm;                            ///< Pointer to the VirtualMachine
+    VirtualMachine* _vm;                            ///< VirtualMachine the commands run on (the child VM in a fork block)
+    size_t _forkDepth;                              ///< Number of enclosing fork blocks
+    size_t _handlerDepth;                           ///< Number of enclosing onerror blocks
+    size_t _forkBase;                               ///< Fork blocks opened before the current sequence
+    size_t _handlerBase;                            ///< Onerror blocks opened before the current sequence
 
     /**
      * @brief Gets the current token.
@@ -93,10 +167,10 @@ private:
 
     /**
      * @brief Reports a syntax error.
-     * @param message The error message
+     * @param text The error message, completed with the included file it occurs in
      * @throws SyntaxException in fail-fast mode
      */
-    void error(const std::string& message);
+    void error(const std::string& text);
 
     /**
      * @brief Skips newline tokens.
@@ -109,6 +183,48 @@ private:
      */
     std::unique_ptr<ICommand> parseInstruction();
 
+    /**
+     * @brief Parses a type keyword (int8, int16, int32, float, double).
+     * @param type Receives the parsed operand type
+     * @return bool True if a type keyword was consumed
+     * @throws SyntaxException if no type keyword is found (fail-fast mode)
+     */
+    bool parseType(eOperandType& type);
+
+    /**
+     * @brief Parses the value count of an instruction (fork, move, dump).
+     * @param keyword The instruction, for error messages
+     * @param line Line of the instruction
+     * @param count Receives the count
+     * @return bool True if an unsigned count fitting a size_t was consumed
+     * @throws SyntaxException if the count is missing or invalid (fail-fast mode)
+     */
+    bool parseCount(const std::string& keyword, size_t line, size_t& count);
+
+    /**
+     * @brief Checks if a token type can stand for a value.
+     * @param type The token type to check
+     * @return bool True for numeric literals and placeholders
+     */
+    bool isLiteral(TokenType type) const;
+
+    /**
+     * @brief Parses a value specification without creating the operand.
+     * @param type Receives the operand type
+     * @param literal Receives the literal token (number or placeholder)
+     * @return bool True if a well-formed value specification was consumed
+     * @throws SyntaxException if value format is invalid (fail-fast mode)
+     */
+    bool parseValueSpec(eOperandType& type, Token& literal);
+
+    /**
+     * @brief Creates the operand for a numeric literal.
+     * @param type The operand type
+     * @param literal The numeric literal token
+     * @return const IOperand* The created operand, or nullptr on error
+     */
+    const IOperand* createLiteral(eOperandType type, const Token& literal);
+
     /**
      * @brief Parses a value specification (type and value).
      * @return const IOperand* The created operand
@@ -128,6 +244,110 @@ private:
      */
     std::unique_ptr<ICommand> parseAssert();
 
+    /**
+     * @brief Parses a read instruction.
+     * @return std::unique_ptr<ICommand> The read command
+     */
+    std::unique_ptr<ICommand> parseRead();
+
+    /**
+     * @brief Parses the instructions of a block, up to its terminator.
+     *
+     * Stops at 'endfork', 'endonerror' or the end of input, without
+     * consuming it; the caller checks that it is the expected terminator.
+     *
+     * @param commands Receives the commands of the block
+     */
+    void parseBlock(std::vector<std::unique_ptr<ICommand>>& commands);
+
+    /**
+     * @brief Parses an instruction or an include into a command list.
+     * @param commands Receives the command, or the commands of the included file
+     */
+    void parseStatement(std::vector<std::unique_ptr<ICommand>>& commands);
+
+    /**
+     * @brief Parses an include directive, splicing the commands of the file.
+     *
+     * The file is lexed once per process (see ModuleCache) and its tokens
+     * are parsed in place. Blocks cannot span files, and a file including
+     * itself, directly or not, is an error. Errors in the file name it.
+     *
+     * @param commands Receives the commands of the included file
+     */
+    void parseInclude(std::vector<std::unique_ptr<ICommand>>& commands);
+
+    /**
+     * @brief Parses a macro definition, up to and including its 'endmacro'.
+     *
+     * The body is stored as tokens and parsed at each use, so it may use
+     * macros defined after it but before the use.
+     */
+    void parseMacro();
+
+    /**
+     * @brief Parses a macro use, splicing the commands of its body.
+     *
+     * Each argument is a typed value, like in push. Its tokens replace the
+     * parameter names in a copy of the body, which is then parsed in place.
+     * A macro using itself, directly or not, is an error, and so are a use
+     * nested past maxNesting and a use taking the tokens expanded by macros
+     * past maxExpansion: nested uses then stop expanding, and the outermost
+     * one reports the error.
+     *
+     * @param commands Receives the commands of the expanded body
+     */
+    void expandMacro(std::vector<std::unique_ptr<ICommand>>& commands);
+
+    /**
+     * @brief Parses a token sequence in place of the current instruction.
+     *
+     * Used for included files and macro bodies. Blocks opened before the
+     * sequence cannot be closed in it, but still enclose it: 'exit' is
+     * rejected in a module included in a fork block.
+     *
+     * @param tokens The tokens, ending with END_FILE
+     * @param file Name given to errors in the sequence
+     * @param commands Receives the commands of the sequence
+     */
+    void parseTokens(const std::vector<Token>& tokens, const std::string& file,
+                     std::vector<std::unique_ptr<ICommand>>& commands);
+
+    /**
+     * @brief Parses an error handler block, up to and including its 'endonerror'.
+     * @return std::unique_ptr<ICommand> The onerror command
+     */
+    std::unique_ptr<ICommand> parseOnError();
+
+    /**
+     * @brief Parses a fork block, up to and including its 'endfork'.
+     *
+     * The block is parsed for a new child VirtualMachine, which the
+     * ForkCommand owns.
+     *
+     * @return std::unique_ptr<ICommand> The fork command
+     */
+    std::unique_ptr<ICommand> parseFork();
+
+    /**
+     * @brief Parses a send or recv instruction and its channel name.
+     * @param type The instruction token type (SEND or RECV)
+     * @return std::unique_ptr<ICommand> The channel command
+     */
+    std::unique_ptr<ICommand> parseChannel(TokenType type);
+
+    /**
+     * @brief Parses a use instruction and its stack name.
+     * @return std::unique_ptr<ICommand> The use command
+     */
+    std::unique_ptr<ICommand> parseUse();
+
+    /**
+     * @brief Parses a move instruction: source, destination and count.
+     * @return std::unique_ptr<ICommand> The move command
+     */
+    std::unique_ptr<ICommand> parseMove();
+
     /**
      * @brief Parses a simple instruction (no operands).
      * @param type The instruction token type
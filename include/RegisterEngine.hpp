@@ -0,0 +1,180 @@
+/**
+ * @file RegisterEngine.hpp
+ * @brief Defines the RegisterEngine class - execution of the register IR.
+ */
+
+#ifndef REGISTERENGINE_HPP
+#define REGISTERENGINE_HPP
+
+#include <vector>
+#include <string>
+#include <exception>
+#include "RegisterIR.hpp"
+
+// Forward declaration
+class VirtualMachine;
+
+/**
+ * @class RegisterEngine
+ * @brief Executes a program translated to the register IR.
+ *
+ * Values live in a flat array of registers widened to long double instead
+ * of heap-allocated operands on a std::stack, and every instruction names
+ * its registers and types, so arithmetic involves no allocation, virtual
+ * call or type dispatch. Output and errors are identical to the reference
+ * command loop.
+ *
+ * ## Parallel Segments
+ *
+ * Large programs are often concatenations of independent calculations. A
+ * point of the program where no register holds a value that is read later
+ * (typically, where the stack is empty again) is a segment boundary: the
+ * code after it does not depend on the code before it. Consecutive segments
+ * are grouped into tasks of at least minTaskSize instructions, and tasks
+ * are run concurrently by worker threads, each with its own registers and
+ * output buffer. Buffers are then written in program order up to the first
+ * task that raised an error, whose error is raised, so the observable
+ * behaviour is that of sequential execution. Programs using `read` are
+ * always run sequentially, as the input stream is consumed in order.
+ * Values left for exit do not keep segments together: each register of the
+ * final stack is taken from the task that wrote it last.
+ *
+ * ## Usage Example
+ * ```cpp
+ * RegisterEngine engine(vm, translateToIR(vm.getProgram()));
+ * engine.setThreads(4);
+ * engine.run();
+ * ```
+ */
+class RegisterEngine {
+public:
+    /**
+     * @brief Minimum number of instructions in a parallel task.
+     */
+    static constexpr size_t minTaskSize = 4096;
+
+    /**
+     * @brief Constructor.
+     * @param vm The VM providing placeholder bindings, input and exit state
+     * @param program The translated program
+     */
+    RegisterEngine(VirtualMachine& vm, IRProgram program);
+
+    /**
+     * @brief Runs the program once.
+     * @throws AbstractVMException or derived exceptions on execution errors
+     */
+    void run();
+
+    /**
+     * @brief Takes the final stack of the last run, if it reached exit.
+     *
+     * The values stay in the registers of the tasks until this is called,
+     * so runs whose final stack is not inspected create no operands.
+     *
+     * @return std::vector<Scalar> The values, bottom first (empty once taken)
+     */
+    std::vector<Scalar> takeFinalStack();
+
+    /**
+     * @brief Sets the number of threads running tasks.
+     * @param threads Number of threads (1 runs everything on the calling thread)
+     */
+    void setThreads(size_t threads);
+
+    /**
+     * @brief Gets the translated program.
+     * @return const IRProgram& The program
+     */
+    const IRProgram& getProgram() const;
+
+    /**
+     * @brief Gets the number of independent segments of the program.
+     * @return size_t Number of segments
+     */
+    size_t getSegmentCount() const;
+
+    /**
+     * @brief Gets the number of tasks the segments are grouped into.
+     * @return size_t Number of tasks (1 if the program runs sequentially)
+     */
+    size_t getTaskCount() const;
+
+private:
+    /**
+     * @struct Context
+     * @brief State of one task being executed.
+     */
+    struct Context {
+        std::vector<long double> registers;  ///< The register file
+        std::string output;                  ///< Output not written yet
+        size_t flushed;                      ///< Length of output the reference engine flushes (dumps)
+        bool exited;                         ///< True if the task executed exit
+        std::exception_ptr error;            ///< Error raised by the task, or null
+    };
+
+    VirtualMachine& _vm;                ///< The VM running the program
+    IRProgram _program;                 ///< The translated program
+    std::vector<size_t> _tasks;         ///< First instruction of each task, plus the end
+    size_t _segments;                   ///< Number of independent segments
+    size_t _threads;                    ///< Number of threads running tasks
+    std::vector<Context> _finished;     ///< Tasks of the last run if it reached exit
+
+    /**
+     * @brief Splits the program into tasks at segment boundaries.
+     */
+    void partition();
+
+    /**
+     * @brief Executes a range of instructions, capturing any error.
+     * @param begin First instruction
+     * @param end One past the last instruction
+     * @param context The task state
+     * @param stream True to write completed dumps to std::cout as they are produced
+     */
+    void execute(size_t begin, size_t end, Context& context, bool stream) const;
+
+    /**
+     * @brief Writes the output of a task to std::cout.
+     *
+     * Output up to the last dump is flushed, as dump flushes every line; the
+     * characters printed after it are left in the stream buffer.
+     *
+     * @param context The task state
+     */
+    static void emit(Context& context);
+
+    /**
+     * @brief Executes an arithmetic instruction.
+     * @param instruction The instruction
+     * @param registers The register file
+     * @throws DivisionByZeroException, OverflowException or UnderflowException
+     */
+    static void arithmetic(const IRInstruction& instruction, std::vector<long double>& registers);
+
+    /**
+     * @brief Executes an assert instruction.
+     * @param instruction The instruction
+     * @param registers The register file
+     * @throws AssertException on value mismatch
+     */
+    void assertValue(const IRInstruction& instruction, const std::vector<long double>& registers) const;
+
+    /**
+     * @brief Executes a dump instruction.
+     * @param instruction The instruction
+     * @param context The task state
+     */
+    void dump(const IRInstruction& instruction, Context& context) const;
+
+    /**
+     * @brief Checks a value against the bounds of its type.
+     * @param type The target type
+     * @param value The value
+     * @return long double The value converted to the type
+     * @throws OverflowException or UnderflowException like OperandFactory
+     */
+    static long double checked(eOperandType type, long double value);
+};
+
+#endif // REGISTERENGINE_HPP
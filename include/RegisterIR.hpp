@@ -0,0 +1,86 @@
+/**
+ * @file RegisterIR.hpp
+ * @brief Defines the register-based intermediate representation of programs.
+ */
+
+#ifndef REGISTERIR_HPP
+#define REGISTERIR_HPP
+
+#include <vector>
+#include <memory>
+#include <string>
+#include <cstdint>
+#include <exception>
+#include "ICommand.hpp"
+#include "Arithmetic.hpp"
+
+/**
+ * @enum eIROp
+ * @brief The instructions of the register IR.
+ */
+enum class eIROp {
+    Const,      ///< dst = value
+    Load,       ///< dst = value bound to placeholder slot `index`
+    Read,       ///< dst = next value of the input stream
+    Arith,      ///< dst = lhs <arithmetic> rhs
+    Copy,       ///< dst = lhs
+    Assert,     ///< Check register lhs against the expected value
+    Print,      ///< Print register lhs as a character
+    Dump,       ///< Print registers rhs to lhs-1, whose types are layout `index`
+    Exit,       ///< Stop the program, leaving registers 0 to lhs-1 with layout `index`
+    Fail        ///< Raise errors[index]
+};
+
+/**
+ * @struct IRInstruction
+ * @brief One three-address instruction.
+ *
+ * Registers are stack slots: the value at depth d of the stack lives in
+ * register d. Since programs are straight-line, the depth of every stack
+ * instruction and the type of every slot are known statically, so each
+ * instruction names its registers and types explicitly.
+ */
+struct IRInstruction {
+    eIROp op;                   ///< The instruction
+    eArithmetic arithmetic;     ///< The operation (Arith)
+    eOperandType type;          ///< Result, loaded or asserted type
+    eOperandType rhsType;       ///< Right operand type (Arith)
+    bool exact;                 ///< Integer result computed exactly, no rounding (Arith)
+    uint32_t dst;               ///< Destination register
+    uint32_t lhs;               ///< First source register, or register count (Dump, Exit)
+    uint32_t rhs;               ///< Second source register, or first register printed (Dump)
+    long double value;          ///< Constant (Const) or expected value (Assert)
+    size_t index;               ///< Slot, layout, expected text or error index
+};
+
+/**
+ * @struct IRProgram
+ * @brief A program translated to the register IR.
+ */
+struct IRProgram {
+    std::vector<IRInstruction> code;                    ///< The instructions
+    std::vector<std::vector<eOperandType>> layouts;     ///< Types of the registers dumped, and of all at exit
+    std::vector<std::string> expected;                  ///< Expected text of float asserts
+    std::vector<std::exception_ptr> errors;             ///< Errors raised by Fail
+    size_t registers;                                   ///< Number of registers used
+    size_t sourceSize;                                  ///< Number of stack instructions translated
+};
+
+/**
+ * @brief Translates a parsed program to the register IR.
+ *
+ * Pushes become constant, placeholder or read instructions into the
+ * register of the new top of stack, arithmetic reads the two top registers
+ * and writes the lower one, and pop disappears. Errors that depend only on
+ * the stack depth or slot types (pop on an empty stack, assert type
+ * mismatch, ...) are detected here and become a Fail instruction at the
+ * point the reference engine would raise them; nothing after it is
+ * translated.
+ *
+ * @param program The parsed commands (packed commands are expanded)
+ * @return IRProgram The translated program
+ * @throws std::invalid_argument if the program uses fork or join
+ */
+IRProgram translateToIR(const std::vector<std::unique_ptr<ICommand>>& program);
+
+#endif // REGISTERIR_HPP
@@ -0,0 +1,29 @@
+/**
+ * @file StackContainer.hpp
+ * @brief Defines StackContainer - direct access to the values of an operand stack.
+ */
+
+#ifndef STACKCONTAINER_HPP
+#define STACKCONTAINER_HPP
+
+#include "OperandBuffer.hpp"
+
+/**
+ * @struct StackContainer
+ * @brief Gives access to the container of an OperandStack, for block transfers.
+ *
+ * Used where values are visited or moved in bulk (dumps, 'move'), instead
+ * of popping them to a temporary stack and pushing them back.
+ */
+struct StackContainer : OperandStack {
+    /**
+     * @brief Gets the container of a stack.
+     * @param stack The stack
+     * @return container_type& Its container, bottom value first
+     */
+    static container_type& of(OperandStack& stack) {
+        return stack.*&StackContainer::c;
+    }
+};
+
+#endif // STACKCONTAINER_HPP
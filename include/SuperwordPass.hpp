@@ -0,0 +1,84 @@
+/**
+ * @file SuperwordPass.hpp
+ * @brief Defines the SuperwordPass class - packing of isomorphic expressions.
+ */
+
+#ifndef SUPERWORDPASS_HPP
+#define SUPERWORDPASS_HPP
+
+#include <vector>
+#include <memory>
+#include <string>
+#include "ICommand.hpp"
+
+// Forward declaration
+class VirtualMachine;
+
+/**
+ * @class SuperwordPass
+ * @brief Optimisation pass grouping independent isomorphic expressions.
+ *
+ * A run of push and arithmetic instructions is split into expressions: each
+ * one starts with a push and leaves exactly one value on the stack without
+ * consuming values pushed before it. Consecutive expressions with the same
+ * shape (same instructions and operand types, possibly different values)
+ * are independent of each other, so they are replaced by a single
+ * PackedCommand that executes each instruction once for all of them.
+ *
+ * ```
+ * push int32(2)    ┐
+ * push int32(3)    │ lane 0
+ * mul              ┘
+ * push int32(4)    ┐
+ * push int32(5)    │ lane 1      =>   packed (2 lanes x 3 instructions)
+ * mul              ┘
+ * ```
+ *
+ * Expressions made of a single push are left alone, as packing them would
+ * save nothing.
+ */
+class SuperwordPass {
+public:
+    /**
+     * @struct Region
+     * @brief A group of expressions packed into one command.
+     */
+    struct Region {
+        size_t first;   ///< Index of the first instruction in the original program
+        size_t last;    ///< Index of the last instruction in the original program
+        size_t lanes;   ///< Number of expressions
+        size_t length;  ///< Number of instructions per expression
+    };
+
+    /**
+     * @brief Constructor.
+     * @param vm Pointer to the VirtualMachine the packed commands run in
+     */
+    explicit SuperwordPass(VirtualMachine* vm);
+
+    /**
+     * @brief Rewrites a program, packing isomorphic expressions.
+     * @param program The program to rewrite in place
+     * @return std::vector<Region> The packed regions, in program order
+     */
+    std::vector<Region> run(std::vector<std::unique_ptr<ICommand>>& program);
+
+    /**
+     * @brief Formats a packed region for the optimisation report.
+     * @param region The region
+     * @return std::string A one-line description (1-based instruction numbers)
+     */
+    static std::string describe(const Region& region);
+
+private:
+    VirtualMachine* _vm;    ///< Pointer to the VirtualMachine
+
+    /**
+     * @brief Gets the shape of an instruction, for comparing expressions.
+     * @param command The instruction
+     * @return int The opcode combined with the pushed type
+     */
+    static int shapeOf(const ICommand& command);
+};
+
+#endif // SUPERWORDPASS_HPP
@@ -28,6 +28,23 @@ enum class TokenType {
     MOD,        ///< Modulo instruction keyword
     PRINT,      ///< Print instruction keyword
     EXIT,       ///< Exit instruction keyword
+    READ,       ///< Read instruction keyword
+    FORK,       ///< Fork instruction keyword
+    ENDFORK,    ///< End of fork block keyword
+    JOIN,       ///< Join instruction keyword
+    SEND,       ///< Send instruction keyword
+    RECV,       ///< Receive instruction keyword
+    USE,        ///< Use (select stack) instruction keyword
+    MOVE,       ///< Move (between stacks) instruction keyword
+    SAVEPOINT,  ///< Savepoint instruction keyword
+    ROLLBACK,   ///< Rollback instruction keyword
+    COMMIT,     ///< Commit instruction keyword
+    ONERROR,    ///< Error handler block keyword
+    ENDONERROR, ///< End of error handler block keyword
+    DUMPDELTA,  ///< Incremental dump instruction keyword
+    INCLUDE,    ///< Include directive keyword
+    MACRO,      ///< Macro definition keyword
+    ENDMACRO,   ///< End of macro definition keyword
 
     // Types
     INT8,       ///< int8 type keyword
@@ -39,6 +56,9 @@ enum class TokenType {
     // Literals and separators
     INTEGER,    ///< Integer literal (e.g., 42, -123)
     DECIMAL,    ///< Decimal literal (e.g., 3.14, -2.5)
+    PLACEHOLDER,///< Placeholder bound at run time (e.g., $1, $rate)
+    IDENTIFIER, ///< Name that is not a keyword (e.g., a channel name)
+    STRING,     ///< Double-quoted string (e.g., "out.bin"), value without quotes
     LPAREN,     ///< Left parenthesis '('
     RPAREN,     ///< Right parenthesis ')'
     NEWLINE,    ///< Newline character
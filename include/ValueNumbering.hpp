@@ -0,0 +1,78 @@
+/**
+ * @file ValueNumbering.hpp
+ * @brief Defines the ValueNumbering class - reuse of recomputed values in the register IR.
+ */
+
+#ifndef VALUENUMBERING_HPP
+#define VALUENUMBERING_HPP
+
+#include <string>
+#include "RegisterIR.hpp"
+
+/**
+ * @class ValueNumbering
+ * @brief Optimisation pass removing recomputations from a register program.
+ *
+ * Without `dup`, programs that need a value twice compute it twice:
+ * ```
+ * push int32(6)
+ * push int32(7)
+ * mul
+ * push int32(6)
+ * push int32(7)
+ * mul
+ * add
+ * ```
+ * The pass gives every computed value a number identifying its operation,
+ * type and operand numbers (constants by type and value, placeholders by
+ * slot). When an arithmetic instruction or placeholder load computes a value
+ * that a register still holds, it is replaced by a copy of that register.
+ * Integer add and mul are matched regardless of operand order.
+ *
+ * The earlier computation has already run, so a replaced instruction could
+ * not have raised an error: errors are unchanged. A final backward pass
+ * removes constants and copies whose register is never read; instructions
+ * that may raise an error are never removed.
+ */
+class ValueNumbering {
+public:
+    /**
+     * @struct Stats
+     * @brief What the pass changed.
+     */
+    struct Stats {
+        size_t reused;      ///< Computations replaced by a copy
+        size_t removed;     ///< Instructions removed as dead
+    };
+
+    /**
+     * @brief Rewrites a register program.
+     * @param program The program to rewrite in place
+     * @return Stats What was changed
+     */
+    Stats run(IRProgram& program);
+
+    /**
+     * @brief Formats the statistics for the optimisation report.
+     * @param stats The statistics
+     * @return std::string A one-line description
+     */
+    static std::string describe(const Stats& stats);
+
+private:
+    /**
+     * @brief Replaces recomputed values by register copies.
+     * @param program The program to rewrite
+     * @return size_t Number of replaced instructions
+     */
+    size_t reuse(IRProgram& program);
+
+    /**
+     * @brief Removes constants and copies into registers that are never read.
+     * @param program The program to rewrite
+     * @return size_t Number of removed instructions
+     */
+    size_t eliminate(IRProgram& program);
+};
+
+#endif // VALUENUMBERING_HPP
@@ -11,8 +11,19 @@
 #include <memory>
 #include <istream>
 #include <string>
+#include <deque>
+#include <future>
+#include <cstdint>
 #include "IOperand.hpp"
 #include "ICommand.hpp"
+#include "Token.hpp"
+#include "BinaryReader.hpp"
+#include "OperandFactory.hpp"
+#include "AbstractVMException.hpp"
+#include "RegisterEngine.hpp"
+#include "Channel.hpp"
+#include "DumpFormat.hpp"
+#include "DumpQueue.hpp"
 
 /**
  * @class VirtualMachine
@@ -47,6 +58,19 @@
  * vm.run(std::cin, true);  // Run from stdin
  * ```
  *
+ * ## Parameterised Programs
+ *
+ * A program can be parsed once with load() and executed any number of
+ * times with execute(). Placeholders such as `$1` or `$rate` are left as
+ * typed slots by the parser and bound between runs:
+ * ```cpp
+ * vm.loadFile("invoice.avm");
+ * for (const Customer& c : customers) {
+ *     vm.bind("rate", c.rate);
+ *     vm.execute();
+ * }
+ * ```
+ *
  * ## Memory Management
  *
  * The VM is responsible for:
@@ -109,12 +133,187 @@ public:
      */
     void runFile(const std::string& filename);
 
+    /**
+     * @brief Parses a program without executing it.
+     *
+     * The parsed program replaces any previously loaded one and can be run
+     * with execute(). In error collection mode, parse errors are printed and
+     * no program is loaded.
+     *
+     * @param input The input stream containing the program
+     * @param fromStdin Flag indicating if input is from stdin (handles ";;" marker)
+     * @param path Path of the program file, to resolve its includes (see Parser::setPath)
+     * @return bool True if the program was loaded
+     * @throws AbstractVMException or derived exceptions on parse errors (fail-fast mode)
+     */
+    bool load(std::istream& input, bool fromStdin = false, const std::string& path = "");
+
+    /**
+     * @brief Parses a lexed program without executing it.
+     * @param tokens The tokens of the program, ending with END_FILE
+     * @param path Path of the program file, to resolve its includes (see Parser::setPath)
+     * @param offsets If not null, receives the first token of each command (see Parser::getOffsets)
+     * @return bool True if the program was loaded
+     * @throws AbstractVMException or derived exceptions on parse errors (fail-fast mode)
+     */
+    bool load(const std::vector<Token>& tokens, const std::string& path = "",
+              std::vector<size_t>* offsets = nullptr);
+
+    /**
+     * @brief Replaces part of the loaded program.
+     *
+     * Commands are indexed as parsed, before optimisation; the optimisation
+     * passes are applied again to the patched program.
+     *
+     * @param begin First command replaced
+     * @param end One past the last command replaced
+     * @param commands The new commands, parsed for this VM
+     */
+    void patch(size_t begin, size_t end, std::vector<std::unique_ptr<ICommand>> commands);
+
+    /**
+     * @brief Parses a program from a file path without executing it.
+     * @param filename Path to the file containing the program
+     * @return bool True if the program was loaded
+     * @throws std::runtime_error if file cannot be opened
+     * @throws AbstractVMException or derived exceptions on parse errors (fail-fast mode)
+     */
+    bool loadFile(const std::string& filename);
+
+    /**
+     * @brief Executes the loaded program.
+     *
+     * Runs the program with the current placeholder bindings, then clears
+     * the stack (in fast exit mode, the next call or the destructor does).
+     * Can be called any number of times.
+     *
+     * @throws AbstractVMException or derived exceptions on execution errors
+     */
+    void execute();
+
+    /**
+     * @brief Gets the loaded program.
+     *
+     * Used by alternative execution engines to translate the program.
+     *
+     * @return const std::vector<std::unique_ptr<ICommand>>& The parsed commands
+     */
+    const std::vector<std::unique_ptr<ICommand>>& getProgram() const;
+
+    /**
+     * @brief Gets the names of the stacks.
+     * @return const std::vector<std::string>& The names, indexed by stack index ("main" first)
+     */
+    const std::vector<std::string>& getStackNames() const;
+
+    /**
+     * @brief Gets the values of a stack.
+     *
+     * In fast exit mode, the stacks left by the last execute() stay in place
+     * until the next one and can be inspected here. Values frozen by open
+     * savepoints are copied to the stack first.
+     *
+     * @param index The stack index (see getStackNames())
+     * @return const OperandBuffer& The values, bottom first
+     */
+    const OperandBuffer& getStack(size_t index);
+
+    /**
+     * @brief Binds a value to a placeholder.
+     * @param name Placeholder name without the '$' ("1", "rate", ...)
+     * @param value The value pushed for this placeholder
+     */
+    void bind(const std::string& name, long double value);
+
+    /**
+     * @brief Binds a value given as text to a placeholder.
+     * @param name Placeholder name without the '$'
+     * @param value Text representation of the value, written like a literal of the program
+     * @throws PlaceholderException if value is not a numeric literal
+     */
+    void bind(const std::string& name, const std::string& value);
+
+    /**
+     * @brief Parses a value given as text for a placeholder, as bind() does.
+     * @param name Placeholder name without the '$', for the error message
+     * @param value Text representation of the value, written like a literal of the program
+     * @return long double The value
+     * @throws PlaceholderException if value is not a numeric literal
+     */
+    static long double parseBinding(const std::string& name, const std::string& value);
+
+    /**
+     * @brief Removes all placeholder bindings.
+     */
+    void clearBindings();
+
+    /**
+     * @brief Resolves a placeholder name to its slot, creating it if needed.
+     *
+     * Called by the parser so that placeholders are looked up by index
+     * rather than by name at run time.
+     *
+     * @param name Placeholder name without the '$'
+     * @return size_t The slot index
+     */
+    size_t placeholderSlot(const std::string& name);
+
+    /**
+     * @brief Gets the value bound to a placeholder slot.
+     * @param slot The slot index
+     * @return long double The bound value
+     * @throws PlaceholderException if the slot is not bound
+     */
+    long double getBinding(size_t slot) const;
+
     /**
      * @brief Gets the current size of the operand stack.
-     * @return size_t Number of operands on the stack
+     * @return size_t Number of operands on the stack in use
      */
     size_t stackSize() const;
 
+    /**
+     * @brief Resolves a stack name to its index, creating the stack if needed.
+     *
+     * Called by the parser for 'use' and 'move'. Index 0 is the stack
+     * named "main", on which every run starts.
+     *
+     * @param name The stack name
+     * @return size_t The stack index
+     */
+    size_t stackIndex(const std::string& name);
+
+    /**
+     * @brief Selects the stack used by the following instructions.
+     * @param index The stack index
+     */
+    void useStack(size_t index);
+
+    /**
+     * @brief Transfers the top values of a stack to the top of another one.
+     *
+     * The values keep their order and are not copied: moving a whole stack
+     * onto an empty one exchanges the containers in constant time, and
+     * other moves copy a contiguous block of pointers.
+     *
+     * @param from The source stack index
+     * @param to The destination stack index
+     * @param count Number of values to move
+     * @throws InsufficientValuesException if the source has fewer than count values
+     */
+    void moveValues(size_t from, size_t to, size_t count);
+
+    /**
+     * @brief Settles the stacks after a fault of their buffers (see OperandBuffer::faulted()).
+     *
+     * Prepares more room for the stacks that need it, and removes the
+     * values past the limit of those that passed it. Called after each
+     * instruction the flag is set by, and by commands running others.
+     *
+     * @throws StackLimitException if a stack passed its limit, or no more room can be prepared
+     */
+    void settleStacks();
+
     /**
      * @brief Enables or disables verbose mode.
      * @param verbose If true, prints additional execution information
@@ -131,6 +330,19 @@ public:
      */
     void setCollectErrors(bool collect);
 
+    /**
+     * @brief Enables or disables fast exit mode.
+     *
+     * In fast exit mode, execute() leaves the final stacks in place instead
+     * of deleting their values one by one: the next execute() or the
+     * destructor frees them. A process that ends right after the run (see
+     * the --fast-exit option) can then exit without either, skipping the
+     * teardown of a deep stack and of the program. Off by default.
+     *
+     * @param fastExit If true, execute() does not free the final stacks
+     */
+    void setFastExit(bool fastExit);
+
     /**
      * @brief Signals that the exit command has been executed.
      *
@@ -139,34 +351,399 @@ public:
      */
     void setExitCalled();
 
+    /**
+     * @brief Attaches the binary input stream consumed by 'read' instructions.
+     *
+     * The stream is kept across runs, so several programs (or several runs of
+     * the same program) can consume consecutive data sets from one input.
+     *
+     * @param input The reader to attach, or nullptr to detach the current one
+     */
+    void setInput(std::unique_ptr<BinaryReader> input);
+
+    /**
+     * @brief Gets the binary input stream consumed by 'read' instructions.
+     * @return BinaryReader* The attached reader, or nullptr if none
+     */
+    BinaryReader* getInput() const;
+
+    /**
+     * @brief Sets the optimisation level applied to programs by load().
+     *
+     * - 0: the program is executed as parsed (default)
+     * - 1: isomorphic independent expressions are packed (SuperwordPass)
+     * - 2: the program is translated to the register IR and run by a
+     *   RegisterEngine (except in verbose mode)
+     * - 3: as 2, with recomputed values reused (ValueNumbering)
+     *
+     * Optimised programs produce exactly the same output and errors.
+     *
+     * @param level The optimisation level
+     */
+    void setOptimizationLevel(int level);
+
+    /**
+     * @brief Sets the number of threads running independent program segments.
+     *
+     * Used by the register engine (optimisation level 2 and above) and to
+     * format dumps of more than textChunkSize values.
+     *
+     * @param threads Number of threads; 0 uses one per hardware thread, 1 disables parallelism
+     */
+    void setThreads(size_t threads);
+
+    /**
+     * @brief Gets the number of threads used by parallel work.
+     *
+     * Used by the register engine and to format large dumps.
+     *
+     * @return size_t Number of threads (one per hardware thread unless set)
+     */
+    size_t getThreads() const;
+
+    /**
+     * @brief Sets how 'dump' writes the stack to the standard output.
+     *
+     * Set before loading a program, so that forked blocks use it too.
+     *
+     * @param format The format (text by default)
+     */
+    void setDumpFormat(eDumpFormat format);
+
+    /**
+     * @brief Gets how 'dump' writes the stack to the standard output.
+     * @return eDumpFormat The format
+     */
+    eDumpFormat getDumpFormat() const;
+
+    /**
+     * @brief Makes 'dump' and 'print' write the output on a background thread.
+     *
+     * Dumps to the standard output then take a snapshot of the values and
+     * queue it to a DumpQueue, so execution continues while the snapshot is
+     * formatted and written. Output keeps its order, and is written before
+     * execute() returns or reports an error. Not used in verbose mode.
+     *
+     * @param memoryLimit Limit of the memory used by queued snapshots, in bytes; 0 writes synchronously
+     */
+    void setAsyncDumps(size_t memoryLimit);
+
+    /**
+     * @brief Gets the queue writing the output in the background.
+     * @return DumpQueue* The queue, or null if output is written synchronously
+     */
+    DumpQueue* getDumpQueue();
+
+    /**
+     * @brief Runs a forked block on this VM's stack.
+     *
+     * Called by ForkCommand on the child VM, on the child's thread. The
+     * arguments are pushed, the block is executed, and the final stack is
+     * returned. Forks started by the block and never joined are waited for
+     * and their results discarded. The stacks take their regions for the
+     * block and give them back at its end.
+     *
+     * @param commands The block to run
+     * @param arguments Initial stack, bottom value first (takes ownership)
+     * @return std::vector<const IOperand*> Final stack, bottom value first (caller owns)
+     * @throws AbstractVMException or derived exceptions raised by the block
+     */
+    std::vector<const IOperand*> runBlock(const std::vector<std::unique_ptr<ICommand>>& commands,
+                                          const std::vector<const IOperand*>& arguments);
+
+    /**
+     * @brief Copies the placeholder values of another VM, by name.
+     * @param parent The VM whose bindings are copied
+     */
+    void inheritBindings(const VirtualMachine& parent);
+
+    /**
+     * @brief Shares the dump queue of another VM.
+     *
+     * The output of a fork block then goes behind the dumps its parent
+     * queued before the fork, as it would without asynchronous dumps.
+     *
+     * @param parent The VM whose queue is shared
+     */
+    void inheritDumps(const VirtualMachine& parent);
+
+    /**
+     * @brief Registers a started fork, to be waited for by joinFork().
+     * @param result The result of the forked block
+     */
+    void startFork(std::future<std::vector<const IOperand*>> result);
+
+    /**
+     * @brief Waits for the oldest pending fork.
+     * @return std::vector<const IOperand*> Final stack of the block, bottom value first
+     * @throws ForkException if no fork is pending
+     * @throws AbstractVMException or derived exceptions raised by the block
+     */
+    std::vector<const IOperand*> joinFork();
+
+    /**
+     * @brief Saves the state of the stacks, to be restored by rollback().
+     *
+     * Nothing is copied: the current contents of each stack are frozen in
+     * place, and a value is copied only when an instruction reaches below
+     * the values pushed since. Savepoints nest, and each one costs constant
+     * time and memory per stack.
+     */
+    void savepoint();
+
+    /**
+     * @brief Restores the stacks to the most recent savepoint and ends it.
+     *
+     * The frozen contents become the stacks again; only the values created
+     * since the savepoint are deleted.
+     *
+     * @throws SavepointException if no savepoint is active
+     */
+    void rollback();
+
+    /**
+     * @brief Ends the most recent savepoint, keeping the current stacks.
+     * @throws SavepointException if no savepoint is active
+     */
+    void commit();
+
+    /**
+     * @brief Starts recording the lowest position modified on each stack.
+     *
+     * Called by the parser when a program uses 'dumpdelta', so that other
+     * programs pay nothing for the tracking.
+     */
+    void enableChangeTracking();
+
+    /**
+     * @brief Gets the lowest position of the stack in use modified since the last call.
+     *
+     * Called by DumpDeltaCommand (and full dumps); the stack is considered
+     * unchanged afterwards. Every position is modified at the start of a run.
+     *
+     * @return size_t The lowest modified position (the stack size if none)
+     */
+    size_t takeLowestChange();
+
+    /**
+     * @brief Installs the handler run when an instruction raises an error.
+     *
+     * Called by OnErrorCommand. The handler stays installed until the end
+     * of the run (or of the fork block) or until another one replaces it.
+     *
+     * @param handler The handler block, or nullptr to remove the handler
+     */
+    void setErrorHandler(const std::vector<std::unique_ptr<ICommand>>* handler);
+
+    /**
+     * @brief Sets the channels shared with other VMs.
+     *
+     * Must be called before load(). VMs sharing a registry exchange values
+     * with 'send' and 'recv'; by default a VM has its own channels.
+     *
+     * @param channels The shared channel registry
+     */
+    void setChannels(std::shared_ptr<ChannelRegistry> channels);
+
+    /**
+     * @brief Gets the channels of this VM, creating a private registry if needed.
+     * @return std::shared_ptr<ChannelRegistry> The channel registry
+     */
+    std::shared_ptr<ChannelRegistry> getChannels();
+
+    /**
+     * @brief Resolves a channel used by the program being parsed.
+     *
+     * Called by the Parser for 'send' and 'recv'. The channel ends used by
+     * the program are opened when a run starts and closed when it finishes.
+     *
+     * @param name The channel name
+     * @param sender True for 'send', false for 'recv'
+     * @return Channel& The channel
+     * @throws ChannelException if that end of the channel belongs to another VM
+     */
+    Channel& attachChannel(const std::string& name, bool sender);
+
+    /**
+     * @brief Gets the report of the optimisations applied to the loaded program.
+     * @return const std::vector<std::string>& One line per transformed region
+     */
+    const std::vector<std::string>& getOptimizationReport() const;
+
 private:
-    std::stack<const IOperand*> _stack;     ///< The operand stack
+    std::vector<OperandStack> _stacks; ///< The operand stacks, indexed by stack index
+    std::vector<std::string> _stackNames;   ///< Stack names, indexed by stack index
+    size_t _current;                        ///< Index of the stack in use
     bool _exitCalled;                       ///< Flag indicating if exit was executed
     bool _verbose;                          ///< Verbose output flag
     bool _collectErrors;                    ///< Error collection mode flag
+    std::unique_ptr<BinaryReader> _input;   ///< Input stream for 'read' instructions
+    std::vector<std::unique_ptr<ICommand>> _program; ///< The loaded program
+    std::vector<std::string> _slotNames;    ///< Placeholder names, indexed by slot
+    std::vector<long double> _slotValues;   ///< Placeholder values, indexed by slot
+    std::vector<bool> _slotBound;           ///< Placeholder binding flags, indexed by slot
+    int _optimizationLevel;                 ///< Optimisation level applied by load()
+    size_t _threads;                        ///< Threads for independent segments (0: one per core)
+    std::vector<std::string> _report;       ///< Optimisations applied to the program
+    std::unique_ptr<RegisterEngine> _engine; ///< Register engine for the program (level 2)
+    std::deque<std::future<std::vector<const IOperand*>>> _forks; ///< Pending forks, oldest first
+    std::shared_ptr<ChannelRegistry> _channelRegistry; ///< Channels shared with other VMs
+    std::vector<Channel*> _channels;        ///< Channels used by the program
+
+    /**
+     * @struct Frame
+     * @brief Contents of one stack frozen by a savepoint.
+     *
+     * The values stay in the region of the stack, below its live values
+     * (OperandBuffer::freeze()). The stack as the program sees it is the
+     * frozen values still visible followed by the live ones: the visible
+     * values of a frame go from its base to the base of the next frame
+     * holding visible values, or to the live values. The others have been
+     * copied to the live values, and are kept for rollback().
+     */
+    struct Frame {
+        size_t first;                       ///< Index in the region of the first value (owned)
+        size_t last;                        ///< Index in the region past the last value
+        size_t base;                        ///< Position of the first value in the stack
+        size_t parent;                      ///< Savepoint whose frame held the visible values below, or noFrame
+    };
+
+    /**
+     * @struct Savepoint
+     * @brief State saved by savepoint().
+     */
+    struct Savepoint {
+        std::vector<Frame> frames;          ///< One frame per stack
+        size_t current;                     ///< Stack in use when saved
+    };
+
+    static constexpr size_t noFrame = SIZE_MAX; ///< No savepoint holds visible values of the stack
+
+    std::vector<Savepoint> _savepoints;     ///< Active savepoints, oldest first
+    const std::vector<std::unique_ptr<ICommand>>* _errorHandler; ///< Installed 'onerror' block, or null
+    std::vector<size_t> _frozen;            ///< Frozen values visible below the live ones, per stack
+    std::vector<size_t> _visibleFrame;      ///< Newest savepoint holding visible values, per stack
+    OperandFactory _factory;                ///< Factory for the error codes pushed for handlers
+    bool _trackChanges;                     ///< True if the program uses 'dumpdelta'
+    std::vector<size_t> _lowestChange;      ///< Lowest position modified since the last dump, per stack
+    eDumpFormat _dumpFormat;                ///< Format of 'dump' on the standard output
+    std::shared_ptr<DumpQueue> _dumpQueue;  ///< Output written in the background, or null
+    bool _fastExit;                         ///< True if execute() leaves the final stacks in place
+    bool _engineStack;                      ///< True if the final main stack is still in the register engine
 
     /**
      * @brief Executes a vector of commands.
      *
-     * Runs each command in sequence, stopping if exit is encountered.
+     * Runs each command in sequence, stopping if exit is encountered. If an
+     * error handler is installed, a failing command is followed by the
+     * handler and execution resumes with the next command.
      *
      * @param commands Vector of commands to execute
-     * @throws AbstractVMException or derived exceptions on errors
+     * @throws AbstractVMException or derived exceptions on unhandled errors
+     */
+    void executeCommands(const std::vector<std::unique_ptr<ICommand>>& commands);
+
+    /**
+     * @brief Runs the installed error handler for an error.
+     * @param error The error raised by an instruction
+     * @throws AbstractVMException or derived exceptions raised by the handler
+     */
+    void handleError(const AbstractVMException& error);
+
+    /**
+     * @brief Executes one command on the stack in use.
+     *
+     * With an active savepoint, the frozen values the command reaches are
+     * copied to the stack first.
+     *
+     * @param command The command
+     * @throws StackLimitException if the command passed the stack limit
+     */
+    void executeCommand(ICommand& command);
+
+    /**
+     * @brief Gets the number of values a command reaches on the stack.
+     * @param command The command
+     * @return size_t The depth (SIZE_MAX for the whole stack)
+     */
+    static size_t requiredDepth(const ICommand& command);
+
+    /**
+     * @brief Records the stack positions a command may modify.
+     * @param command The command about to be executed
      */
-    void executeCommands(std::vector<std::unique_ptr<ICommand>>& commands);
+    void trackChange(const ICommand& command);
 
     /**
-     * @brief Cleans up the stack, deleting all operands.
+     * @brief Records that a stack is modified from a position upwards.
+     * @param stack The stack index
+     * @param position The lowest modified position
+     */
+    void markChanged(size_t stack, size_t position);
+
+    /**
+     * @brief Gets the number of values on a stack, including frozen ones.
+     * @param stack The stack index
+     * @return size_t The size of the stack as seen by the program
+     */
+    size_t logicalSize(size_t stack) const;
+
+    /**
+     * @brief Copies frozen values to a stack until it holds a given depth.
+     * @param stack The stack index
+     * @param depth Number of values needed (fewer if the stack is smaller)
+     */
+    void materialize(size_t stack, size_t depth);
+
+    /**
+     * @brief Ends all savepoints, deleting their frozen values.
+     */
+    void discardSavepoints();
+
+    /**
+     * @brief Cleans up the stacks, deleting all operands, and selects "main".
      *
      * Called during destruction or after program completion.
      */
     void cleanupStack();
 
+    /**
+     * @brief Reserves the regions of the stacks, built without one.
+     * @throws StackLimitException if a region cannot be reserved
+     */
+    void reserveStacks();
+
+    /**
+     * @brief Gives back the regions of the empty stacks (after a forked block).
+     */
+    void releaseStacks();
+
     /**
      * @brief Validates that the program ended with an exit instruction.
      * @throws NoExitException if exit was not called
      */
     void validateExit() const;
+
+    /**
+     * @brief Waits for all pending forks and deletes their results.
+     */
+    void discardForks();
+
+    /**
+     * @brief Marks the channel ends used by the program as finished.
+     */
+    void closeChannels();
+
+    /**
+     * @brief Waits until the output queued in the background is written.
+     * @throws OutputException if the background writer failed
+     */
+    void finishDumps();
+
+    /**
+     * @brief Applies the optimisation passes of the current level to the program.
+     */
+    void optimize();
 };
 
 #endif // VIRTUALMACHINE_HPP
@@ -0,0 +1,160 @@
+/**
+ * @file Watcher.hpp
+ * @brief Defines the Watcher class - re-running a program when its file changes.
+ */
+
+#ifndef WATCHER_HPP
+#define WATCHER_HPP
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "Token.hpp"
+
+// Forward declaration
+class VirtualMachine;
+
+/**
+ * @class Watcher
+ * @brief Runs a program file again each time it is saved, recompiling only what changed.
+ *
+ * The watcher keeps the tokens of every line of the file. When the file
+ * changes, lines are compared by hash to find the changed range (the lines
+ * between the unchanged prefix and the unchanged suffix), and only those
+ * lines are lexed again. The language is line-oriented, so an instruction
+ * never spans lines.
+ *
+ * If the program has no blocks, includes or macros, each line compiles to
+ * its own commands independently of the others: the changed lines are
+ * parsed alone and their commands replace those of the old lines in the
+ * loaded program (see VirtualMachine::patch). Otherwise, the program is
+ * parsed again from the cached tokens. A one-line edit of a large
+ * straight-line program thus costs reading and hashing the file, instead of
+ * lexing and parsing it in full.
+ *
+ * On Linux, changes are detected with inotify on the directory of the file,
+ * so that editors replacing the file on save are followed. Elsewhere, the
+ * modification time of the file is polled.
+ *
+ * ## Usage Example
+ * ```cpp
+ * VirtualMachine vm;
+ * vm.setCollectErrors(true);
+ * Watcher watcher(vm, "prog.avm");
+ * watcher.run(); // runs the program, then again after each change
+ * ```
+ */
+class Watcher {
+public:
+    /**
+     * @brief Constructor.
+     * @param vm The VM loading and running the program
+     * @param path Path of the program file
+     */
+    Watcher(VirtualMachine& vm, const std::string& path);
+
+    /**
+     * @brief Destructor.
+     */
+    ~Watcher();
+
+    /**
+     * @brief Deleted copy constructor (non-copyable).
+     */
+    Watcher(const Watcher&) = delete;
+
+    /**
+     * @brief Deleted copy assignment operator (non-copyable).
+     */
+    Watcher& operator=(const Watcher&) = delete;
+
+    /**
+     * @brief Runs the program, then runs it again after each change of the file.
+     *
+     * Does not return. Parse and execution errors are reported on the error
+     * stream and the watcher keeps waiting for the next change.
+     *
+     * @throws std::runtime_error if the file cannot be watched
+     */
+    void run();
+
+    /**
+     * @brief Reads the file and brings the loaded program up to date.
+     *
+     * Reports what was recompiled on the error stream.
+     *
+     * @return bool True if the program is loaded and can be executed
+     */
+    bool update();
+
+private:
+    VirtualMachine& _vm;                        ///< The VM running the program
+    std::string _path;                          ///< Path of the program file
+    std::vector<uint64_t> _hashes;              ///< Hash of each line, with its newline
+    std::vector<std::vector<Token>> _lines;     ///< Tokens of each line, lexed alone
+    std::vector<size_t> _commands;              ///< Number of top-level commands of each line
+    size_t _structural;                         ///< Number of lines with block, include or macro keywords
+    size_t _exits;                              ///< Number of exit instructions
+    bool _loaded;                               ///< True if _commands describes the loaded program
+    int _notify;                                ///< inotify descriptor (Linux), or -1
+
+    /**
+     * @brief Waits until the file is written or replaced.
+     * @throws std::runtime_error if the file cannot be watched
+     */
+    void wait();
+
+    /**
+     * @brief Lexes one line of the file.
+     * @param text The line, with its newline if it has one
+     * @return std::vector<Token> The tokens, without END_FILE, at line 1
+     */
+    static std::vector<Token> lex(const std::string& text);
+
+    /**
+     * @brief Checks if a line opens or closes a block, includes a file or defines a macro.
+     * @param tokens The tokens of the line
+     * @return bool True if the line cannot be parsed independently of the others
+     */
+    static bool isStructural(const std::vector<Token>& tokens);
+
+    /**
+     * @brief Counts the exit instructions of a line.
+     * @param tokens The tokens of the line
+     * @return size_t Number of exit tokens
+     */
+    static size_t countExits(const std::vector<Token>& tokens);
+
+    /**
+     * @brief Concatenates the tokens of a range of lines, numbering their lines.
+     * @param first Index of the first line
+     * @param count Number of lines
+     * @return std::vector<Token> The tokens, ending with END_FILE
+     */
+    std::vector<Token> tokens(size_t first, size_t count) const;
+
+    /**
+     * @brief Counts the commands of each line from the statement offsets of a parse.
+     * @param first Index of the first line parsed
+     * @param offsets The offsets (see Parser::getOffsets)
+     */
+    void countCommands(size_t first, const std::vector<size_t>& offsets);
+
+    /**
+     * @brief Parses a range of lines and replaces the commands of the old lines.
+     * @param first Index of the first changed line
+     * @param count Number of new lines
+     * @param begin Index of the first command of the old lines
+     * @param end One past the last command of the old lines
+     * @return bool True if the new lines were parsed without error
+     */
+    bool patch(size_t first, size_t count, size_t begin, size_t end);
+
+    /**
+     * @brief Parses the whole program from the cached tokens.
+     * @return bool True if the program was loaded
+     */
+    bool reload();
+};
+
+#endif // WATCHER_HPP
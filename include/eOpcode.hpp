@@ -0,0 +1,81 @@
+/**
+ * @file eOpcode.hpp
+ * @brief Defines the eOpcode enumeration identifying AbstractVM instructions.
+ */
+
+#ifndef EOPCODE_HPP
+#define EOPCODE_HPP
+
+/**
+ * @enum eOpcode
+ * @brief Enumeration of the instructions a command implements.
+ *
+ * Commands report their opcode through ICommand::getOpcode(), so that
+ * execution engines other than the reference command loop can inspect a
+ * parsed program without relying on dynamic_cast.
+ */
+enum class eOpcode {
+    Push,       ///< push with a literal value (PushCommand)
+    PushSlot,   ///< push with a placeholder (PushSlotCommand)
+    Read,       ///< read (ReadCommand)
+    Pop,        ///< pop (PopCommand)
+    Dump,       ///< dump (DumpCommand)
+    Assert,     ///< assert (AssertCommand)
+    Add,        ///< add (AddCommand)
+    Sub,        ///< sub (SubCommand)
+    Mul,        ///< mul (MulCommand)
+    Div,        ///< div (DivCommand)
+    Mod,        ///< mod (ModCommand)
+    Print,      ///< print (PrintCommand)
+    Exit,       ///< exit (ExitCommand)
+    Fork,       ///< fork n ... endfork (ForkCommand)
+    Join,       ///< join (JoinCommand)
+    Send,       ///< send (SendCommand)
+    Recv,       ///< recv (RecvCommand)
+    Use,        ///< use (UseCommand)
+    Move,       ///< move (MoveCommand)
+    Savepoint,  ///< savepoint (SavepointCommand)
+    Rollback,   ///< rollback (RollbackCommand)
+    Commit,     ///< commit (CommitCommand)
+    OnError,    ///< onerror ... endonerror (OnErrorCommand)
+    DumpDelta,  ///< dumpdelta (DumpDeltaCommand)
+    Packed      ///< isomorphic expressions run as lanes (PackedCommand, not parsed)
+};
+
+/**
+ * @brief Converts an eOpcode to the instruction mnemonic.
+ * @param opcode The opcode to convert
+ * @return const char* The mnemonic (e.g., "push", "add")
+ */
+inline const char* opcodeToString(eOpcode opcode) {
+    switch (opcode) {
+        case eOpcode::Push:     return "push";
+        case eOpcode::PushSlot: return "push";
+        case eOpcode::Read:     return "read";
+        case eOpcode::Pop:      return "pop";
+        case eOpcode::Dump:     return "dump";
+        case eOpcode::Assert:   return "assert";
+        case eOpcode::Add:      return "add";
+        case eOpcode::Sub:      return "sub";
+        case eOpcode::Mul:      return "mul";
+        case eOpcode::Div:      return "div";
+        case eOpcode::Mod:      return "mod";
+        case eOpcode::Print:    return "print";
+        case eOpcode::Exit:     return "exit";
+        case eOpcode::Fork:     return "fork";
+        case eOpcode::Join:     return "join";
+        case eOpcode::Send:     return "send";
+        case eOpcode::Recv:     return "recv";
+        case eOpcode::Use:      return "use";
+        case eOpcode::Move:     return "move";
+        case eOpcode::Savepoint: return "savepoint";
+        case eOpcode::Rollback: return "rollback";
+        case eOpcode::Commit:   return "commit";
+        case eOpcode::OnError:  return "onerror";
+        case eOpcode::DumpDelta: return "dumpdelta";
+        case eOpcode::Packed:   return "packed";
+        default:                return "unknown";
+    }
+}
+
+#endif // EOPCODE_HPP
@@ -36,3 +36,41 @@ UnknownInstructionException::UnknownInstructionException(const std::string& mess
 
 NoExitException::NoExitException(const std::string& message)
     : AbstractVMException(message) {}
+
+InputException::InputException(const std::string& message)
+    : AbstractVMException(message) {}
+
+PlaceholderException::PlaceholderException(const std::string& message)
+    : AbstractVMException(message) {}
+
+ForkException::ForkException(const std::string& message)
+    : AbstractVMException(message) {}
+
+ChannelException::ChannelException(const std::string& message)
+    : AbstractVMException(message) {}
+
+SavepointException::SavepointException(const std::string& message)
+    : AbstractVMException(message) {}
+
+OutputException::OutputException(const std::string& message)
+    : AbstractVMException(message) {}
+
+StackLimitException::StackLimitException(const std::string& message)
+    : AbstractVMException(message) {}
+
+int8_t errorCode(const AbstractVMException& error) {
+    if (dynamic_cast<const OverflowException*>(&error)) return 1;
+    if (dynamic_cast<const UnderflowException*>(&error)) return 2;
+    if (dynamic_cast<const DivisionByZeroException*>(&error)) return 3;
+    if (dynamic_cast<const EmptyStackException*>(&error)) return 4;
+    if (dynamic_cast<const InsufficientValuesException*>(&error)) return 5;
+    if (dynamic_cast<const AssertException*>(&error)) return 6;
+    if (dynamic_cast<const InputException*>(&error)) return 7;
+    if (dynamic_cast<const PlaceholderException*>(&error)) return 8;
+    if (dynamic_cast<const ForkException*>(&error)) return 9;
+    if (dynamic_cast<const ChannelException*>(&error)) return 10;
+    if (dynamic_cast<const SavepointException*>(&error)) return 11;
+    if (dynamic_cast<const OutputException*>(&error)) return 12;
+    if (dynamic_cast<const StackLimitException*>(&error)) return 13;
+    return 0;
+}
@@ -0,0 +1,136 @@
+#include "Arithmetic.hpp"
+#include <charconv>
+#include <cmath>
+#include <cstdlib>
+#include <cstdint>
+#include <limits>
+
+namespace {
+    /**
+     * @brief Gets the number of significant digits toString() prints for a type.
+     * @param type A floating-point operand type
+     * @return int The precision passed to the stream
+     */
+    int floatingPrecision(eOperandType type) {
+        return (type == eOperandType::Float) ? std::numeric_limits<float>::digits10 + 1
+                                             : std::numeric_limits<double>::digits10 + 1;
+    }
+}
+
+void typeBounds(eOperandType type, long double& min, long double& max) {
+    switch (type) {
+        case eOperandType::Int8:
+            min = std::numeric_limits<int8_t>::lowest();
+            max = std::numeric_limits<int8_t>::max();
+            break;
+        case eOperandType::Int16:
+            min = std::numeric_limits<int16_t>::lowest();
+            max = std::numeric_limits<int16_t>::max();
+            break;
+        case eOperandType::Int32:
+            min = std::numeric_limits<int32_t>::lowest();
+            max = std::numeric_limits<int32_t>::max();
+            break;
+        case eOperandType::Float:
+            min = std::numeric_limits<float>::lowest();
+            max = std::numeric_limits<float>::max();
+            break;
+        case eOperandType::Double:
+            min = std::numeric_limits<double>::lowest();
+            max = std::numeric_limits<double>::max();
+            break;
+    }
+}
+
+long double rhsValue(eOperandType type, long double value) {
+    if (type != eOperandType::Float && type != eOperandType::Double) {
+        return value;
+    }
+
+    char buffer[64];
+    formatValue(buffer, sizeof(buffer), type, value);
+    return std::strtold(buffer, nullptr);
+}
+
+long double roundResult(long double value) {
+    // Scaling by 10^6 and rounding to an integer gives the digits printed
+    // by "%Lf". It is exact unless the scaled value is too large to be held
+    // as an integer or sits so close to a rounding tie that the error of
+    // the multiplication could flip the decision.
+    const long double limit = 9.0e18L;
+    long double scaled = value * 1000000.0L;
+
+    if (std::isfinite(scaled) && std::fabs(scaled) < limit) {
+        long double rounded = std::nearbyint(scaled);
+        long double distance = std::fabs(std::fabs(scaled - rounded) - 0.5L);
+        long double ulp = std::fabs(scaled) * std::numeric_limits<long double>::epsilon();
+
+        if (distance > 2 * ulp) {
+            // The division is correctly rounded, exactly like strtold
+            // reading back the six-decimal text.
+            return std::copysign(rounded, value) / 1000000.0L;
+        }
+    }
+
+    return std::stold(std::to_string(value));
+}
+
+long double applyArithmetic(eArithmetic op, long double lhs, long double rhs) {
+    switch (op) {
+        case eArithmetic::Add: return lhs + rhs;
+        case eArithmetic::Sub: return lhs - rhs;
+        case eArithmetic::Mul: return lhs * rhs;
+        case eArithmetic::Div: return lhs / rhs;
+        case eArithmetic::Mod: return fmodl(lhs, rhs);
+    }
+    return 0;
+}
+
+bool fitsType(eOperandType type, long double value) {
+    long double min = 0;
+    long double max = 0;
+
+    if (std::isnan(value)) {
+        return type == eOperandType::Float || type == eOperandType::Double; // no integer is NaN
+    }
+    typeBounds(type, min, max);
+    return !(value < min) && !(value > max);
+}
+
+long double castToType(eOperandType type, long double value) {
+    switch (type) {
+        case eOperandType::Int8:   return static_cast<int8_t>(value);
+        case eOperandType::Int16:  return static_cast<int16_t>(value);
+        case eOperandType::Int32:  return static_cast<int32_t>(value);
+        case eOperandType::Float:  return static_cast<float>(value);
+        case eOperandType::Double: return static_cast<double>(value);
+    }
+    return value;
+}
+
+size_t formatValue(char* buffer, size_t size, eOperandType type, long double value) {
+    // std::to_chars prints exactly like "%.*g" and "%lld", without parsing
+    // a format string or consulting the locale
+    char* last = buffer + (size ? size - 1 : 0);
+    std::to_chars_result result;
+
+    if (type == eOperandType::Float || type == eOperandType::Double) {
+        result = std::to_chars(buffer, last, static_cast<double>(value),
+                               std::chars_format::general, floatingPrecision(type));
+    } else {
+        result = std::to_chars(buffer, last, static_cast<long long>(value));
+    }
+    if (result.ec != std::errc()) {
+        result.ptr = buffer;
+    }
+    if (size) {
+        *result.ptr = '\0';
+    }
+    return static_cast<size_t>(result.ptr - buffer);
+}
+
+std::string formatValue(eOperandType type, long double value) {
+    char buffer[64];
+    size_t length = formatValue(buffer, sizeof(buffer), type, value);
+    return std::string(buffer, length);
+}
@@ -0,0 +1,404 @@
+#include "BatchEngine.hpp"
+#include "VirtualMachine.hpp"
+#include "Commands.hpp"
+#include "OperandFactory.hpp"
+#include "AbstractVMException.hpp"
+#include <stdexcept>
+#include <cctype>
+
+namespace {
+    /**
+     * @brief Captures the exception the reference engine raises for a value
+     *        out of the bounds of a type.
+     * @param type The target type
+     * @param value The value
+     * @return std::exception_ptr The Overflow or Underflow exception
+     */
+    std::exception_ptr boundsError(eOperandType type, long double value) {
+        try {
+            OperandFactory factory;
+            delete factory.createOperand(type, value);
+        } catch (...) {
+            return std::current_exception();
+        }
+        return nullptr;
+    }
+
+    /**
+     * @brief Wraps an exception object into an exception_ptr.
+     * @param error The exception to wrap
+     * @return std::exception_ptr Pointer to a copy of the exception
+     */
+    template <typename E>
+    std::exception_ptr capture(const E& error) {
+        return std::make_exception_ptr(error);
+    }
+}
+
+BatchEngine::BatchEngine(VirtualMachine& vm)
+    : _vm(vm), _maxDepth(0) {
+    compile();
+}
+
+void BatchEngine::compile() {
+    std::vector<eOperandType> types; // static type of each stack slot
+    bool exited = false;
+    std::vector<const ICommand*> commands;
+
+    PackedCommand::flatten(_vm.getProgram(), commands);
+    for (const ICommand* command : commands) {
+        Step step{command->getOpcode(), types.size(), eOperandType::Int8,
+                  eOperandType::Int8, eOperandType::Int8, 0, 0, "", {}, nullptr};
+
+        switch (step.opcode) {
+            case eOpcode::Push: {
+                const IOperand* operand = static_cast<const PushCommand&>(*command).getOperand();
+                step.type = operand->getType();
+                step.value = operand->getValue();
+                types.push_back(step.type);
+                break;
+            }
+            case eOpcode::PushSlot: {
+                const auto& push = static_cast<const PushSlotCommand&>(*command);
+                step.type = push.getType();
+                step.slot = push.getSlot();
+                types.push_back(step.type);
+                break;
+            }
+            case eOpcode::Pop:
+                if (types.empty()) {
+                    step.error = capture(EmptyStackException("Pop on empty stack"));
+                } else {
+                    types.pop_back();
+                }
+                break;
+            case eOpcode::Assert: {
+                const IOperand* expected = static_cast<const AssertCommand&>(*command).getExpected();
+                step.type = expected->getType();
+                step.expected = expected->toString();
+                if (types.empty()) {
+                    step.error = capture(EmptyStackException("Assert on empty stack"));
+                } else if (types.back() != step.type) {
+                    step.error = capture(AssertException(
+                        "Assert failed: type mismatch. Expected " +
+                        std::string(operandTypeToString(step.type)) + " but got " +
+                        std::string(operandTypeToString(types.back()))));
+                }
+                break;
+            }
+            case eOpcode::Add:
+            case eOpcode::Sub:
+            case eOpcode::Mul:
+            case eOpcode::Div:
+            case eOpcode::Mod:
+                if (types.size() < 2) {
+                    std::string name = opcodeToString(step.opcode);
+                    name[0] = static_cast<char>(std::toupper(name[0]));
+                    step.error = capture(InsufficientValuesException(
+                        name + " requires at least 2 values on stack"));
+                } else {
+                    step.rhsType = types.back();
+                    types.pop_back();
+                    step.lhsType = types.back();
+                    step.type = resultType(step.lhsType, step.rhsType);
+                    types.back() = step.type;
+                }
+                break;
+            case eOpcode::Exit:
+                step.layout = types;
+                exited = true;
+                break;
+            default:
+                throw std::invalid_argument(std::string("Batch engine does not support '") +
+                                            opcodeToString(step.opcode) + "'");
+        }
+
+        _maxDepth = std::max(_maxDepth, types.size());
+        _steps.push_back(std::move(step));
+
+        // Every lane stops at the first static error or at exit
+        if (_steps.back().error || exited) {
+            break;
+        }
+    }
+
+    if (!exited && (_steps.empty() || !_steps.back().error)) {
+        Step missing{eOpcode::Exit, types.size(), eOperandType::Int8, eOperandType::Int8,
+                     eOperandType::Int8, 0, 0, "", {},
+                     capture(AbstractVMException("Error: 'exit' instruction missing."))};
+        _steps.push_back(std::move(missing));
+    }
+}
+
+void BatchEngine::bind(const std::string& name, std::vector<long double> values,
+                       std::vector<bool> present) {
+    size_t slot = _vm.placeholderSlot(name);
+
+    if (!present.empty() && present.size() != values.size()) {
+        throw std::invalid_argument("Batch placeholder $" + name +
+                                    " has values and flags for different lanes");
+    }
+    if (slot >= _inputs.size()) {
+        _inputs.resize(slot + 1);
+        _bound.resize(slot + 1, false);
+        _present.resize(slot + 1);
+    }
+    _inputs[slot] = std::move(values);
+    _bound[slot] = true;
+    _present[slot] = std::move(present);
+}
+
+std::vector<BatchEngine::LaneResult> BatchEngine::run() {
+    size_t lanes = 0;
+    bool sized = false;
+
+    for (size_t slot = 0; slot < _inputs.size(); ++slot) {
+        if (!_bound[slot]) {
+            continue;
+        }
+        if (sized && _inputs[slot].size() != lanes) {
+            throw std::invalid_argument("Batch placeholders have different lane counts");
+        }
+        lanes = _inputs[slot].size();
+        sized = true;
+    }
+    if (!sized) {
+        lanes = 1;
+    }
+
+    _columns.assign(_maxDepth, Column());
+    _active.assign(lanes, 1);
+    _flags.assign(lanes, 0);
+    _raw.assign(lanes, 0);
+    _results.assign(lanes, LaneResult());
+
+    for (const Step& step : _steps) {
+        if (step.error) {
+            for (size_t lane = 0; lane < lanes; ++lane) {
+                if (_active[lane]) {
+                    fail(lane, step.error);
+                }
+            }
+            break;
+        }
+
+        switch (step.opcode) {
+            case eOpcode::Push:
+                pushConstant(step, lanes);
+                break;
+            case eOpcode::PushSlot:
+                pushSlot(step, lanes);
+                break;
+            case eOpcode::Assert:
+                assertValue(step, lanes);
+                break;
+            case eOpcode::Add:
+            case eOpcode::Sub:
+            case eOpcode::Mul:
+                if (isInteger(step.type)) {
+                    integerArithmetic(step, lanes);
+                } else {
+                    genericArithmetic(step, lanes);
+                }
+                break;
+            case eOpcode::Div:
+            case eOpcode::Mod:
+                genericArithmetic(step, lanes);
+                break;
+            case eOpcode::Exit:
+                exitLanes(step, lanes);
+                break;
+            default: // pop only changes the static depth
+                break;
+        }
+    }
+
+    return std::move(_results);
+}
+
+void BatchEngine::fail(size_t lane, const std::exception_ptr& error) {
+    _active[lane] = 0;
+    _results[lane].error = error;
+}
+
+long double BatchEngine::load(eOperandType type, size_t depth, size_t lane) const {
+    return isInteger(type) ? static_cast<long double>(_columns[depth].ints[lane])
+                           : _columns[depth].reals[lane];
+}
+
+void BatchEngine::store(eOperandType type, size_t depth, size_t lane, long double value) {
+    if (isInteger(type)) {
+        _columns[depth].ints[lane] = static_cast<int64_t>(value);
+    } else {
+        _columns[depth].reals[lane] = value;
+    }
+}
+
+void BatchEngine::pushConstant(const Step& step, size_t lanes) {
+    Column& column = _columns[step.depth];
+
+    if (isInteger(step.type)) {
+        column.ints.assign(lanes, static_cast<int64_t>(step.value));
+    } else {
+        column.reals.assign(lanes, step.value);
+    }
+}
+
+void BatchEngine::pushSlot(const Step& step, size_t lanes) {
+    Column& column = _columns[step.depth];
+    bool perLane = step.slot < _inputs.size() && _bound[step.slot];
+    const std::vector<bool>* present = perLane ? &_present[step.slot] : nullptr;
+    long double shared = 0;
+    std::exception_ptr unbound;
+
+    // Lanes without a value of their own use the VM binding
+    if (!perLane || !present->empty()) {
+        try {
+            shared = _vm.getBinding(step.slot);
+        } catch (...) {
+            unbound = std::current_exception();
+        }
+    }
+    // Sized even if every lane fails: the arithmetic runs over all lanes
+    if (isInteger(step.type)) {
+        column.ints.resize(lanes);
+    } else {
+        column.reals.resize(lanes);
+    }
+    if (!perLane && unbound) {
+        for (size_t lane = 0; lane < lanes; ++lane) {
+            if (_active[lane]) {
+                fail(lane, unbound);
+            }
+        }
+        return;
+    }
+
+    for (size_t lane = 0; lane < lanes; ++lane) {
+        if (!_active[lane]) {
+            continue;
+        }
+        bool own = perLane && (present->empty() || (*present)[lane]);
+        if (!own && unbound) {
+            fail(lane, unbound);
+            continue;
+        }
+        long double value = own ? _inputs[step.slot][lane] : shared;
+        if (!fitsType(step.type, value)) {
+            fail(lane, boundsError(step.type, value));
+            continue;
+        }
+        store(step.type, step.depth, lane, castToType(step.type, value));
+    }
+}
+
+void BatchEngine::assertValue(const Step& step, size_t lanes) {
+    size_t top = step.depth - 1;
+    char buffer[64];
+
+    for (size_t lane = 0; lane < lanes; ++lane) {
+        if (!_active[lane]) {
+            continue;
+        }
+        size_t length = formatValue(buffer, sizeof(buffer), step.type, load(step.type, top, lane));
+        if (step.expected.compare(0, std::string::npos, buffer, length) != 0) {
+            fail(lane, capture(AssertException("Assert failed: value mismatch. Expected " +
+                                               step.expected + " but got " +
+                                               std::string(buffer, length))));
+        }
+    }
+}
+
+void BatchEngine::integerArithmetic(const Step& step, size_t lanes) {
+    int64_t* lhs = _columns[step.depth - 2].ints.data();
+    const int64_t* rhs = _columns[step.depth - 1].ints.data();
+    int64_t* raw = _raw.data();
+    uint8_t* outOfBounds = _flags.data();
+    long double min = 0;
+    long double max = 0;
+
+    typeBounds(step.type, min, max);
+    const int64_t low = static_cast<int64_t>(min);
+    const int64_t high = static_cast<int64_t>(max);
+
+    // Operands are at most 32 bits wide, so the results are exact in 64 bits.
+    // Out-of-bounds results are replaced by 0 to keep masked lanes in range.
+    switch (step.opcode) {
+        case eOpcode::Add:
+            for (size_t lane = 0; lane < lanes; ++lane) {
+                int64_t result = lhs[lane] + rhs[lane];
+                raw[lane] = result;
+                outOfBounds[lane] = (result < low) | (result > high);
+                lhs[lane] = outOfBounds[lane] ? 0 : result;
+            }
+            break;
+        case eOpcode::Sub:
+            for (size_t lane = 0; lane < lanes; ++lane) {
+                int64_t result = lhs[lane] - rhs[lane];
+                raw[lane] = result;
+                outOfBounds[lane] = (result < low) | (result > high);
+                lhs[lane] = outOfBounds[lane] ? 0 : result;
+            }
+            break;
+        default:
+            for (size_t lane = 0; lane < lanes; ++lane) {
+                int64_t result = lhs[lane] * rhs[lane];
+                raw[lane] = result;
+                outOfBounds[lane] = (result < low) | (result > high);
+                lhs[lane] = outOfBounds[lane] ? 0 : result;
+            }
+            break;
+    }
+
+    for (size_t lane = 0; lane < lanes; ++lane) {
+        if (outOfBounds[lane] && _active[lane]) {
+            fail(lane, boundsError(step.type, static_cast<long double>(raw[lane])));
+        }
+    }
+}
+
+void BatchEngine::genericArithmetic(const Step& step, size_t lanes) {
+    const eArithmetic op = toArithmetic(step.opcode);
+    const bool checkZero = (op == eArithmetic::Div || op == eArithmetic::Mod);
+    const size_t lhsDepth = step.depth - 2;
+    const size_t rhsDepth = step.depth - 1;
+
+    if (isInteger(step.type)) {
+        _columns[lhsDepth].ints.resize(lanes);
+    } else {
+        _columns[lhsDepth].reals.resize(lanes);
+    }
+
+    for (size_t lane = 0; lane < lanes; ++lane) {
+        if (!_active[lane]) {
+            continue;
+        }
+
+        long double lhs = load(step.lhsType, lhsDepth, lane);
+        long double rhs = rhsValue(step.rhsType, load(step.rhsType, rhsDepth, lane));
+        if (checkZero && rhs == 0.0) {
+            fail(lane, capture(DivisionByZeroException("Division by zero error.")));
+            continue;
+        }
+
+        long double result = roundResult(applyArithmetic(op, lhs, rhs));
+        if (!fitsType(step.type, result)) {
+            fail(lane, boundsError(step.type, result));
+            continue;
+        }
+        store(step.type, lhsDepth, lane, castToType(step.type, result));
+    }
+}
+
+void BatchEngine::exitLanes(const Step& step, size_t lanes) {
+    for (size_t lane = 0; lane < lanes; ++lane) {
+        if (!_active[lane]) {
+            continue;
+        }
+        std::vector<Scalar>& stack = _results[lane].stack;
+        stack.reserve(step.layout.size());
+        for (size_t depth = 0; depth < step.layout.size(); ++depth) {
+            stack.push_back(Scalar{step.layout[depth], load(step.layout[depth], depth, lane)});
+        }
+    }
+}
@@ -0,0 +1,73 @@
+#include "BinaryReader.hpp"
+#include "AbstractVMException.hpp"
+#include <algorithm>
+#include <cstring>
+#include <cerrno>
+#include <stdexcept>
+#include <fcntl.h>
+#include <unistd.h>
+
+BinaryReader::BinaryReader(const std::string& path)
+    : _fd(::open(path.c_str(), O_RDONLY)), _ownsFd(true), _buffer(BUFFER_SIZE),
+      _begin(0), _end(0), _consumed(0), _eof(false) {
+    if (_fd < 0) {
+        throw std::runtime_error("Error: Unable to open input file " + path);
+    }
+}
+
+BinaryReader::BinaryReader(int fd)
+    : _fd(fd), _ownsFd(false), _buffer(BUFFER_SIZE),
+      _begin(0), _end(0), _consumed(0), _eof(false) {}
+
+BinaryReader::~BinaryReader() {
+    if (_ownsFd) {
+        ::close(_fd);
+    }
+}
+
+bool BinaryReader::refill() {
+    if (_eof) {
+        return false;
+    }
+
+    ssize_t count;
+    do {
+        count = ::read(_fd, _buffer.data(), _buffer.size());
+    } while (count < 0 && errno == EINTR);
+
+    if (count < 0) {
+        throw InputException("Input read failed: " + std::string(std::strerror(errno)));
+    }
+    if (count == 0) {
+        _eof = true;
+        return false;
+    }
+
+    _begin = 0;
+    _end = static_cast<size_t>(count);
+    return true;
+}
+
+void BinaryReader::readBytes(void* dest, size_t size) {
+    char* out = static_cast<char*>(dest);
+    size_t offset = _consumed;
+    size_t remaining = size;
+
+    while (remaining > 0) {
+        if (_begin == _end && !refill()) {
+            throw InputException("Unexpected end of input: " + std::to_string(size) +
+                                 " bytes requested at offset " + std::to_string(offset));
+        }
+
+        size_t chunk = std::min(remaining, _end - _begin);
+        std::memcpy(out, _buffer.data() + _begin, chunk);
+        out += chunk;
+        _begin += chunk;
+        _consumed += chunk;
+        remaining -= chunk;
+    }
+}
+
+size_t BinaryReader::position() const {
+    return _consumed;
+}
@@ -0,0 +1,128 @@
+#include "Channel.hpp"
+#include "AbstractVMException.hpp"
+#include <thread>
+
+Channel::Channel(const std::string& name, size_t capacity)
+    : _name(name), _mask(0), _sender(nullptr), _receiver(nullptr),
+      _senderDone(false), _receiverDone(false),
+      _head(0), _tailCache(0), _tail(0), _headCache(0) {
+    size_t size = 1;
+    while (size < capacity) {
+        size <<= 1;
+    }
+    _buffer.resize(size);
+    _mask = size - 1;
+}
+
+const std::string& Channel::getName() const {
+    return _name;
+}
+
+void Channel::attach(const void* owner, bool sender) {
+    const void*& end = sender ? _sender : _receiver;
+
+    if (end && end != owner) {
+        throw ChannelException("Channel '" + _name + "' already has another " +
+                               (sender ? "sender" : "receiver"));
+    }
+    end = owner;
+    open(owner);
+}
+
+void Channel::open(const void* owner) {
+    if (owner == _sender) {
+        _senderDone.store(false, std::memory_order_release);
+    }
+    if (owner == _receiver) {
+        _receiverDone.store(false, std::memory_order_release);
+    }
+}
+
+void Channel::close(const void* owner) {
+    if (owner == _sender) {
+        _senderDone.store(true, std::memory_order_release);
+    }
+    if (owner == _receiver) {
+        _receiverDone.store(true, std::memory_order_release);
+    }
+}
+
+bool Channel::trySend(const Scalar& value) {
+    size_t tail = _tail.load(std::memory_order_relaxed);
+
+    if (tail - _headCache > _mask) {
+        _headCache = _head.load(std::memory_order_acquire);
+        if (tail - _headCache > _mask) {
+            return false;
+        }
+    }
+    _buffer[tail & _mask] = value;
+    _tail.store(tail + 1, std::memory_order_release);
+    return true;
+}
+
+bool Channel::tryReceive(Scalar& value) {
+    size_t head = _head.load(std::memory_order_relaxed);
+
+    if (head == _tailCache) {
+        _tailCache = _tail.load(std::memory_order_acquire);
+        if (head == _tailCache) {
+            return false;
+        }
+    }
+    value = _buffer[head & _mask];
+    _head.store(head + 1, std::memory_order_release);
+    return true;
+}
+
+void Channel::backoff(size_t attempt) {
+    if (attempt < 64) {
+        return; // spin
+    }
+    std::this_thread::yield();
+}
+
+void Channel::send(const Scalar& value) {
+    for (size_t attempt = 0; !trySend(value); ++attempt) {
+        if (_receiverDone.load(std::memory_order_acquire)) {
+            throw ChannelException("Channel '" + _name + "' is closed");
+        }
+        if (!_receiver || _receiver == _sender) {
+            // Nothing else will ever make room
+            throw ChannelException("Channel '" + _name + "' is full and has no other receiver");
+        }
+        backoff(attempt);
+    }
+}
+
+Scalar Channel::receive() {
+    Scalar value{eOperandType::Int8, 0};
+
+    for (size_t attempt = 0; !tryReceive(value); ++attempt) {
+        if (_senderDone.load(std::memory_order_acquire)) {
+            // Values sent before the close are still delivered
+            if (tryReceive(value)) {
+                break;
+            }
+            throw ChannelException("Channel '" + _name + "' is closed");
+        }
+        if (!_sender || _sender == _receiver) {
+            throw ChannelException("Channel '" + _name + "' is empty and has no other sender");
+        }
+        backoff(attempt);
+    }
+    return value;
+}
+
+ChannelRegistry::ChannelRegistry(size_t capacity)
+    : _capacity(capacity) {}
+
+Channel& ChannelRegistry::get(const std::string& name) {
+    std::lock_guard<std::mutex> lock(_mutex);
+    std::unique_ptr<Channel>& channel = _channels[name];
+
+    if (!channel) {
+        channel = std::make_unique<Channel>(name, _capacity);
+    }
+    return *channel;
+}
@@ -1,6 +1,10 @@
 #include "AbstractVM.hpp"
 #include <iostream>
+#include <fstream>
 #include <functional>
+#include <algorithm>
+#include "Arithmetic.hpp"
+#include "StackContainer.hpp"
 
 namespace {
     /**
@@ -19,7 +23,7 @@ namespace {
      * @throws InsufficientValuesException if stack has fewer than 2 values
      */
     void performBinaryOperation(
-        std::stack<const IOperand*>& stack,
+        OperandStack& stack,
         std::function<const IOperand*(const IOperand&, const IOperand&)> operation,
         const std::string& opName)
     {
@@ -27,14 +31,20 @@ namespace {
             throw InsufficientValuesException(opName + " requires at least 2 values on stack");
         }
 
-        // Pop two operands (v2 on top, v1 below)
+        // Operands: v2 on top, v1 below
         const IOperand* v2 = stack.top();
         stack.pop();
         const IOperand* v1 = stack.top();
-        stack.pop();
 
-        // Perform operation
-        const IOperand* result = operation(*v1, *v2);
+        // Perform operation, leaving the stack unchanged if it fails
+        const IOperand* result;
+        try {
+            result = operation(*v1, *v2);
+        } catch (...) {
+            stack.push(v2);
+            throw;
+        }
+        stack.pop();
 
         // Clean up operands
         delete v1;
@@ -48,17 +58,42 @@ namespace {
 PushCommand::PushCommand(const IOperand* operand)
     : _operand(operand) {}
 
-void PushCommand::execute(std::stack<const IOperand*>& stack) {
-    stack.push(_operand);
-    _operand = nullptr; // Transfer ownership to stack
+void PushCommand::execute(OperandStack& stack) {
+    stack.push(_operand->clone());
+}
+
+eOpcode PushCommand::getOpcode() const {
+    return eOpcode::Push;
+}
+
+const IOperand* PushCommand::getOperand() const {
+    return _operand;
 }
 
 PushCommand::~PushCommand() {
-    // Clean up if operand wasn't pushed (error occurred)
     delete _operand;
 }
 
-void PopCommand::execute(std::stack<const IOperand*>& stack) {
+PushSlotCommand::PushSlotCommand(VirtualMachine* vm, eOperandType type, size_t slot)
+    : _vm(vm), _type(type), _slot(slot) {}
+
+void PushSlotCommand::execute(OperandStack& stack) {
+    stack.push(_factory.createOperand(_type, _vm->getBinding(_slot)));
+}
+
+eOpcode PushSlotCommand::getOpcode() const {
+    return eOpcode::PushSlot;
+}
+
+eOperandType PushSlotCommand::getType() const {
+    return _type;
+}
+
+size_t PushSlotCommand::getSlot() const {
+    return _slot;
+}
+
+void PopCommand::execute(OperandStack& stack) {
     if (stack.empty()) {
         throw EmptyStackException("Pop on empty stack");
     }
@@ -68,29 +103,119 @@ void PopCommand::execute(std::stack<const IOperand*>& stack) {
     delete top; // Clean up the operand
 }
 
-void DumpCommand::execute(std::stack<const IOperand*>& stack) {
-    // Create a temporary stack to preserve order
-    std::stack<const IOperand*> temp;
+eOpcode PopCommand::getOpcode() const {
+    return eOpcode::Pop;
+}
 
-    // Move all elements to temp (reverses order)
-    while (!stack.empty()) {
-        temp.push(stack.top());
-        stack.pop();
+namespace {
+    /**
+     * @brief Values of a stack, oldest first.
+     */
+    using Values = OperandBuffer::const_iterator;
+
+    /**
+     * @brief Gets the first of the top values of a stack.
+     * @param stack The VM stack
+     * @param count Number of top values
+     * @return Values The oldest of them
+     */
+    Values firstOfTop(OperandStack& stack, size_t count) {
+        const auto& values = StackContainer::of(stack);
+        return values.end() - static_cast<std::ptrdiff_t>(std::min(values.size(), count));
+    }
+
+    /**
+     * @brief Writes values as a binary dump.
+     * @param output The stream written to
+     * @param begin First value (the oldest)
+     * @param end One past the last value
+     */
+    void writeBinary(std::ostream& output, Values begin, Values end) {
+        BinaryDumpWriter writer(output, static_cast<uint64_t>(end - begin));
+
+        for (Values value = begin; value != end; ++value) {
+            writer.write((*value)->getType(), (*value)->getValue());
+        }
+        writer.finish();
+    }
+
+    /**
+     * @brief Writes the top values of a stack to the standard output, oldest first.
+     * @param vm The VM, giving the dump queue and the threads formatting text
+     * @param stack The VM stack
+     * @param count Number of values written
+     * @param format The dump format
+     */
+    void dumpTop(VirtualMachine& vm, OperandStack& stack, size_t count,
+                 eDumpFormat format) {
+        Values begin = firstOfTop(stack, count);
+        Values end = StackContainer::of(stack).cend();
+
+        if (DumpQueue* queue = vm.getDumpQueue()) {
+            queue->dump(begin, end, format);
+        } else if (format == eDumpFormat::Binary) {
+            writeBinary(std::cout, begin, end);
+        } else {
+            writeTextDump(std::cout, begin, end, vm.getThreads(), format);
+        }
+    }
+}
+
+DumpCommand::DumpCommand(VirtualMachine* vm, size_t count, const std::string& path)
+    : _vm(vm), _count(count), _path(path) {}
+
+size_t DumpCommand::getCount() const {
+    return _count;
+}
+
+const std::string& DumpCommand::getPath() const {
+    return _path;
+}
+
+void DumpCommand::execute(OperandStack& stack) {
+    if (!_path.empty()) {
+        std::ofstream file(_path, std::ios::binary | std::ios::trunc);
+        if (!file.is_open()) {
+            throw OutputException("Unable to open dump file " + _path);
+        }
+        writeBinary(file, firstOfTop(stack, _count), StackContainer::of(stack).cend());
+        if (!file) {
+            throw OutputException("Unable to write dump file " + _path);
+        }
+    } else {
+        dumpTop(*_vm, stack, _count, _vm->getDumpFormat());
     }
+}
+
+eOpcode DumpCommand::getOpcode() const {
+    return eOpcode::Dump;
+}
+
+DumpDeltaCommand::DumpDeltaCommand(VirtualMachine* vm)
+    : _vm(vm) {}
+
+void DumpDeltaCommand::execute(OperandStack& stack) {
+    size_t first = _vm->takeLowestChange();
+    eDumpFormat format = _vm->getDumpFormat();
+    std::string marker;
 
-    // Print and restore (now in correct order: most recent first)
-    while (!temp.empty()) {
-        const IOperand* op = temp.top();
-        std::cout << op->toString() << std::endl;
-        stack.push(op);
-        temp.pop();
+    appendDeltaMarker(marker, format, first);
+    if (DumpQueue* queue = _vm->getDumpQueue()) {
+        queue->write(marker.data(), marker.size());
+    } else {
+        std::cout.write(marker.data(), static_cast<std::streamsize>(marker.size()));
     }
+    dumpTop(*_vm, stack, stack.size() - first, format);
+}
+
+eOpcode DumpDeltaCommand::getOpcode() const {
+    return eOpcode::DumpDelta;
 }
 
 AssertCommand::AssertCommand(const IOperand* operand)
     : _expected(operand) {}
 
-void AssertCommand::execute(std::stack<const IOperand*>& stack) {
+void AssertCommand::execute(OperandStack& stack) {
     if (stack.empty()) {
         throw EmptyStackException("Assert on empty stack");
     }
@@ -114,41 +239,72 @@ void AssertCommand::execute(std::stack<const IOperand*>& stack) {
     // Assert passed - do nothing to the stack
 }
 
+eOpcode AssertCommand::getOpcode() const {
+    return eOpcode::Assert;
+}
+
+const IOperand* AssertCommand::getExpected() const {
+    return _expected;
+}
+
 AssertCommand::~AssertCommand() {
     delete _expected;
 }
 
-void AddCommand::execute(std::stack<const IOperand*>& stack) {
+void AddCommand::execute(OperandStack& stack) {
     performBinaryOperation(stack, [](const IOperand& v1, const IOperand& v2) {
         return v1 + v2;
     }, "Add");
 }
 
-void SubCommand::execute(std::stack<const IOperand*>& stack) {
+eOpcode AddCommand::getOpcode() const {
+    return eOpcode::Add;
+}
+
+void SubCommand::execute(OperandStack& stack) {
     performBinaryOperation(stack, [](const IOperand& v1, const IOperand& v2) {
         return v1 - v2;
     }, "Sub");
 }
 
-void MulCommand::execute(std::stack<const IOperand*>& stack) {
+eOpcode SubCommand::getOpcode() const {
+    return eOpcode::Sub;
+}
+
+void MulCommand::execute(OperandStack& stack) {
     performBinaryOperation(stack, [](const IOperand& v1, const IOperand& v2) {
         return v1 * v2;
     }, "Mul");
 }
 
-void DivCommand::execute(std::stack<const IOperand*>& stack) {
+eOpcode MulCommand::getOpcode() const {
+    return eOpcode::Mul;
+}
+
+void DivCommand::execute(OperandStack& stack) {
     performBinaryOperation(stack, [](const IOperand& v1, const IOperand& v2) {
         return v1 / v2;
     }, "Div");
 }
 
-void ModCommand::execute(std::stack<const IOperand*>& stack) {
+eOpcode DivCommand::getOpcode() const {
+    return eOpcode::Div;
+}
+
+void ModCommand::execute(OperandStack& stack) {
     performBinaryOperation(stack, [](const IOperand& v1, const IOperand& v2) {
         return v1 % v2;
     }, "Mod");
 }
 
-void PrintCommand::execute(std::stack<const IOperand*>& stack) {
+eOpcode ModCommand::getOpcode() const {
+    return eOpcode::Mod;
+}
+
+PrintCommand::PrintCommand(VirtualMachine* vm)
+    : _vm(vm) {}
+
+void PrintCommand::execute(OperandStack& stack) {
     if (stack.empty()) {
         throw EmptyStackException("Print on empty stack");
     }
@@ -164,17 +320,366 @@ void PrintCommand::execute(std::stack<const IOperand*>& stack) {
     // Get the value and interpret as ASCII
     int value = std::stoi(top->toString());
 
-    // Print as character
-    std::cout << static_cast<char>(value);// << std::endl;
+    // Print as character, after the dumps still being written
+    char character = static_cast<char>(value);
+    if (DumpQueue* queue = _vm->getDumpQueue()) {
+        queue->write(&character, 1);
+    } else {
+        std::cout << character;// << std::endl;
+    }
+}
+
+eOpcode PrintCommand::getOpcode() const {
+    return eOpcode::Print;
 }
 
 ExitCommand::ExitCommand(VirtualMachine* vm)
     : _vm(vm) {}
 
-void ExitCommand::execute(std::stack<const IOperand*>& stack) {
+void ExitCommand::execute(OperandStack& stack) {
     (void)stack; // Unused parameter
     // Signal the VM that exit has been called
     if (_vm) {
         _vm->setExitCalled();
     }
 }
+
+eOpcode ExitCommand::getOpcode() const {
+    return eOpcode::Exit;
+}
+
+ReadCommand::ReadCommand(VirtualMachine* vm, eOperandType type)
+    : _vm(vm), _type(type) {}
+
+void ReadCommand::execute(OperandStack& stack) {
+    BinaryReader* input = _vm ? _vm->getInput() : nullptr;
+    if (!input) {
+        throw InputException("Read requires an input stream (use --input)");
+    }
+
+    long double value = 0;
+    switch (_type) {
+        case eOperandType::Int8:   value = input->read<int8_t>(); break;
+        case eOperandType::Int16:  value = input->read<int16_t>(); break;
+        case eOperandType::Int32:  value = input->read<int32_t>(); break;
+        case eOperandType::Float:  value = input->read<float>(); break;
+        case eOperandType::Double: value = input->read<double>(); break;
+    }
+
+    stack.push(_factory.createOperand(_type, value));
+}
+
+eOpcode ReadCommand::getOpcode() const {
+    return eOpcode::Read;
+}
+
+eOperandType ReadCommand::getType() const {
+    return _type;
+}
+
+PackedCommand::PackedCommand(VirtualMachine* vm, std::vector<std::unique_ptr<ICommand>> commands,
+                             size_t lanes)
+    : _vm(vm), _commands(std::move(commands)), _lanes(lanes) {
+    size_t length = _commands.size() / _lanes;
+    std::vector<eOperandType> types; // static type of each slot of the expression
+
+    _values.resize(length * _lanes, 0.0L);
+    _slots.resize(length * _lanes, 0);
+
+    for (size_t index = 0; index < length; ++index) {
+        Step step{_commands[index]->getOpcode(), types.size(), eOperandType::Int8,
+                  eOperandType::Int8};
+
+        switch (step.opcode) {
+            case eOpcode::Push:
+                for (size_t lane = 0; lane < _lanes; ++lane) {
+                    const auto& push = static_cast<const PushCommand&>(*_commands[lane * length + index]);
+                    _values[index * _lanes + lane] = push.getOperand()->getValue();
+                }
+                step.type = static_cast<const PushCommand&>(*_commands[index]).getOperand()->getType();
+                types.push_back(step.type);
+                break;
+            case eOpcode::PushSlot:
+                for (size_t lane = 0; lane < _lanes; ++lane) {
+                    const auto& push = static_cast<const PushSlotCommand&>(*_commands[lane * length + index]);
+                    _slots[index * _lanes + lane] = push.getSlot();
+                }
+                step.type = static_cast<const PushSlotCommand&>(*_commands[index]).getType();
+                types.push_back(step.type);
+                break;
+            default:
+                // Arithmetic: the pass only packs closed expressions
+                step.rhsType = types.back();
+                types.pop_back();
+                step.type = resultType(types.back(), step.rhsType);
+                types.back() = step.type;
+                break;
+        }
+        _steps.push_back(step);
+        _columns.resize(std::max(_columns.size(), types.size() * _lanes));
+    }
+}
+
+bool PackedCommand::evaluate() {
+    for (size_t index = 0; index < _steps.size(); ++index) {
+        const Step& step = _steps[index];
+        long double* top = &_columns[step.depth * _lanes];
+
+        switch (step.opcode) {
+            case eOpcode::Push:
+                std::copy_n(&_values[index * _lanes], _lanes, top);
+                break;
+            case eOpcode::PushSlot:
+                if (!_vm) {
+                    return false;
+                }
+                for (size_t lane = 0; lane < _lanes; ++lane) {
+                    long double value;
+                    try {
+                        value = _vm->getBinding(_slots[index * _lanes + lane]);
+                    } catch (const AbstractVMException&) {
+                        return false;
+                    }
+                    if (!fitsType(step.type, value)) {
+                        return false;
+                    }
+                    top[lane] = castToType(step.type, value);
+                }
+                break;
+            default: {
+                eArithmetic op = toArithmetic(step.opcode);
+                long double* lhs = top - 2 * _lanes;
+                long double* rhs = top - _lanes;
+
+                for (size_t lane = 0; lane < _lanes; ++lane) {
+                    long double right = rhsValue(step.rhsType, rhs[lane]);
+                    if ((op == eArithmetic::Div || op == eArithmetic::Mod) && right == 0) {
+                        return false;
+                    }
+                    long double value = roundResult(applyArithmetic(op, lhs[lane], right));
+                    if (!fitsType(step.type, value)) {
+                        return false;
+                    }
+                    lhs[lane] = castToType(step.type, value);
+                }
+                break;
+            }
+        }
+    }
+    return true;
+}
+
+void PackedCommand::replay(OperandStack& stack) {
+    for (const auto& command : _commands) {
+        command->execute(stack);
+        if (OperandBuffer::faulted()) {
+            _vm->settleStacks();
+        }
+    }
+}
+
+void PackedCommand::execute(OperandStack& stack) {
+    if (!evaluate()) {
+        // Let the original commands raise the error in program order
+        replay(stack);
+        return;
+    }
+
+    eOperandType type = _steps.empty() ? eOperandType::Int8 : _steps.back().type;
+    StackContainer::of(stack).reserve(_lanes);
+    for (size_t lane = 0; lane < _lanes; ++lane) {
+        stack.push(_factory.createOperand(type, _columns[lane]));
+    }
+}
+
+eOpcode PackedCommand::getOpcode() const {
+    return eOpcode::Packed;
+}
+
+const std::vector<std::unique_ptr<ICommand>>& PackedCommand::getCommands() const {
+    return _commands;
+}
+
+std::vector<std::unique_ptr<ICommand>> PackedCommand::releaseCommands() {
+    return std::move(_commands);
+}
+
+size_t PackedCommand::getLanes() const {
+    return _lanes;
+}
+
+void PackedCommand::flatten(const std::vector<std::unique_ptr<ICommand>>& commands,
+                            std::vector<const ICommand*>& flat) {
+    for (const auto& command : commands) {
+        if (command->getOpcode() == eOpcode::Packed) {
+            flatten(static_cast<const PackedCommand&>(*command).getCommands(), flat);
+        } else {
+            flat.push_back(command.get());
+        }
+    }
+}
+
+ForkCommand::ForkCommand(VirtualMachine* vm, std::unique_ptr<VirtualMachine> child,
+                         std::vector<std::unique_ptr<ICommand>> commands, size_t count)
+    : _vm(vm), _child(std::move(child)), _commands(std::move(commands)), _count(count) {}
+
+ForkCommand::~ForkCommand() {}
+
+void ForkCommand::execute(OperandStack& stack) {
+    if (stack.size() < _count) {
+        throw InsufficientValuesException("Fork requires at least " + std::to_string(_count) +
+                                          " values on stack");
+    }
+
+    // The child takes the top values, in stack order
+    std::vector<const IOperand*> arguments(_count);
+    for (size_t index = _count; index-- > 0;) {
+        arguments[index] = stack.top();
+        stack.pop();
+    }
+
+    VirtualMachine* parent = _vm;
+    VirtualMachine* child = _child.get();
+    const std::vector<std::unique_ptr<ICommand>>* commands = &_commands;
+    std::mutex* running = &_running;
+    try {
+        _vm->startFork(std::async(std::launch::async, [parent, child, commands, running, arguments]() {
+            // One run at a time on the child VM
+            std::lock_guard<std::mutex> lock(*running);
+            child->inheritBindings(*parent);
+            child->inheritDumps(*parent);
+            return child->runBlock(*commands, arguments);
+        }));
+    } catch (...) {
+        for (const IOperand* argument : arguments) {
+            delete argument;
+        }
+        throw;
+    }
+}
+
+eOpcode ForkCommand::getOpcode() const {
+    return eOpcode::Fork;
+}
+
+size_t ForkCommand::getCount() const {
+    return _count;
+}
+
+JoinCommand::JoinCommand(VirtualMachine* vm)
+    : _vm(vm) {}
+
+void JoinCommand::execute(OperandStack& stack) {
+    std::vector<const IOperand*> results = _vm->joinFork();
+    auto& values = StackContainer::of(stack);
+
+    // Checked in one go: the results are stored only if they all fit
+    try {
+        values.insert(values.end(), results.data(), results.data() + results.size());
+    } catch (...) {
+        for (const IOperand* result : results) {
+            delete result;
+        }
+        throw;
+    }
+}
+
+eOpcode JoinCommand::getOpcode() const {
+    return eOpcode::Join;
+}
+
+SendCommand::SendCommand(Channel* channel)
+    : _channel(channel) {}
+
+void SendCommand::execute(OperandStack& stack) {
+    if (stack.empty()) {
+        throw EmptyStackException("Send on empty stack");
+    }
+
+    const IOperand* top = stack.top();
+    _channel->send(Scalar{top->getType(), top->getValue()});
+    stack.pop();
+    delete top;
+}
+
+eOpcode SendCommand::getOpcode() const {
+    return eOpcode::Send;
+}
+
+RecvCommand::RecvCommand(Channel* channel)
+    : _channel(channel) {}
+
+void RecvCommand::execute(OperandStack& stack) {
+    Scalar value = _channel->receive();
+    stack.push(_factory.createOperand(value.type, value.value));
+}
+
+eOpcode RecvCommand::getOpcode() const {
+    return eOpcode::Recv;
+}
+
+UseCommand::UseCommand(VirtualMachine* vm, size_t stack)
+    : _vm(vm), _stack(stack) {}
+
+void UseCommand::execute(OperandStack&) {
+    _vm->useStack(_stack);
+}
+
+eOpcode UseCommand::getOpcode() const {
+    return eOpcode::Use;
+}
+
+MoveCommand::MoveCommand(VirtualMachine* vm, size_t from, size_t to, size_t count)
+    : _vm(vm), _from(from), _to(to), _count(count) {}
+
+void MoveCommand::execute(OperandStack&) {
+    _vm->moveValues(_from, _to, _count);
+}
+
+eOpcode MoveCommand::getOpcode() const {
+    return eOpcode::Move;
+}
+
+SavepointCommand::SavepointCommand(VirtualMachine* vm)
+    : _vm(vm) {}
+
+void SavepointCommand::execute(OperandStack&) {
+    _vm->savepoint();
+}
+
+eOpcode SavepointCommand::getOpcode() const {
+    return eOpcode::Savepoint;
+}
+
+RollbackCommand::RollbackCommand(VirtualMachine* vm)
+    : _vm(vm) {}
+
+void RollbackCommand::execute(OperandStack&) {
+    _vm->rollback();
+}
+
+eOpcode RollbackCommand::getOpcode() const {
+    return eOpcode::Rollback;
+}
+
+CommitCommand::CommitCommand(VirtualMachine* vm)
+    : _vm(vm) {}
+
+void CommitCommand::execute(OperandStack&) {
+    _vm->commit();
+}
+
+eOpcode CommitCommand::getOpcode() const {
+    return eOpcode::Commit;
+}
+
+OnErrorCommand::OnErrorCommand(VirtualMachine* vm, std::vector<std::unique_ptr<ICommand>> handler)
+    : _vm(vm), _handler(std::move(handler)) {}
+
+void OnErrorCommand::execute(OperandStack&) {
+    _vm->setErrorHandler(&_handler);
+}
+
+eOpcode OnErrorCommand::getOpcode() const {
+    return eOpcode::OnError;
+}
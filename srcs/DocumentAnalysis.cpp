@@ -0,0 +1,399 @@
+#include "DocumentAnalysis.hpp"
+#include "Lexer.hpp"
+#include "Parser.hpp"
+#include "Commands.hpp"
+#include "Arithmetic.hpp"
+#include <algorithm>
+#include <cctype>
+#include <sstream>
+
+namespace {
+    /**
+     * @brief Removes the line number the lexer or parser appends to a message.
+     *
+     * Each line is lexed alone, so the number is not that of the document;
+     * the range of the diagnostic gives the position instead.
+     *
+     * @param message The message, such as "Unknown instruction '@' at line 3"
+     * @return std::string The message without " at line 3"
+     */
+    std::string withoutLine(const std::string& message) {
+        static const std::string suffix = " at line ";
+        size_t at = message.rfind(suffix);
+        size_t digits = at + suffix.size();
+
+        if (at == std::string::npos || digits == message.size() ||
+            !std::all_of(message.begin() + static_cast<std::ptrdiff_t>(digits), message.end(),
+                         [](unsigned char c) { return std::isdigit(c); })) {
+            return message;
+        }
+        return message.substr(0, at);
+    }
+}
+
+DocumentAnalysis::DocumentAnalysis()
+    : _nodes(1, Node{0, 0, eOperandType::Int8}), _exits(0), _analysed(0), _compacted(1) {
+    _vm.setCollectErrors(true);
+    setText("");
+}
+
+void DocumentAnalysis::setText(const std::string& text) {
+    _lines.clear();
+    _errors.clear();
+    _macros.clear();
+    _nodes.resize(1);
+    _exits = 0;
+
+    size_t begin = 0;
+    for (;;) {
+        size_t end = text.find('\n', begin);
+        _lines.push_back(parse(text.substr(begin, end - begin), _lines.size()));
+        _exits += _lines.back().exits;
+        countMacros(_lines.back(), 1);
+        if (end == std::string::npos) {
+            break;
+        }
+        begin = end + 1;
+    }
+
+    _stacks.assign(_lines.size() + 1, Stack{0, eState::Known});
+    propagate(0, _lines.size());
+    _compacted = _nodes.size();
+}
+
+void DocumentAnalysis::replace(size_t first, size_t last, const std::vector<std::string>& lines) {
+    std::vector<Line> parsed;
+    parsed.reserve(lines.size());
+    for (size_t index = 0; index < lines.size(); ++index) {
+        parsed.push_back(parse(lines[index], first + index));
+    }
+    bool macros = false;
+    for (size_t index = first; index < last; ++index) {
+        _exits -= _lines[index].exits;
+        macros = countMacros(_lines[index], -1) || macros;
+    }
+    for (const Line& line : parsed) {
+        _exits += line.exits;
+        macros = countMacros(line, 1) || macros;
+    }
+
+    // Splice the lines, and the stacks between them; the stack after the
+    // replaced lines is kept to detect reconvergence
+    auto begin = static_cast<std::ptrdiff_t>(first);
+    auto removed = static_cast<std::ptrdiff_t>(last - first);
+    auto added = static_cast<std::ptrdiff_t>(parsed.size());
+    if (added == removed) {
+        std::move(parsed.begin(), parsed.end(), _lines.begin() + begin);
+    } else {
+        _lines.erase(_lines.begin() + begin, _lines.begin() + begin + removed);
+        _lines.insert(_lines.begin() + begin, std::make_move_iterator(parsed.begin()),
+                      std::make_move_iterator(parsed.end()));
+        _stacks.erase(_stacks.begin() + begin + 1, _stacks.begin() + begin + removed);
+        _stacks.insert(_stacks.begin() + begin + 1, static_cast<size_t>(added - 1),
+                       Stack{0, eState::Unknown});
+
+        // Lines after the edit move
+        std::set<size_t> errors(_errors.begin(), _errors.lower_bound(first));
+        for (auto error = _errors.lower_bound(last); error != _errors.end(); ++error) {
+            errors.insert(errors.end(), *error - last + first + parsed.size());
+        }
+        _errors = std::move(errors);
+    }
+
+    // Uses of a macro defined or undefined anywhere change meaning
+    propagate(macros ? 0 : first, macros ? _lines.size() : first + parsed.size());
+
+    // Stacks of replaced lines are never freed: recompute all of them once in a while
+    if (_nodes.size() > 2 * _compacted + (1u << 20)) {
+        size_t analysed = _analysed;
+        _nodes.resize(1);
+        propagate(0, _lines.size());
+        _compacted = _nodes.size();
+        _analysed = analysed;
+    }
+}
+
+size_t DocumentAnalysis::getLineCount() const {
+    return _lines.size();
+}
+
+size_t DocumentAnalysis::getAnalysedCount() const {
+    return _analysed;
+}
+
+DocumentAnalysis::Line DocumentAnalysis::parse(const std::string& text, size_t index) {
+    Line line{{}, "", "", "", "", false, false, 0};
+    std::istringstream input(text + "\n");
+    Lexer lexer(input, false, true);
+    std::vector<Token> tokens;
+
+    // Number the tokens like the whole document
+    for (const Token& token : lexer.tokenize()) {
+        switch (token.getType()) {
+            case TokenType::FORK:
+            case TokenType::ENDFORK:
+            case TokenType::ONERROR:
+            case TokenType::ENDONERROR:
+            case TokenType::INCLUDE:
+            case TokenType::MACRO:
+                line.opaque = true;
+                break;
+            case TokenType::ENDMACRO:
+                line.opaque = line.endmacro = true;
+                break;
+            case TokenType::IDENTIFIER:
+                if (tokens.empty()) {
+                    line.call = token.getValue();
+                } else if (tokens.back().getType() == TokenType::MACRO) {
+                    line.macro = token.getValue();
+                }
+                break;
+            case TokenType::EXIT:
+                ++line.exits;
+                break;
+            default:
+                break;
+        }
+        tokens.emplace_back(token.getType(), token.getValue(), token.getLine() + index,
+                            token.getColumn());
+    }
+    if (line.opaque) {
+        // Depends on other lines or files: left to the full parse
+        return line;
+    }
+
+    Parser parser(tokens, true, _vm);
+    for (const auto& command : parser.parseStatements()) {
+        Effect effect{command->getOpcode(), eOperandType::Int8};
+        switch (effect.opcode) {
+            case eOpcode::Push:
+                effect.type = static_cast<const PushCommand&>(*command).getOperand()->getType();
+                break;
+            case eOpcode::PushSlot:
+                effect.type = static_cast<const PushSlotCommand&>(*command).getType();
+                break;
+            case eOpcode::Read:
+                effect.type = static_cast<const ReadCommand&>(*command).getType();
+                break;
+            case eOpcode::Assert:
+                effect.type = static_cast<const AssertCommand&>(*command).getExpected()->getType();
+                break;
+            default:
+                break;
+        }
+        line.effects.push_back(effect);
+    }
+    for (const std::string& error : parser.getErrors()) {
+        line.syntax += (line.syntax.empty() ? "" : "\n") + withoutLine(error);
+    }
+    return line;
+}
+
+DocumentAnalysis::Stack DocumentAnalysis::apply(const Line& line, Stack stack, std::string& error) {
+    error.clear();
+    if (!line.macro.empty()) {
+        return Stack{0, eState::Macro};
+    }
+    if (stack.state == eState::Macro) {
+        return line.endmacro ? Stack{0, eState::Unknown} : stack;
+    }
+    if (stack.state != eState::Known) {
+        return stack;
+    }
+    if (!line.call.empty() && _macros.count(line.call)) {
+        return Stack{0, eState::Unknown};
+    }
+
+    auto push = [&](eOperandType type) {
+        _nodes.push_back(Node{stack.top, _nodes[stack.top].depth + 1, type});
+        stack.top = static_cast<uint32_t>(_nodes.size() - 1);
+    };
+
+    // Messages are those of the engines
+    for (const Effect& effect : line.effects) {
+        const Node& top = _nodes[stack.top];
+
+        switch (effect.opcode) {
+            case eOpcode::Push:
+            case eOpcode::PushSlot:
+            case eOpcode::Read:
+                push(effect.type);
+                break;
+            case eOpcode::Pop:
+                if (top.depth == 0) {
+                    error = "Pop on empty stack";
+                    break;
+                }
+                stack.top = top.below;
+                break;
+            case eOpcode::Assert:
+                if (top.depth == 0) {
+                    error = "Assert on empty stack";
+                } else if (top.type != effect.type) {
+                    error = "Assert failed: type mismatch. Expected " +
+                            std::string(operandTypeToString(effect.type)) + " but got " +
+                            operandTypeToString(top.type);
+                }
+                break;
+            case eOpcode::Print:
+                if (top.depth == 0) {
+                    error = "Print on empty stack";
+                } else if (top.type != eOperandType::Int8) {
+                    error = "Print requires int8 value on top of stack, but got " +
+                            std::string(operandTypeToString(top.type));
+                }
+                break;
+            case eOpcode::Add:
+            case eOpcode::Sub:
+            case eOpcode::Mul:
+            case eOpcode::Div:
+            case eOpcode::Mod: {
+                if (top.depth < 2) {
+                    std::string name = opcodeToString(effect.opcode);
+                    name[0] = static_cast<char>(std::toupper(name[0]));
+                    error = name + " requires at least 2 values on stack";
+                    break;
+                }
+                const Node& lhs = _nodes[top.below];
+                eOperandType type = resultType(lhs.type, top.type);
+                stack.top = lhs.below;
+                push(type);
+                break;
+            }
+            case eOpcode::Dump:
+            case eOpcode::DumpDelta:
+            case eOpcode::Savepoint:
+            case eOpcode::Commit:
+                break;
+            case eOpcode::Exit:
+                return Stack{stack.top, eState::Exited};
+            default:
+                return Stack{0, eState::Unknown};
+        }
+        if (!error.empty()) {
+            // Execution stops at the error
+            return Stack{stack.top, eState::Exited};
+        }
+    }
+    return line.opaque ? Stack{0, eState::Unknown} : stack;
+}
+
+bool DocumentAnalysis::equal(Stack lhs, Stack rhs) const {
+    if (lhs.state != rhs.state) {
+        return false;
+    }
+    if (lhs.state != eState::Known) {
+        return true;
+    }
+
+    uint32_t left = lhs.top;
+    uint32_t right = rhs.top;
+    if (_nodes[left].depth != _nodes[right].depth) {
+        return false;
+    }
+    // Stacks built from the same prefix share their bottom nodes
+    while (left != right) {
+        if (_nodes[left].type != _nodes[right].type) {
+            return false;
+        }
+        left = _nodes[left].below;
+        right = _nodes[right].below;
+    }
+    return true;
+}
+
+void DocumentAnalysis::propagate(size_t first, size_t last) {
+    _analysed = 0;
+    for (size_t index = first; index < _lines.size(); ++index) {
+        Stack after = apply(_lines[index], _stacks[index], _lines[index].stack);
+        updateErrors(index);
+        ++_analysed;
+
+        if (index + 1 >= last && equal(after, _stacks[index + 1])) {
+            break; // the following lines see the same stacks as before
+        }
+        _stacks[index + 1] = after;
+    }
+}
+
+bool DocumentAnalysis::countMacros(const Line& line, int count) {
+    if (line.macro.empty()) {
+        return false;
+    }
+    size_t& definitions = _macros[line.macro];
+    definitions += static_cast<size_t>(count);
+    if (definitions == 0) {
+        _macros.erase(line.macro);
+        return true;
+    }
+    return definitions == 1 && count > 0;
+}
+
+bool DocumentAnalysis::reportsSyntax(size_t index) const {
+    const Line& line = _lines[index];
+
+    return !line.syntax.empty() && _stacks[index].state != eState::Macro &&
+           (line.call.empty() || !_macros.count(line.call));
+}
+
+void DocumentAnalysis::updateErrors(size_t index) {
+    if (!reportsSyntax(index) && _lines[index].stack.empty()) {
+        _errors.erase(index);
+    } else {
+        _errors.insert(index);
+    }
+}
+
+std::vector<DocumentAnalysis::Diagnostic> DocumentAnalysis::getDiagnostics() const {
+    std::vector<Diagnostic> diagnostics;
+
+    for (size_t index : _errors) {
+        const Line& line = _lines[index];
+        std::istringstream syntax(reportsSyntax(index) ? line.syntax : "");
+        std::string message;
+        while (std::getline(syntax, message)) {
+            diagnostics.push_back(Diagnostic{index, message});
+        }
+        if (!line.stack.empty()) {
+            diagnostics.push_back(Diagnostic{index, line.stack});
+        }
+    }
+    if (_exits == 0) {
+        diagnostics.push_back(Diagnostic{_lines.size() - 1, "Program must end with 'exit' instruction"});
+    }
+    return diagnostics;
+}
+
+std::string DocumentAnalysis::describe(size_t line) const {
+    std::string number = std::to_string(line + 1);
+
+    if (line >= _lines.size()) {
+        return "";
+    }
+    if (_stacks[line].state == eState::Exited) {
+        return "Line " + number + " is not reached: the program stops before it";
+    }
+    Stack after = _stacks[line + 1];
+    if (after.state == eState::Macro) {
+        return "Line " + number + " is part of a macro definition";
+    }
+    if (after.state == eState::Exited) {
+        return "The program stops at line " + number;
+    }
+    if (after.state == eState::Unknown) {
+        return "Stack not tracked after line " + number +
+               " (blocks, join, channels, named stacks, rollback, includes and macro uses)";
+    }
+
+    uint32_t node = after.top;
+    std::string text = "Stack after line " + number + ": " + std::to_string(_nodes[node].depth) +
+                       (_nodes[node].depth == 1 ? " value" : " values");
+    for (size_t shown = 0; node != 0; node = _nodes[node].below, ++shown) {
+        if (shown == 16) {
+            text += ", ...";
+            break;
+        }
+        text += (shown == 0 ? "\n\ntop: " : ", ") + std::string(operandTypeToString(_nodes[node].type));
+    }
+    return text;
+}
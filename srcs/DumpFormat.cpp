@@ -0,0 +1,250 @@
+#include "DumpFormat.hpp"
+#include "AbstractVMException.hpp"
+#include <algorithm>
+#include <bit>
+#include <cctype>
+#include <cstring>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+namespace {
+    /**
+     * @brief Appends the native representation of a value to a buffer.
+     * @param buffer The buffer
+     * @param value The value
+     */
+    template <typename T>
+    void appendNative(std::string& buffer, T value) {
+        char bytes[sizeof(T)];
+        std::memcpy(bytes, &value, sizeof(T));
+        buffer.append(bytes, sizeof(T));
+    }
+
+    /**
+     * @brief Reads the native representation of a value.
+     * @param data The encoded value
+     * @return long double The value
+     */
+    template <typename T>
+    long double readNative(const char* data) {
+        T value;
+        std::memcpy(&value, data, sizeof(T));
+        return static_cast<long double>(value);
+    }
+
+    /**
+     * @brief Size of the binary dump header.
+     */
+    constexpr size_t headerSize = 16;
+
+    /**
+     * @brief Appends a binary header: magic, version, byte order and a number.
+     * @param buffer The buffer
+     * @param magic The 4-character magic
+     * @param number Number of values of a dump, or position of a delta marker
+     */
+    void appendHeader(std::string& buffer, const char* magic, uint64_t number) {
+        const uint8_t order = (std::endian::native == std::endian::little) ? 1 : 2;
+
+        buffer.append(magic, 4);
+        buffer.push_back(1); // version
+        buffer.push_back(static_cast<char>(order));
+        buffer.append(2, '\0');
+        appendNative(buffer, number);
+    }
+
+    /**
+     * @brief Values of a dump, oldest first.
+     */
+    using Values = OperandBuffer::const_iterator;
+
+    /**
+     * @brief Formats values as text, one per line.
+     * @param begin First value
+     * @param end One past the last value
+     * @param format Text, Jsonl or Csv
+     * @param buffer Receives the text (previous content is discarded)
+     */
+    void formatText(Values begin, Values end, eDumpFormat format, std::string& buffer) {
+        char entry[maxEntrySize];
+
+        buffer.clear();
+        for (Values value = begin; value != end; ++value) {
+            const std::string& text = (*value)->toString();
+            buffer.append(entry, formatEntry(entry, format, (*value)->getType(), text.data(),
+                                             text.size()));
+        }
+    }
+}
+
+bool parseDumpFormat(const std::string& name, eDumpFormat& format) {
+    if (name == "text") {
+        format = eDumpFormat::Text;
+    } else if (name == "binary") {
+        format = eDumpFormat::Binary;
+    } else if (name == "jsonl") {
+        format = eDumpFormat::Jsonl;
+    } else if (name == "csv") {
+        format = eDumpFormat::Csv;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+size_t formatEntry(char* buffer, eDumpFormat format, eOperandType type, const char* text,
+                   size_t length) {
+    // Everything before the value, by format and type
+    static const std::string_view jsonl[] = {
+        "{\"type\":\"int8\",\"value\":", "{\"type\":\"int16\",\"value\":",
+        "{\"type\":\"int32\",\"value\":", "{\"type\":\"float\",\"value\":",
+        "{\"type\":\"double\",\"value\":"};
+    static const std::string_view csv[] = {"int8,", "int16,", "int32,", "float,", "double,"};
+    std::string_view prefix;
+    char* next = buffer;
+
+    if (format == eDumpFormat::Jsonl) {
+        prefix = jsonl[static_cast<int>(type)];
+    } else if (format == eDumpFormat::Csv) {
+        prefix = csv[static_cast<int>(type)];
+    }
+    if (!prefix.empty()) {
+        std::memcpy(next, prefix.data(), prefix.size());
+        next += prefix.size();
+    }
+
+    // nan and inf are not JSON numbers: JSON Lines quotes them
+    size_t digit = (length > 0 && text[0] == '-') ? 1 : 0;
+    bool quoted = format == eDumpFormat::Jsonl &&
+                  (digit >= length || !std::isdigit(static_cast<unsigned char>(text[digit])));
+    if (quoted) {
+        *next++ = '"';
+    }
+    std::memcpy(next, text, length);
+    next += length;
+    if (quoted) {
+        *next++ = '"';
+    }
+    if (format == eDumpFormat::Jsonl) {
+        *next++ = '}';
+    }
+    *next++ = '\n';
+    return static_cast<size_t>(next - buffer);
+}
+
+void writeTextDump(std::ostream& output, Values begin, Values end, size_t threads,
+                   eDumpFormat format) {
+    size_t count = static_cast<size_t>(end - begin);
+    size_t chunks = (count + textChunkSize - 1) / textChunkSize;
+    std::vector<std::string> buffers(std::max<size_t>(1, std::min(threads, chunks)));
+
+    // Each round formats one chunk per buffer, then writes them in order
+    for (size_t round = 0; round < chunks; round += buffers.size()) {
+        size_t used = std::min(buffers.size(), chunks - round);
+        std::vector<std::thread> workers;
+
+        auto formatChunk = [&](size_t index) {
+            size_t first = (round + index) * textChunkSize;
+            size_t last = std::min(count, first + textChunkSize);
+            formatText(begin + static_cast<std::ptrdiff_t>(first),
+                       begin + static_cast<std::ptrdiff_t>(last), format, buffers[index]);
+        };
+
+        for (size_t index = 1; index < used; ++index) {
+            workers.emplace_back(formatChunk, index);
+        }
+        formatChunk(0); // the calling thread formats the first chunk
+        for (std::thread& worker : workers) {
+            worker.join();
+        }
+        for (size_t index = 0; index < used; ++index) {
+            output.write(buffers[index].data(), static_cast<std::streamsize>(buffers[index].size()));
+        }
+    }
+    output.flush();
+}
+
+size_t nativeSize(eOperandType type) {
+    switch (type) {
+        case eOperandType::Int8:   return sizeof(int8_t);
+        case eOperandType::Int16:  return sizeof(int16_t);
+        case eOperandType::Int32:  return sizeof(int32_t);
+        case eOperandType::Float:  return sizeof(float);
+        case eOperandType::Double: return sizeof(double);
+    }
+    return 0;
+}
+
+void appendBinaryHeader(std::string& buffer, uint64_t count) {
+    appendHeader(buffer, "AVMD", count);
+}
+
+void appendDeltaMarker(std::string& buffer, eDumpFormat format, uint64_t first) {
+    switch (format) {
+        case eDumpFormat::Text:
+            buffer += '@' + std::to_string(first) + '\n';
+            break;
+        case eDumpFormat::Jsonl:
+            buffer += "{\"offset\":" + std::to_string(first) + "}\n";
+            break;
+        case eDumpFormat::Csv:
+            buffer += "offset," + std::to_string(first) + '\n';
+            break;
+        case eDumpFormat::Binary:
+            appendHeader(buffer, "AVMO", first);
+            break;
+    }
+}
+
+void appendBinaryValue(std::string& buffer, eOperandType type, long double value) {
+    buffer.push_back(static_cast<char>(type));
+    switch (type) {
+        case eOperandType::Int8:   appendNative(buffer, static_cast<int8_t>(value)); break;
+        case eOperandType::Int16:  appendNative(buffer, static_cast<int16_t>(value)); break;
+        case eOperandType::Int32:  appendNative(buffer, static_cast<int32_t>(value)); break;
+        case eOperandType::Float:  appendNative(buffer, static_cast<float>(value)); break;
+        case eOperandType::Double: appendNative(buffer, static_cast<double>(value)); break;
+    }
+}
+
+size_t readBinaryValue(const char* data, eOperandType& type, long double& value) {
+    auto byte = static_cast<unsigned char>(data[0]);
+
+    if (byte > static_cast<unsigned char>(eOperandType::Double)) {
+        throw OutputException("Corrupt dump snapshot: unknown type byte " + std::to_string(byte));
+    }
+    type = static_cast<eOperandType>(byte);
+    switch (type) {
+        case eOperandType::Int8:   value = readNative<int8_t>(data + 1); break;
+        case eOperandType::Int16:  value = readNative<int16_t>(data + 1); break;
+        case eOperandType::Int32:  value = readNative<int32_t>(data + 1); break;
+        case eOperandType::Float:  value = readNative<float>(data + 1); break;
+        case eOperandType::Double: value = readNative<double>(data + 1); break;
+    }
+    return 1 + nativeSize(type);
+}
+
+BinaryDumpWriter::BinaryDumpWriter(std::ostream& output, uint64_t count)
+    : _output(output) {
+    // Small dumps are encoded in one go, large ones in bufferSize pieces
+    _buffer.reserve(std::min<uint64_t>(headerSize + count * maxBinaryValueSize, bufferSize));
+    appendBinaryHeader(_buffer, count);
+}
+
+void BinaryDumpWriter::write(eOperandType type, long double value) {
+    if (_buffer.size() + maxBinaryValueSize > bufferSize) {
+        flushBuffer();
+    }
+    appendBinaryValue(_buffer, type, value);
+}
+
+void BinaryDumpWriter::finish() {
+    flushBuffer();
+    _output.flush();
+}
+
+void BinaryDumpWriter::flushBuffer() {
+    _output.write(_buffer.data(), static_cast<std::streamsize>(_buffer.size()));
+    _buffer.clear();
+}
@@ -0,0 +1,149 @@
+#include "DumpQueue.hpp"
+#include "Arithmetic.hpp"
+
+DumpQueue::DumpQueue(std::ostream& output, size_t memoryLimit)
+    : _output(output), _memoryLimit(memoryLimit), _pending(0), _busy(false), _stopping(false),
+      _writer(&DumpQueue::run, this) {}
+
+DumpQueue::~DumpQueue() {
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _stopping = true;
+    }
+    _queued.notify_one();
+    _writer.join(); // the writer empties the queue first
+    _output.flush();
+}
+
+size_t DumpQueue::getMemoryLimit() const {
+    return _memoryLimit;
+}
+
+void DumpQueue::dump(Values begin, Values end, eDumpFormat format) {
+    uint64_t count = static_cast<uint64_t>(end - begin);
+    size_t size = count * maxBinaryValueSize;
+    std::unique_lock<std::mutex> lock(_mutex);
+
+    _written.wait(lock, [&]() { return _pending == 0 || _pending + size <= _memoryLimit; });
+    raiseError();
+    _pending += size;
+    lock.unlock();
+
+    // The snapshot is taken outside the lock, while the writer works
+    Job job{true, format, count, std::string()};
+    job.data.reserve(size);
+    for (Values value = begin; value != end; ++value) {
+        appendBinaryValue(job.data, (*value)->getType(), (*value)->getValue());
+    }
+
+    lock.lock();
+    _jobs.push_back(std::move(job));
+    lock.unlock();
+    _queued.notify_one();
+}
+
+void DumpQueue::write(const char* text, size_t length) {
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    raiseError();
+    if (_jobs.empty() && !_busy) {
+        // Nothing is pending: no need to go through the writer
+        _output.write(text, static_cast<std::streamsize>(length));
+    } else if (!_jobs.empty() && !_jobs.back().values) {
+        _jobs.back().data.append(text, length);
+    } else {
+        _jobs.push_back(Job{false, eDumpFormat::Text, 0, std::string(text, length)});
+        _queued.notify_one();
+    }
+}
+
+void DumpQueue::finish() {
+    std::unique_lock<std::mutex> lock(_mutex);
+
+    _written.wait(lock, [this]() { return _jobs.empty() && !_busy; });
+    _output.flush();
+    raiseError();
+}
+
+void DumpQueue::raiseError() {
+    if (_error) {
+        std::exception_ptr error = _error;
+        _error = nullptr;
+        std::rethrow_exception(error);
+    }
+}
+
+void DumpQueue::run() {
+    std::unique_lock<std::mutex> lock(_mutex);
+
+    while (true) {
+        _queued.wait(lock, [this]() { return _stopping || !_jobs.empty(); });
+        if (_jobs.empty()) {
+            return; // stopping
+        }
+        Job job = std::move(_jobs.front());
+        _jobs.pop_front();
+        _busy = true;
+        lock.unlock();
+
+        std::exception_ptr error;
+        try {
+            writeJob(job);
+        } catch (...) {
+            error = std::current_exception();
+        }
+
+        lock.lock();
+        if (error) {
+            // Later output would follow a truncated dump: drop it
+            for (const Job& dropped : _jobs) {
+                if (dropped.values) {
+                    _pending -= dropped.count * maxBinaryValueSize;
+                }
+            }
+            _jobs.clear();
+            _error = error;
+        }
+        _busy = false;
+        if (job.values) {
+            _pending -= job.count * maxBinaryValueSize;
+        }
+        _written.notify_all();
+    }
+}
+
+void DumpQueue::writeJob(const Job& job) {
+    if (!job.values) {
+        _output.write(job.data.data(), static_cast<std::streamsize>(job.data.size()));
+        return;
+    }
+
+    std::string buffer;
+    if (job.format == eDumpFormat::Binary) {
+        appendBinaryHeader(buffer, job.count);
+        _output.write(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+        _output.write(job.data.data(), static_cast<std::streamsize>(job.data.size()));
+        _output.flush();
+        return;
+    }
+
+    const char* data = job.data.data();
+    const char* end = data + job.data.size();
+    char text[maxEntrySize];
+    char entry[maxEntrySize];
+
+    buffer.reserve(BinaryDumpWriter::bufferSize);
+    while (data < end) {
+        eOperandType type;
+        long double value;
+        data += readBinaryValue(data, type, value);
+        size_t length = formatValue(text, sizeof(text), type, value);
+        buffer.append(entry, formatEntry(entry, job.format, type, text, length));
+        if (buffer.size() >= BinaryDumpWriter::bufferSize - maxEntrySize) {
+            _output.write(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+            buffer.clear();
+        }
+    }
+    _output.write(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+    _output.flush();
+}
@@ -0,0 +1,437 @@
+#include "LanguageServer.hpp"
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <stdexcept>
+
+/**
+ * @struct LanguageServer::Json
+ * @brief Minimal JSON value, enough for the messages of the protocol.
+ */
+struct LanguageServer::Json {
+    enum class Kind { Null, Boolean, Number, String, Array, Object };
+
+    Kind kind = Kind::Null;         ///< Type of the value
+    bool boolean = false;           ///< Value of a boolean
+    double number = 0;              ///< Value of a number
+    std::string string;             ///< Value of a string
+    std::vector<std::string> keys;  ///< Member names of an object
+    std::vector<Json> values;       ///< Elements of an array, or member values of an object
+
+    /**
+     * @brief Gets a member of an object.
+     * @param key Member name
+     * @return const Json& The member, or null if there is none
+     */
+    const Json& operator[](const std::string& key) const {
+        static const Json none;
+
+        for (size_t index = 0; index < keys.size(); ++index) {
+            if (keys[index] == key) {
+                return values[index];
+            }
+        }
+        return none;
+    }
+
+    /**
+     * @brief Writes a scalar back as JSON (request ids).
+     * @return std::string The JSON text
+     */
+    std::string write() const;
+
+    /**
+     * @brief Parses a JSON value.
+     * @param text The JSON text
+     * @param position Position of the value, moved past it
+     * @return Json The value
+     * @throws std::runtime_error if the text is not valid JSON
+     */
+    static Json parse(const std::string& text, size_t& position);
+};
+
+namespace {
+    /**
+     * @brief Quotes a string for JSON.
+     * @param text The string
+     * @return std::string The JSON string, with its quotes
+     */
+    std::string quote(const std::string& text) {
+        std::string quoted = "\"";
+
+        for (char c : text) {
+            switch (c) {
+                case '"':  quoted += "\\\""; break;
+                case '\\': quoted += "\\\\"; break;
+                case '\n': quoted += "\\n"; break;
+                case '\r': quoted += "\\r"; break;
+                case '\t': quoted += "\\t"; break;
+                default:
+                    if (static_cast<unsigned char>(c) < 0x20) {
+                        char escape[8];
+                        std::snprintf(escape, sizeof(escape), "\\u%04x", c);
+                        quoted += escape;
+                    } else {
+                        quoted += c;
+                    }
+            }
+        }
+        return quoted + "\"";
+    }
+
+    /**
+     * @brief Appends a code point in UTF-8.
+     * @param text The string
+     * @param code The code point
+     */
+    void appendUtf8(std::string& text, unsigned long code) {
+        if (code < 0x80) {
+            text += static_cast<char>(code);
+        } else if (code < 0x800) {
+            text += static_cast<char>(0xC0 | (code >> 6));
+            text += static_cast<char>(0x80 | (code & 0x3F));
+        } else if (code < 0x10000) {
+            text += static_cast<char>(0xE0 | (code >> 12));
+            text += static_cast<char>(0x80 | ((code >> 6) & 0x3F));
+            text += static_cast<char>(0x80 | (code & 0x3F));
+        } else {
+            text += static_cast<char>(0xF0 | (code >> 18));
+            text += static_cast<char>(0x80 | ((code >> 12) & 0x3F));
+            text += static_cast<char>(0x80 | ((code >> 6) & 0x3F));
+            text += static_cast<char>(0x80 | (code & 0x3F));
+        }
+    }
+
+    /**
+     * @brief Splits a text into lines.
+     * @param text The text
+     * @return std::vector<std::string> The lines, without newline (at least one)
+     */
+    std::vector<std::string> splitLines(const std::string& text) {
+        std::vector<std::string> lines;
+        size_t begin = 0;
+
+        for (size_t end; (end = text.find('\n', begin)) != std::string::npos; begin = end + 1) {
+            lines.push_back(text.substr(begin, end - begin));
+        }
+        lines.push_back(text.substr(begin));
+        return lines;
+    }
+
+    /**
+     * @brief Reads a position of the protocol.
+     * @param value Number from a position object
+     * @return size_t The number, 0 if missing or negative
+     */
+    size_t toIndex(double value) {
+        return value > 0 ? static_cast<size_t>(value) : 0;
+    }
+
+    /**
+     * @brief Builds a response to a request.
+     * @param id The id of the request, as JSON
+     * @param result The result, as JSON
+     * @return std::string The message
+     */
+    std::string response(const std::string& id, const std::string& result) {
+        return "{\"jsonrpc\":\"2.0\",\"id\":" + id + ",\"result\":" + result + "}";
+    }
+
+    /**
+     * @brief Builds an error response to a request.
+     * @param id The id of the request, as JSON
+     * @param code JSON-RPC error code
+     * @param message Error message
+     * @return std::string The message
+     */
+    std::string errorResponse(const std::string& id, int code, const std::string& message) {
+        return "{\"jsonrpc\":\"2.0\",\"id\":" + id + ",\"error\":{\"code\":" + std::to_string(code) +
+               ",\"message\":" + quote(message) + "}}";
+    }
+}
+
+std::string LanguageServer::Json::write() const {
+    switch (kind) {
+        case Kind::Boolean:
+            return boolean ? "true" : "false";
+        case Kind::Number: {
+            char buffer[32];
+            std::snprintf(buffer, sizeof(buffer), "%.17g", number);
+            return buffer;
+        }
+        case Kind::String:
+            return quote(string);
+        default:
+            return "null";
+    }
+}
+
+LanguageServer::Json LanguageServer::Json::parse(const std::string& text, size_t& position) {
+    auto skip = [&]() {
+        while (position < text.size() && std::isspace(static_cast<unsigned char>(text[position]))) {
+            ++position;
+        }
+    };
+    auto expect = [&](char c) {
+        skip();
+        if (position >= text.size() || text[position] != c) {
+            throw std::runtime_error(std::string("Expected '") + c + "' in JSON");
+        }
+        ++position;
+    };
+    auto literal = [&](const char* word) {
+        std::string expected(word);
+        if (text.compare(position, expected.size(), expected) != 0) {
+            throw std::runtime_error("Invalid JSON value");
+        }
+        position += expected.size();
+    };
+
+    Json value;
+    skip();
+    if (position >= text.size()) {
+        throw std::runtime_error("Unexpected end of JSON");
+    }
+
+    char c = text[position];
+    if (c == '{' || c == '[') {
+        char close = (c == '{') ? '}' : ']';
+        value.kind = (c == '{') ? Kind::Object : Kind::Array;
+        ++position;
+        skip();
+        if (position < text.size() && text[position] == close) {
+            ++position;
+            return value;
+        }
+        for (;;) {
+            if (value.kind == Kind::Object) {
+                skip();
+                Json key = parse(text, position);
+                if (key.kind != Kind::String) {
+                    throw std::runtime_error("Expected member name in JSON");
+                }
+                value.keys.push_back(std::move(key.string));
+                expect(':');
+            }
+            value.values.push_back(parse(text, position));
+            skip();
+            if (position < text.size() && text[position] == ',') {
+                ++position;
+                continue;
+            }
+            expect(close);
+            return value;
+        }
+    }
+    if (c == '"') {
+        value.kind = Kind::String;
+        for (++position; position < text.size() && text[position] != '"'; ++position) {
+            if (text[position] != '\\') {
+                value.string += text[position];
+                continue;
+            }
+            if (++position >= text.size()) {
+                break;
+            }
+            switch (text[position]) {
+                case 'b': value.string += '\b'; break;
+                case 'f': value.string += '\f'; break;
+                case 'n': value.string += '\n'; break;
+                case 'r': value.string += '\r'; break;
+                case 't': value.string += '\t'; break;
+                case 'u': {
+                    unsigned long code = std::stoul(text.substr(position + 1, 4), nullptr, 16);
+                    position += 4;
+                    // Surrogate pair
+                    if (code >= 0xD800 && code < 0xDC00 && text.compare(position + 1, 2, "\\u") == 0) {
+                        unsigned long low = std::stoul(text.substr(position + 3, 4), nullptr, 16);
+                        code = 0x10000 + ((code - 0xD800) << 10) + (low - 0xDC00);
+                        position += 6;
+                    }
+                    appendUtf8(value.string, code);
+                    break;
+                }
+                default: value.string += text[position]; break;
+            }
+        }
+        expect('"');
+        return value;
+    }
+    if (c == 't' || c == 'f') {
+        literal(c == 't' ? "true" : "false");
+        value.kind = Kind::Boolean;
+        value.boolean = (c == 't');
+        return value;
+    }
+    if (c == 'n') {
+        literal("null");
+        return value;
+    }
+
+    size_t length = 0;
+    value.kind = Kind::Number;
+    value.number = std::stod(text.substr(position, 32), &length);
+    position += length;
+    return value;
+}
+
+LanguageServer::LanguageServer(std::istream& input, std::ostream& output)
+    : _input(input), _output(output), _shutdown(false) {}
+
+int LanguageServer::run() {
+    std::string content;
+
+    while (receive(content)) {
+        Json message;
+        try {
+            size_t position = 0;
+            message = Json::parse(content, position);
+        } catch (const std::exception& e) {
+            send(errorResponse("null", -32700, e.what()));
+            continue;
+        }
+        if (!handle(message)) {
+            return _shutdown ? 0 : 1;
+        }
+    }
+    return 1;
+}
+
+bool LanguageServer::receive(std::string& content) {
+    std::string line;
+    size_t length = 0;
+    bool framed = false;
+
+    // Headers, up to an empty line
+    while (std::getline(_input, line)) {
+        if (!line.empty() && line.back() == '\r') {
+            line.pop_back();
+        }
+        if (line.empty()) {
+            if (framed) {
+                break;
+            }
+            continue;
+        }
+        if (line.compare(0, 15, "Content-Length:") == 0) {
+            length = std::stoul(line.substr(15));
+            framed = true;
+        }
+    }
+    if (!framed || !_input) {
+        return false;
+    }
+
+    content.resize(length);
+    _input.read(content.data(), static_cast<std::streamsize>(length));
+    return static_cast<size_t>(_input.gcount()) == length;
+}
+
+void LanguageServer::send(const std::string& content) {
+    _output << "Content-Length: " << content.size() << "\r\n\r\n" << content;
+    _output.flush();
+}
+
+bool LanguageServer::handle(const Json& message) {
+    const std::string& method = message["method"].string;
+    const Json& params = message["params"];
+    const Json& textDocument = params["textDocument"];
+    bool request = message["id"].kind != Json::Kind::Null;
+    std::string id = message["id"].write();
+
+    if (method == "exit") {
+        return false;
+    }
+    if (_shutdown) {
+        if (request) {
+            send(errorResponse(id, -32600, "Server is shut down"));
+        }
+        return true;
+    }
+
+    if (method == "initialize") {
+        send(response(id, "{\"capabilities\":{\"textDocumentSync\":{\"openClose\":true,\"change\":2},"
+                          "\"hoverProvider\":true},\"serverInfo\":{\"name\":\"avm\"}}"));
+    } else if (method == "shutdown") {
+        _shutdown = true;
+        send(response(id, "null"));
+    } else if (method == "textDocument/didOpen") {
+        Document& document = _documents[textDocument["uri"].string];
+
+        document.lines = splitLines(textDocument["text"].string);
+        document.analysis.setText(textDocument["text"].string);
+        publish(textDocument["uri"].string, &document);
+    } else if (method == "textDocument/didChange") {
+        auto found = _documents.find(textDocument["uri"].string);
+        if (found != _documents.end()) {
+            for (const Json& contentChange : params["contentChanges"].values) {
+                change(found->second, contentChange);
+            }
+            publish(found->first, &found->second);
+        }
+    } else if (method == "textDocument/didClose") {
+        _documents.erase(textDocument["uri"].string);
+        publish(textDocument["uri"].string, nullptr);
+    } else if (method == "textDocument/hover") {
+        auto found = _documents.find(textDocument["uri"].string);
+        size_t line = toIndex(params["position"]["line"].number);
+        if (found == _documents.end() || line >= found->second.lines.size()) {
+            send(response(id, "null"));
+        } else {
+            send(response(id, "{\"contents\":{\"kind\":\"markdown\",\"value\":" +
+                              quote(found->second.analysis.describe(line)) + "}}"));
+        }
+    } else if (request) {
+        send(errorResponse(id, -32601, "Method not found: " + method));
+    }
+    return true;
+}
+
+void LanguageServer::change(Document& document, const Json& change) {
+    const Json& range = change["range"];
+    const std::string& text = change["text"].string;
+    std::vector<std::string>& lines = document.lines;
+
+    if (range.kind == Json::Kind::Null) {
+        // Whole document
+        lines = splitLines(text);
+        document.analysis.setText(text);
+        return;
+    }
+
+    // The range is replaced within its first and last lines
+    size_t first = std::min(toIndex(range["start"]["line"].number), lines.size() - 1);
+    size_t last = std::min(toIndex(range["end"]["line"].number), lines.size() - 1);
+    if (last < first) {
+        last = first;
+    }
+    size_t begin = std::min(toIndex(range["start"]["character"].number), lines[first].size());
+    size_t end = std::min(toIndex(range["end"]["character"].number), lines[last].size());
+    if (first == last && end < begin) {
+        end = begin;
+    }
+
+    std::vector<std::string> replaced = splitLines(lines[first].substr(0, begin) + text +
+                                                   lines[last].substr(end));
+    lines.erase(lines.begin() + static_cast<std::ptrdiff_t>(first),
+                lines.begin() + static_cast<std::ptrdiff_t>(last + 1));
+    lines.insert(lines.begin() + static_cast<std::ptrdiff_t>(first), replaced.begin(), replaced.end());
+    document.analysis.replace(first, last + 1, replaced);
+}
+
+void LanguageServer::publish(const std::string& uri, const Document* document) {
+    std::string diagnostics;
+
+    if (document) {
+        for (const DocumentAnalysis::Diagnostic& diagnostic : document->analysis.getDiagnostics()) {
+            std::string line = std::to_string(diagnostic.line);
+            diagnostics += (diagnostics.empty() ? "" : ",");
+            diagnostics += "{\"range\":{\"start\":{\"line\":" + line + ",\"character\":0},"
+                           "\"end\":{\"line\":" + line + ",\"character\":" +
+                           std::to_string(document->lines[diagnostic.line].size()) + "}},"
+                           "\"severity\":1,\"source\":\"avm\",\"message\":" + quote(diagnostic.message) + "}";
+        }
+    }
+    send("{\"jsonrpc\":\"2.0\",\"method\":\"textDocument/publishDiagnostics\",\"params\":{\"uri\":" +
+         quote(uri) + ",\"diagnostics\":[" + diagnostics + "]}}");
+}
@@ -85,6 +85,68 @@ Token Lexer::readNumber() {
     return Token(type, value, _line, startColumn);
 }
 
+bool Lexer::isNumber(const std::string& text) {
+    size_t index = 0;
+    size_t digits = 0;
+
+    if (index < text.size() && (text[index] == '-' || text[index] == '+')) {
+        ++index;
+    }
+    while (index < text.size() && std::isdigit(static_cast<unsigned char>(text[index]))) {
+        ++index;
+        ++digits;
+    }
+    if (digits == 0) {
+        return false;
+    }
+    if (index < text.size() && text[index] == '.') {
+        ++index;
+        while (index < text.size() && std::isdigit(static_cast<unsigned char>(text[index]))) {
+            ++index;
+        }
+    }
+    return index == text.size();
+}
+
+Token Lexer::readPlaceholder() {
+    std::string name;
+    size_t startColumn = _column;
+
+    advance(); // consume '$'
+    while (isIdentifierChar(_currentChar) && !_endReached) {
+        name += _currentChar;
+        advance();
+    }
+
+    return Token(TokenType::PLACEHOLDER, name, _line, startColumn);
+}
+
+Token Lexer::readString() {
+    std::string text;
+    size_t startColumn = _column;
+    size_t line = _line;
+
+    advance(); // consume opening '"'
+    while (_currentChar != '"' && _currentChar != '\n' && !_endReached) {
+        text += _currentChar;
+        advance();
+    }
+
+    if (_currentChar != '"') {
+        std::string errorMsg = "Unterminated string at line " + std::to_string(line) +
+                               ", column " + std::to_string(startColumn);
+        if (!_collectErrors) {
+            throw LexicalException(errorMsg);
+        }
+        _errors.push_back(errorMsg);
+        skipToRecoverableState();
+        return Token(TokenType::UNKNOWN, "\"" + text, line, startColumn);
+    }
+
+    advance(); // consume closing '"'
+    return Token(TokenType::STRING, text, line, startColumn);
+}
+
 bool Lexer::isIdentifierStart(char c) const {
     return std::isalpha(c);
 }
@@ -105,12 +167,29 @@ TokenType Lexer::keywordToTokenType(const std::string& str) const {
     if (str == "mod") return TokenType::MOD;
     if (str == "print") return TokenType::PRINT;
     if (str == "exit") return TokenType::EXIT;
+    if (str == "read") return TokenType::READ;
+    if (str == "fork") return TokenType::FORK;
+    if (str == "endfork") return TokenType::ENDFORK;
+    if (str == "join") return TokenType::JOIN;
     if (str == "int8") return TokenType::INT8;
     if (str == "int16") return TokenType::INT16;
     if (str == "int32") return TokenType::INT32;
     if (str == "float") return TokenType::FLOAT;
     if (str == "double") return TokenType::DOUBLE;
-    return TokenType::UNKNOWN;
+    if (str == "send") return TokenType::SEND;
+    if (str == "recv") return TokenType::RECV;
+    if (str == "use") return TokenType::USE;
+    if (str == "move") return TokenType::MOVE;
+    if (str == "savepoint") return TokenType::SAVEPOINT;
+    if (str == "rollback") return TokenType::ROLLBACK;
+    if (str == "commit") return TokenType::COMMIT;
+    if (str == "onerror") return TokenType::ONERROR;
+    if (str == "endonerror") return TokenType::ENDONERROR;
+    if (str == "dumpdelta") return TokenType::DUMPDELTA;
+    if (str == "include") return TokenType::INCLUDE;
+    if (str == "macro") return TokenType::MACRO;
+    if (str == "endmacro") return TokenType::ENDMACRO;
+    return TokenType::IDENTIFIER;
 }
 
 std::vector<Token> Lexer::tokenize() {
@@ -180,6 +259,16 @@ Token Lexer::nextToken() {
         return readNumber();
     }
 
+    // Placeholders: '$' followed by a name or a position
+    if (_currentChar == '$' && isIdentifierChar(peek())) {
+        return readPlaceholder();
+    }
+
+    // Strings
+    if (_currentChar == '"') {
+        return readString();
+    }
+
     // Identifiers and keywords
     if (isIdentifierStart(_currentChar)) {
         return readIdentifier();
@@ -0,0 +1,40 @@
+#include "ModuleCache.hpp"
+#include "Lexer.hpp"
+#include <fstream>
+#include <stdexcept>
+
+ModuleCache& ModuleCache::instance() {
+    static ModuleCache cache;
+    return cache;
+}
+
+std::shared_ptr<const Module> ModuleCache::get(const std::filesystem::path& path) {
+    std::error_code error;
+    std::filesystem::path canonical = std::filesystem::canonical(path, error);
+    if (error) {
+        throw std::runtime_error("Unable to open file " + path.string());
+    }
+
+    std::filesystem::file_time_type modified = std::filesystem::last_write_time(canonical, error);
+    std::uintmax_t size = std::filesystem::file_size(canonical, error);
+    std::lock_guard<std::mutex> lock(_mutex);
+    std::shared_ptr<const Module>& module = _modules[canonical.string()];
+
+    if (module && module->modified == modified && module->size == size) {
+        return module;
+    }
+
+    std::ifstream file(canonical);
+    if (!file.is_open()) {
+        throw std::runtime_error("Unable to open file " + path.string());
+    }
+    // Lexical errors become UNKNOWN tokens, reported by the including parser
+    Lexer lexer(file, false, true);
+    module = std::make_shared<const Module>(Module{canonical.string(), lexer.tokenize(), modified, size});
+    return module;
+}
+
+void ModuleCache::clear() {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _modules.clear();
+}
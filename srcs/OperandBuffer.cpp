@@ -0,0 +1,491 @@
+#include "OperandBuffer.hpp"
+#include "AbstractVMException.hpp"
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <vector>
+
+namespace {
+    /**
+     * @struct Region
+     * @brief State of a region, read by the fault handler.
+     */
+    struct Region {
+        char* open;         ///< End of the accessible part
+        char* ready;        ///< End of the part the handler may open (see prepare())
+        bool overflowed;    ///< True if the spare area is open
+    };
+
+    /**
+     * @brief Number of regions reserved at once.
+     */
+    constexpr size_t batchSize = 16;
+
+    /**
+     * @brief Bits of the user address space, covered by the region table.
+     */
+    constexpr size_t addressBits = 47;
+
+    size_t regionBits = AVM_STACK_REGION_BITS;  ///< Log2 of the region size (fixed once installed)
+    size_t regionSize = size_t(1) << AVM_STACK_REGION_BITS; ///< Bytes reserved per region
+    size_t limitSize = 0;               ///< Bytes of values a region holds (0: as many as fit)
+    size_t tableSize;                   ///< Entries of the region tables
+
+    /**
+     * @brief Start of each region, indexed by start / regionSize.
+     *
+     * Regions are aligned on their size, so a faulting address gives its
+     * entry directly. The table covers the 47-bit address space of user
+     * processes; it is mapped when the handler is installed, and its pages
+     * are only touched where regions are.
+     */
+    uintptr_t* starts;
+
+    Region* regions;                    ///< State of each region, same index
+    std::mutex freeMutex;               ///< Guards the free regions
+    std::vector<char*>* freeRegions = new std::vector<char*>(); ///< Regions not used by a buffer (never destroyed)
+    std::once_flag installed;           ///< Set once the handler is installed
+    std::atomic<bool> configured(false); ///< Set when the handler is installed: the size is fixed
+    struct sigaction previousSegv;      ///< Handler of SIGSEGV before ours
+    struct sigaction previousBus;       ///< Handler of SIGBUS before ours
+    size_t pageSize;                    ///< Size of a memory page
+    bool strictCommit;                  ///< True if pages made writable are charged (no overcommit)
+
+    /**
+     * @brief Gets the index of a region in the tables.
+     * @param start The region start
+     * @return size_t The index
+     */
+    size_t indexOf(uintptr_t start) {
+        return (start >> regionBits) % tableSize;
+    }
+
+    /**
+     * @brief Rounds a size up to whole pages.
+     * @param size The size, in bytes
+     * @return size_t The rounded size
+     */
+    size_t pages(size_t size) {
+        return (size + pageSize - 1) & ~(pageSize - 1);
+    }
+
+    /**
+     * @brief Gets the end of the values a region can hold.
+     * @param region The region start
+     * @return char* Start of the spare area
+     */
+    char* limitOf(char* region) {
+        return region + limitSize;
+    }
+
+    /**
+     * @brief Computes the new end of the accessible part of a region.
+     * @param region The region start
+     * @param open Current end of the accessible part
+     * @param needed Address that must become accessible
+     * @return char* The new end: at least twice the accessible part, within the limit
+     */
+    char* grownEnd(char* region, char* open, char* needed) {
+        uintptr_t end = reinterpret_cast<uintptr_t>(std::max(needed, open + (open - region)));
+        end = (end + pageSize - 1) & ~(pageSize - 1);
+        return std::min(reinterpret_cast<char*>(end), limitOf(region));
+    }
+
+    /**
+     * @brief Charges pages of a region without opening them.
+     *
+     * Without overcommit, making pages writable can fail for lack of
+     * memory, which the handler could only report by ending the process.
+     * Pages made writable once stay charged when they are protected again,
+     * so the handler can open them later without failing.
+     *
+     * @param first First byte charged, on a page boundary
+     * @param last End of the bytes charged, on a page boundary
+     * @return bool False if the memory is not available
+     */
+    bool charge(char* first, char* last) {
+        if (!strictCommit || last <= first) {
+            return true;
+        }
+        size_t length = static_cast<size_t>(last - first);
+        return mprotect(first, length, PROT_READ | PROT_WRITE) == 0 && mprotect(first, length, PROT_NONE) == 0;
+    }
+
+    /**
+     * @brief Opens the pages of a region up to an address, and prepares room for the handler.
+     *
+     * Called outside the handler, where a failure can be raised. The room
+     * prepared past the accessible part (at least two spare areas, within
+     * the limit) is what the handler opens when pushes reach it; the
+     * handler asks for more (see OperandBuffer::faulted()) before it runs
+     * out.
+     *
+     * @param region The region start
+     * @param state The region state
+     * @param needed Address that must become accessible, within the limit
+     * @throws StackLimitException if the pages cannot be opened or charged
+     */
+    void prepare(char* region, Region& state, char* needed) {
+        if (needed > state.open) {
+            char* end = grownEnd(region, state.open, needed);
+            if (mprotect(state.open, static_cast<size_t>(end - state.open), PROT_READ | PROT_WRITE) != 0) {
+                throw StackLimitException("Cannot grow the stack: out of memory");
+            }
+            state.open = end;
+            state.ready = std::max(state.ready, end);
+        }
+
+        char* target = limitOf(region);
+        if (strictCommit) {
+            size_t room = std::max(static_cast<size_t>(state.open - region), 2 * OperandBuffer::spareSize);
+            target = std::min(target, state.open + pages(room));
+        }
+        if (target > state.ready) {
+            if (!charge(state.ready, target)) {
+                throw StackLimitException("Cannot grow the stack: out of memory");
+            }
+            state.ready = target;
+        }
+    }
+
+    /**
+     * @brief Reserves a batch of regions aligned on their size and adds them to the free ones.
+     * @throws StackLimitException if the address space is exhausted
+     */
+    void reserveBatch() {
+        int flags = MAP_PRIVATE | MAP_ANONYMOUS;
+#ifdef MAP_NORESERVE
+        flags |= MAP_NORESERVE;
+#endif
+        size_t length = (batchSize + 1) * regionSize;
+        void* mapping = mmap(nullptr, length, PROT_NONE, flags, -1, 0);
+        if (mapping == MAP_FAILED) {
+            throw StackLimitException("Cannot reserve a stack: out of address space");
+        }
+
+        // Keep the aligned part
+        char* first = static_cast<char*>(mapping);
+        uintptr_t start = (reinterpret_cast<uintptr_t>(first) + regionSize - 1) & ~(regionSize - 1);
+        char* batch = reinterpret_cast<char*>(start);
+        char* end = batch + batchSize * regionSize;
+        if (batch > first) {
+            munmap(first, static_cast<size_t>(batch - first));
+        }
+        munmap(end, static_cast<size_t>(first + length - end));
+
+        for (char* region = batch; region < end; region += regionSize) {
+            uintptr_t expected = 0;
+            uintptr_t address = reinterpret_cast<uintptr_t>(region);
+            if (!std::atomic_ref<uintptr_t>(starts[indexOf(address)]).compare_exchange_strong(expected, address)) {
+                munmap(region, regionSize); // beyond 47 bits: not tracked
+                continue;
+            }
+            regions[indexOf(address)] = Region{region, region, false};
+            freeRegions->push_back(region);
+        }
+        if (freeRegions->empty()) {
+            throw StackLimitException("Cannot reserve a stack: out of address space");
+        }
+    }
+
+    /**
+     * @brief Takes a free region, reserving more if there is none.
+     * @return char* The region start
+     * @throws StackLimitException if the address space is exhausted
+     */
+    char* acquire() {
+        std::lock_guard<std::mutex> lock(freeMutex);
+
+        if (freeRegions->empty()) {
+            reserveBatch();
+        }
+        char* region = freeRegions->back();
+        freeRegions->pop_back();
+        return region;
+    }
+
+    /**
+     * @brief Returns a region to the free ones, giving back its pages.
+     *
+     * The whole region is protected again, so that it merges with its free
+     * neighbours into one mapping: many idle regions, each split in an open
+     * and a protected part, would exhaust the mappings a process can have.
+     * The room prepared stays charged for the next buffer.
+     *
+     * @param region The region start
+     */
+    void release(char* region) {
+        Region& state = regions[indexOf(reinterpret_cast<uintptr_t>(region))];
+
+        if (state.open > region) {
+            size_t length = static_cast<size_t>(state.open - region);
+            madvise(region, length, MADV_DONTNEED);
+            mprotect(region, length, PROT_NONE);
+            state = Region{region, state.ready, false};
+        }
+
+        std::lock_guard<std::mutex> lock(freeMutex);
+        freeRegions->push_back(region);
+    }
+
+    /**
+     * @brief Checks whether the system charges the pages made writable.
+     * @return bool True unless overcommit is known to be enabled (Linux modes 0 and 1)
+     */
+    bool detectStrictCommit() {
+        std::ifstream mode("/proc/sys/vm/overcommit_memory");
+        int value = 2;
+
+        mode >> value;
+        return value == 2;
+    }
+}
+
+void OperandBuffer::install() {
+    struct sigaction action;
+
+    pageSize = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    strictCommit = detectStrictCommit();
+    if (limitSize == 0) {
+        limitSize = regionSize - spareSize - pageSize;
+    }
+
+    // The tables cover the address space: only the pages of used entries are touched
+    tableSize = (size_t(1) << addressBits) >> regionBits;
+    int flags = MAP_PRIVATE | MAP_ANONYMOUS;
+#ifdef MAP_NORESERVE
+    flags |= MAP_NORESERVE;
+#endif
+    void* tables = mmap(nullptr, tableSize * (sizeof(uintptr_t) + sizeof(Region)), PROT_READ | PROT_WRITE,
+                        flags, -1, 0);
+    if (tables == MAP_FAILED) {
+        throw StackLimitException("Cannot reserve a stack: out of address space");
+    }
+    starts = static_cast<uintptr_t*>(tables);
+    regions = reinterpret_cast<Region*>(starts + tableSize);
+    configured = true;
+
+    std::memset(&action, 0, sizeof(action));
+    action.sa_sigaction = handleFault;
+    action.sa_flags = SA_SIGINFO;
+    sigemptyset(&action.sa_mask);
+    sigaction(SIGSEGV, &action, &previousSegv);
+    sigaction(SIGBUS, &action, &previousBus); // PROT_NONE faults on some systems
+}
+
+void OperandBuffer::handleFault(int signal, siginfo_t* info, void* context) {
+    uintptr_t address = reinterpret_cast<uintptr_t>(info->si_addr);
+    uintptr_t start = address & ~(regionSize - 1);
+
+    // Only async-signal-safe calls from here
+    if (std::atomic_ref<uintptr_t>(starts[indexOf(start)]).load(std::memory_order_relaxed) == start) {
+        char* region = reinterpret_cast<char*>(start);
+        char* fault = reinterpret_cast<char*>(address);
+        char* limit = limitOf(region);
+        Region& state = regions[indexOf(start)];
+
+        if (fault >= state.open && fault < state.ready) {
+            // Prepared pages: opening them extends the open mapping, without charging memory
+            char* end = std::min(grownEnd(region, state.open, fault + 1), state.ready);
+            if (mprotect(state.open, static_cast<size_t>(end - state.open), PROT_READ | PROT_WRITE) == 0) {
+                state.open = end;
+                if (state.ready < limit && static_cast<size_t>(state.ready - end) < spareSize) {
+                    _fault = 1; // prepare more room after the instruction
+                }
+                return;
+            }
+        } else if (fault >= limit && fault < limit + spareSize && !state.overflowed) {
+            if (mprotect(limit, spareSize, PROT_READ | PROT_WRITE) == 0) {
+                state.open = limit + spareSize;
+                state.overflowed = true;
+                _fault = 1;
+                return;
+            }
+        }
+        // Past the room prepared: pushes in bulk reserve their room first
+        // (reserve()), so this is a stray access like any other
+    }
+
+    // Not a push: let the previous handler, or the default action, see it
+    struct sigaction& previous = (signal == SIGBUS) ? previousBus : previousSegv;
+    if ((previous.sa_flags & SA_SIGINFO) && previous.sa_sigaction) {
+        previous.sa_sigaction(signal, info, context);
+    } else if (previous.sa_handler != SIG_DFL && previous.sa_handler != SIG_IGN) {
+        previous.sa_handler(signal);
+    } else {
+        std::signal(signal, SIG_DFL); // the access faults again and ends the process
+    }
+}
+
+OperandBuffer::OperandBuffer()
+    : OperandBuffer(deferred) {
+    reserveRegion();
+}
+
+OperandBuffer::OperandBuffer(Deferred)
+    : _region(nullptr), _begin(nullptr), _end(nullptr) {}
+
+OperandBuffer::OperandBuffer(const OperandBuffer& other)
+    : OperandBuffer() {
+    insert(_end, other.begin(), other.end());
+}
+
+OperandBuffer::OperandBuffer(OperandBuffer&& other) noexcept
+    : _region(other._region), _begin(other._begin), _end(other._end) {
+    other._region = nullptr;
+    other._begin = other._end = nullptr;
+}
+
+OperandBuffer& OperandBuffer::operator=(OperandBuffer other) noexcept {
+    swap(other);
+    return *this;
+}
+
+OperandBuffer::~OperandBuffer() {
+    if (_region) {
+        release(_region);
+    }
+}
+
+void OperandBuffer::reserveRegion() {
+    if (_region) {
+        return;
+    }
+    std::call_once(installed, install);
+
+    char* region = acquire();
+    Region& state = regions[indexOf(reinterpret_cast<uintptr_t>(region))];
+    try {
+        if (state.ready == region && !charge(limitOf(region), limitOf(region) + spareSize)) {
+            throw StackLimitException("Cannot reserve a stack: out of memory");
+        }
+        // The first page splits the mapping of the region: open it here, where failing is an exception
+        prepare(region, state, region + pageSize);
+    } catch (...) {
+        release(region);
+        throw;
+    }
+    _region = region;
+    _begin = _end = reinterpret_cast<value_type*>(_region);
+}
+
+void OperandBuffer::releaseRegion() {
+    if (_region) {
+        release(_region);
+        _region = nullptr;
+        _begin = _end = nullptr;
+    }
+}
+
+void OperandBuffer::reserve(size_t count) {
+    reserveRegion();
+
+    Region& state = regions[indexOf(reinterpret_cast<uintptr_t>(_region))];
+    char* limit = limitOf(_region);
+
+    if (count > static_cast<size_t>(reinterpret_cast<value_type*>(limit) - _end)) {
+        throw StackLimitException(limitMessage());
+    }
+    prepare(_region, state, reinterpret_cast<char*>(_end + count));
+}
+
+OperandBuffer::iterator OperandBuffer::insert(const_iterator position, size_t count, value_type value) {
+    size_t index = static_cast<size_t>(position - _begin);
+
+    reserve(count);
+    std::memmove(_begin + index + count, _begin + index, (size() - index) * sizeof(value_type));
+    std::fill(_begin + index, _begin + index + count, value);
+    _end += count;
+    return _begin + index;
+}
+
+OperandBuffer::iterator OperandBuffer::insert(const_iterator position, const_iterator first,
+                                              const_iterator last) {
+    size_t index = static_cast<size_t>(position - _begin);
+    size_t count = static_cast<size_t>(last - first);
+
+    reserve(count);
+    std::memmove(_begin + index + count, _begin + index, (size() - index) * sizeof(value_type));
+    std::copy(first, last, _begin + index);
+    _end += count;
+    return _begin + index;
+}
+
+OperandBuffer::iterator OperandBuffer::erase(const_iterator first, const_iterator last) {
+    size_t index = static_cast<size_t>(first - _begin);
+    size_t count = static_cast<size_t>(last - first);
+
+    std::memmove(_begin + index, _begin + index + count, (size() - index - count) * sizeof(value_type));
+    _end -= count;
+    return _begin + index;
+}
+
+void OperandBuffer::resize(size_t count) {
+    if (count > size()) {
+        insert(_end, count - size(), nullptr);
+    }
+    _end = _begin + count;
+}
+
+void OperandBuffer::swap(OperandBuffer& other) noexcept {
+    std::swap(_region, other._region);
+    std::swap(_begin, other._begin);
+    std::swap(_end, other._end);
+}
+
+bool OperandBuffer::setLimit(size_t values) {
+    size_t page = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+
+    if (configured || values == 0 || values > (size_t(1) << 36) / sizeof(value_type)) {
+        return false;
+    }
+
+    // The smallest region holding the values, the spare area and a guard page
+    size_t size = (values * sizeof(value_type) + page - 1) & ~(page - 1);
+    size_t bits = 24;
+    while ((size_t(1) << bits) < size + spareSize + page) {
+        ++bits;
+    }
+    if (bits > 36) {
+        return false;
+    }
+    regionBits = bits;
+    regionSize = size_t(1) << bits;
+    limitSize = size;
+    return true;
+}
+
+size_t OperandBuffer::getLimit() {
+    std::call_once(installed, install);
+    return limitSize / sizeof(value_type);
+}
+
+std::string OperandBuffer::limitMessage() {
+    return "Stack limit of " + std::to_string(getLimit()) + " values exceeded";
+}
+
+bool OperandBuffer::settle() {
+    if (!_region) {
+        return false;
+    }
+
+    Region& state = regions[indexOf(reinterpret_cast<uintptr_t>(_region))];
+    if (!state.overflowed) {
+        prepare(_region, state, state.open);
+        return false;
+    }
+    value_type* limit = reinterpret_cast<value_type*>(limitOf(_region));
+    for (value_type* value = limit; value < _end; ++value) {
+        delete *value;
+    }
+    _end = std::min(_end, limit);
+    mprotect(limit, spareSize, PROT_NONE);
+    state = Region{reinterpret_cast<char*>(limit), state.ready, false};
+    return true;
+}
@@ -5,6 +5,7 @@
 #include "Float.hpp"
 #include "Double.hpp"
 #include "AbstractVMException.hpp"
+#include <stdexcept>
 
 const std::array<OperandFactory::CreateFn, 5> OperandFactory::_createFunctions = {
     &OperandFactory::createInt8,
@@ -14,6 +15,14 @@ const std::array<OperandFactory::CreateFn, 5> OperandFactory::_createFunctions =
     &OperandFactory::createDouble
 };
 
+const std::array<OperandFactory::CreateFromValueFn, 5> OperandFactory::_createFromValueFunctions = {
+    &OperandFactory::createInt8,
+    &OperandFactory::createInt16,
+    &OperandFactory::createInt32,
+    &OperandFactory::createFloat,
+    &OperandFactory::createDouble
+};
+
 const IOperand* OperandFactory::createOperand(eOperandType type, const std::string& value) const {
     // Cast enum to size_t to use as array index
     size_t index = static_cast<int>(type);
@@ -47,3 +56,33 @@ const IOperand* OperandFactory::createFloat(const std::string& value) const {
 const IOperand* OperandFactory::createDouble(const std::string& value) const {
     return new Double(value);
 }
+
+const IOperand* OperandFactory::createOperand(eOperandType type, long double value) const {
+    size_t index = static_cast<int>(type);
+
+    if (index >= _createFromValueFunctions.size()) {
+        throw std::invalid_argument("Invalid operand type");
+    }
+
+    return (this->*_createFromValueFunctions[index])(value);
+}
+
+const IOperand* OperandFactory::createInt8(long double value) const {
+    return new Int8(value);
+}
+
+const IOperand* OperandFactory::createInt16(long double value) const {
+    return new Int16(value);
+}
+
+const IOperand* OperandFactory::createInt32(long double value) const {
+    return new Int32(value);
+}
+
+const IOperand* OperandFactory::createFloat(long double value) const {
+    return new Float(value);
+}
+
+const IOperand* OperandFactory::createDouble(long double value) const {
+    return new Double(value);
+}
@@ -1,31 +1,36 @@
 #include "Parser.hpp"
+#include "VirtualMachine.hpp"
 #include "Commands.hpp"
 #include "AbstractVMException.hpp"
+#include "ModuleCache.hpp"
+#include <algorithm>
+#include <charconv>
 #include <iostream>
 
-Parser::Parser(const std::vector<Token>& tokens, bool collectErrors, VirtualMachine* vm)
-    : _tokens(tokens), _currentIndex(0), _collectErrors(collectErrors),
-      _hasExitInstruction(false), _vm(vm) {}
+Parser::Parser(const std::vector<Token>& tokens, bool collectErrors, VirtualMachine& vm)
+    : _tokens(tokens), _stream(&_tokens), _currentIndex(0), _expanded(0),
+      _collectErrors(collectErrors), _hasExitInstruction(false), _vm(&vm), _forkDepth(0),
+      _handlerDepth(0), _forkBase(0), _handlerBase(0) {}
 
 const Token& Parser::currentToken() const {
-    if (_currentIndex >= _tokens.size()) {
+    if (_currentIndex >= _stream->size()) {
         // Return END_FILE token if out of bounds
         static Token endToken(TokenType::END_FILE, "", 0, 0);
         return endToken;
     }
-    return _tokens[_currentIndex];
+    return (*_stream)[_currentIndex];
 }
 
 const Token& Parser::peekToken() const {
-    if (_currentIndex + 1 >= _tokens.size()) {
+    if (_currentIndex + 1 >= _stream->size()) {
         static Token endToken(TokenType::END_FILE, "", 0, 0);
         return endToken;
     }
-    return _tokens[_currentIndex + 1];
+    return (*_stream)[_currentIndex + 1];
 }
 
 void Parser::advance() {
-    if (_currentIndex < _tokens.size()) {
+    if (_currentIndex < _stream->size()) {
         _currentIndex++;
     }
 }
@@ -41,7 +46,10 @@ bool Parser::expect(TokenType type) {
     return true;
 }
 
-void Parser::error(const std::string& message) {
+void Parser::error(const std::string& text) {
+    // Errors in included files name the file
+    std::string message = _file.empty() ? text : text + " in " + _file;
+
     if (_collectErrors) {
         _errors.push_back(message);
         // Try to recover: skip to next newline
@@ -58,13 +66,7 @@ void Parser::error(const std::string& message) {
     }
 }
 
-void Parser::skipNewlines() {
-    while (currentToken().getType() == TokenType::NEWLINE) {
-        advance();
-    }
-}
-
-std::vector<std::unique_ptr<ICommand>> Parser::parse() {
+std::vector<std::unique_ptr<ICommand>> Parser::parseStatements() {
     std::vector<std::unique_ptr<ICommand>> commands;
 
     skipNewlines();
@@ -72,14 +74,29 @@ std::vector<std::unique_ptr<ICommand>> Parser::parse() {
     while (currentToken().getType() != TokenType::END_FILE &&
            currentToken().getType() != TokenType::END_INPUT) {
 
-        auto command = parseInstruction();
-        if (command) {
-            commands.push_back(std::move(command));
-        }
+        size_t offset = _currentIndex;
+        parseStatement(commands);
+        _offsets.resize(commands.size(), offset);
 
         skipNewlines();
     }
 
+    return commands;
+}
+
+const std::vector<size_t>& Parser::getOffsets() const {
+    return _offsets;
+}
+
+void Parser::skipNewlines() {
+    while (currentToken().getType() == TokenType::NEWLINE) {
+        advance();
+    }
+}
+
+std::vector<std::unique_ptr<ICommand>> Parser::parse() {
+    std::vector<std::unique_ptr<ICommand>> commands = parseStatements();
+
     // Check that exit instruction was found
     if (!_hasExitInstruction && !_collectErrors) {
         throw SyntaxException("Program must end with 'exit' instruction");
@@ -98,6 +115,47 @@ std::unique_ptr<ICommand> Parser::parseInstruction() {
             return parsePush();
         case TokenType::ASSERT:
             return parseAssert();
+        case TokenType::READ:
+            return parseRead();
+        case TokenType::FORK:
+            return parseFork();
+        case TokenType::ENDFORK:
+            if (_forkDepth == _forkBase) {
+                error("'endfork' without matching 'fork' at line " +
+                      std::to_string(currentToken().getLine()));
+            }
+            return nullptr;
+        case TokenType::ONERROR:
+            return parseOnError();
+        case TokenType::ENDONERROR:
+            if (_handlerDepth == _handlerBase) {
+                error("'endonerror' without matching 'onerror' at line " +
+                      std::to_string(currentToken().getLine()));
+            }
+            return nullptr;
+        case TokenType::JOIN:
+            advance(); // consume 'join'
+            return std::make_unique<JoinCommand>(_vm);
+        case TokenType::SEND:
+        case TokenType::RECV:
+            return parseChannel(instrType);
+        case TokenType::USE:
+            return parseUse();
+        case TokenType::MOVE:
+            return parseMove();
+        case TokenType::DUMPDELTA:
+            advance(); // consume 'dumpdelta'
+            _vm->enableChangeTracking();
+            return std::make_unique<DumpDeltaCommand>(_vm);
+        case TokenType::SAVEPOINT:
+            advance(); // consume 'savepoint'
+            return std::make_unique<SavepointCommand>(_vm);
+        case TokenType::ROLLBACK:
+            advance(); // consume 'rollback'
+            return std::make_unique<RollbackCommand>(_vm);
+        case TokenType::COMMIT:
+            advance(); // consume 'commit'
+            return std::make_unique<CommitCommand>(_vm);
         case TokenType::POP:
         case TokenType::DUMP:
         case TokenType::ADD:
@@ -115,12 +173,9 @@ std::unique_ptr<ICommand> Parser::parseInstruction() {
     }
 }
 
-const IOperand* Parser::parseValue() {
+bool Parser::parseType(eOperandType& type) {
     // Expect a type keyword (int8, int16, int32, float, double)
-    TokenType typeToken = currentToken().getType();
-    eOperandType type;
-
-    switch (typeToken) {
+    switch (currentToken().getType()) {
         case TokenType::INT8:
             type = eOperandType::Int8;
             break;
@@ -139,56 +194,114 @@ const IOperand* Parser::parseValue() {
         default:
             error("Expected operand type (int8, int16, int32, float, double) at line " +
                   std::to_string(currentToken().getLine()));
-            return nullptr;
+            return false;
     }
 
     advance(); // consume type keyword
+    return true;
+}
+
+bool Parser::parseCount(const std::string& keyword, size_t line, size_t& count) {
+    const std::string& text = currentToken().getValue();
+    if (currentToken().getType() != TokenType::INTEGER || text[0] == '-' || text[0] == '+') {
+        error("Expected value count after '" + keyword + "' at line " + std::to_string(line));
+        return false;
+    }
+
+    const char* end = text.data() + text.size();
+    auto [last, status] = std::from_chars(text.data(), end, count);
+    if (status != std::errc() || last != end) {
+        error("Invalid value count after '" + keyword + "' at line " + std::to_string(line));
+        return false;
+    }
+    advance(); // consume count
+    return true;
+}
+
+bool Parser::isLiteral(TokenType type) const {
+    return type == TokenType::INTEGER || type == TokenType::DECIMAL ||
+           type == TokenType::PLACEHOLDER;
+}
 
-    std::string valueStr;
+bool Parser::parseValueSpec(eOperandType& type, Token& literal) {
+    if (!parseType(type)) {
+        return false;
+    }
 
     // Check for optional parenthesis: float(42) or float (42) or float 42
     if (currentToken().getType() == TokenType::LPAREN) {
         // Parenthesis syntax: float(42) or float (42)
         advance(); // consume '('
 
-        // Expect number
-        if (currentToken().getType() != TokenType::INTEGER &&
-            currentToken().getType() != TokenType::DECIMAL) {
+        // Expect number or placeholder
+        if (!isLiteral(currentToken().getType())) {
             error("Expected numeric value at line " +
                   std::to_string(currentToken().getLine()));
-            return nullptr;
+            return false;
         }
 
-        valueStr = currentToken().getValue();
+        literal = currentToken();
         advance(); // consume number
 
         if (!expect(TokenType::RPAREN)) {
-            return nullptr;
+            return false;
         }
-    } else if (currentToken().getType() == TokenType::INTEGER ||
-               currentToken().getType() == TokenType::DECIMAL) {
+    } else if (isLiteral(currentToken().getType())) {
         // Shorthand syntax: float 42
-        valueStr = currentToken().getValue();
+        literal = currentToken();
         advance(); // consume number
     } else {
         error("Expected '(' or numeric value after type at line " +
               std::to_string(currentToken().getLine()));
-        return nullptr;
+        return false;
     }
 
+    return true;
+}
+
+const IOperand* Parser::createLiteral(eOperandType type, const Token& literal) {
     // Create operand using factory
     try {
-        return _factory.createOperand(type, valueStr);
+        return _factory.createOperand(type, literal.getValue());
     } catch (const std::exception& e) {
         error("Failed to create operand: " + std::string(e.what()));
         return nullptr;
     }
 }
 
+const IOperand* Parser::parseValue() {
+    eOperandType type;
+    Token literal;
+
+    if (!parseValueSpec(type, literal)) {
+        return nullptr;
+    }
+
+    if (literal.getType() == TokenType::PLACEHOLDER) {
+        error("Placeholder '$" + literal.getValue() + "' is only allowed in push at line " +
+              std::to_string(literal.getLine()));
+        return nullptr;
+    }
+
+    return createLiteral(type, literal);
+}
+
 std::unique_ptr<ICommand> Parser::parsePush() {
     advance(); // consume 'push'
 
-    const IOperand* operand = parseValue();
+    eOperandType type;
+    Token literal;
+
+    if (!parseValueSpec(type, literal)) {
+        return nullptr;
+    }
+
+    // Placeholders are left as typed slots, bound to a value at run time
+    if (literal.getType() == TokenType::PLACEHOLDER) {
+        return std::make_unique<PushSlotCommand>(_vm, type, _vm->placeholderSlot(literal.getValue()));
+    }
+
+    const IOperand* operand = createLiteral(type, literal);
     if (!operand) {
         return nullptr;
     }
@@ -207,14 +320,391 @@ std::unique_ptr<ICommand> Parser::parseAssert() {
     return std::make_unique<AssertCommand>(operand);
 }
 
+std::unique_ptr<ICommand> Parser::parseRead() {
+    advance(); // consume 'read'
+
+    eOperandType type;
+    if (!parseType(type)) {
+        return nullptr;
+    }
+
+    return std::make_unique<ReadCommand>(_vm, type);
+}
+
+void Parser::parseBlock(std::vector<std::unique_ptr<ICommand>>& commands) {
+    skipNewlines();
+    while (currentToken().getType() != TokenType::ENDFORK &&
+           currentToken().getType() != TokenType::ENDONERROR &&
+           currentToken().getType() != TokenType::END_FILE &&
+           currentToken().getType() != TokenType::END_INPUT) {
+        parseStatement(commands);
+        skipNewlines();
+    }
+}
+
+void Parser::parseStatement(std::vector<std::unique_ptr<ICommand>>& commands) {
+    switch (currentToken().getType()) {
+        case TokenType::INCLUDE:
+            parseInclude(commands);
+            return;
+        case TokenType::MACRO:
+            parseMacro();
+            return;
+        case TokenType::ENDMACRO:
+            error("'endmacro' without matching 'macro' at line " +
+                  std::to_string(currentToken().getLine()));
+            return;
+        case TokenType::IDENTIFIER:
+            if (_macros.count(currentToken().getValue())) {
+                expandMacro(commands);
+                return;
+            }
+            break;
+        default:
+            break;
+    }
+
+    auto command = parseInstruction();
+    if (command) {
+        commands.push_back(std::move(command));
+    }
+}
+
+void Parser::setPath(const std::string& path) {
+    std::error_code error;
+    std::filesystem::path canonical = std::filesystem::canonical(path, error);
+
+    _directory = std::filesystem::path(path).parent_path();
+    _includes.assign(1, error ? path : canonical.string());
+}
+
+void Parser::parseInclude(std::vector<std::unique_ptr<ICommand>>& commands) {
+    size_t line = currentToken().getLine();
+    advance(); // consume 'include'
+
+    if (currentToken().getType() != TokenType::STRING || currentToken().getValue().empty()) {
+        error("Expected file name after 'include' at line " + std::to_string(line));
+        return;
+    }
+    std::filesystem::path name = currentToken().getValue();
+    advance(); // consume file name
+
+    std::shared_ptr<const Module> module;
+    try {
+        module = ModuleCache::instance().get(name.is_relative() ? _directory / name : name);
+    } catch (const std::runtime_error& e) {
+        error(std::string(e.what()) + " included at line " + std::to_string(line));
+        return;
+    }
+
+    for (const std::string& including : _includes) {
+        if (including == module->path) {
+            std::string cycle;
+            for (const std::string& file : _includes) {
+                cycle += file + " -> ";
+            }
+            error("Include cycle: " + cycle + module->path + " at line " + std::to_string(line));
+            return;
+        }
+    }
+
+    std::filesystem::path directory = _directory;
+
+    _directory = std::filesystem::path(module->path).parent_path();
+    _includes.push_back(module->path);
+    parseTokens(module->tokens, name.string(), commands);
+    _includes.pop_back();
+    _directory = directory;
+}
+
+void Parser::parseMacro() {
+    size_t line = currentToken().getLine();
+    advance(); // consume 'macro'
+
+    if (currentToken().getType() != TokenType::IDENTIFIER) {
+        error("Expected macro name after 'macro' at line " + std::to_string(line));
+        return;
+    }
+    std::string name = currentToken().getValue();
+    advance(); // consume name
+
+    Macro macro{{}, {}, _file};
+    while (currentToken().getType() == TokenType::IDENTIFIER) {
+        macro.parameters.push_back(currentToken().getValue());
+        advance(); // consume parameter
+    }
+    if (currentToken().getType() != TokenType::NEWLINE) {
+        error("Expected parameter name in macro '" + name + "' at line " + std::to_string(line));
+        return;
+    }
+
+    // The body is kept as tokens, up to 'endmacro'
+    while (currentToken().getType() != TokenType::ENDMACRO) {
+        if (currentToken().getType() == TokenType::END_FILE ||
+            currentToken().getType() == TokenType::END_INPUT) {
+            error("Missing 'endmacro' for macro '" + name + "' at line " + std::to_string(line));
+            return;
+        }
+        if (currentToken().getType() == TokenType::MACRO) {
+            error("Macro defined inside macro '" + name + "' at line " +
+                  std::to_string(currentToken().getLine()));
+            return;
+        }
+        macro.body.push_back(currentToken());
+        advance();
+    }
+    macro.body.emplace_back(TokenType::END_FILE, "", currentToken().getLine(), 0);
+    advance(); // consume 'endmacro'
+
+    if (!_macros.emplace(name, std::move(macro)).second) {
+        error("Macro '" + name + "' is already defined at line " + std::to_string(line));
+    }
+}
+
+void Parser::expandMacro(std::vector<std::unique_ptr<ICommand>>& commands) {
+    size_t line = currentToken().getLine();
+    std::string name = currentToken().getValue();
+    const Macro& macro = _macros.at(name);
+    advance(); // consume name
+
+    // Each argument is the token range of a typed value
+    std::vector<std::pair<size_t, size_t>> arguments;
+    for (const std::string& parameter : macro.parameters) {
+        size_t begin = _currentIndex;
+        eOperandType type;
+        Token literal;
+
+        if (currentToken().getType() == TokenType::NEWLINE ||
+            currentToken().getType() == TokenType::END_FILE ||
+            currentToken().getType() == TokenType::END_INPUT) {
+            error("Missing value for parameter '" + parameter + "' of macro '" + name +
+                  "' at line " + std::to_string(line));
+            return;
+        }
+        if (!parseValueSpec(type, literal)) {
+            return;
+        }
+        arguments.emplace_back(begin, _currentIndex);
+    }
+
+    for (const std::string& expanding : _expanding) {
+        if (expanding == name) {
+            error("Recursive use of macro '" + name + "' at line " + std::to_string(line));
+            return;
+        }
+    }
+    if (_expanding.size() >= maxNesting) {
+        error("Macro nesting exceeds " + std::to_string(maxNesting) + " levels at line " +
+              std::to_string(line));
+        return;
+    }
+
+    // Uses expanding to nothing count too: they still parse their body
+    _expanded += macro.body.size() + 1;
+    if (_expanded > maxExpansion) {
+        return; // reported by the outermost use
+    }
+
+    bool outermost = _expanding.empty();
+    size_t first = commands.size();
+    std::string file = "macro " + name + (macro.file.empty() ? "" : " in " + macro.file);
+    _expanding.push_back(name);
+    if (macro.parameters.empty()) {
+        parseTokens(macro.body, file, commands);
+    } else {
+        // Substitute the arguments, with the lines of the body for errors
+        std::vector<Token> body;
+        body.reserve(macro.body.size() + macro.parameters.size() * 4);
+        for (const Token& token : macro.body) {
+            size_t parameter = macro.parameters.size();
+            if (token.getType() == TokenType::IDENTIFIER) {
+                parameter = std::find(macro.parameters.begin(), macro.parameters.end(),
+                                      token.getValue()) - macro.parameters.begin();
+            }
+            if (parameter == macro.parameters.size()) {
+                body.push_back(token);
+                continue;
+            }
+            for (size_t index = arguments[parameter].first; index < arguments[parameter].second; ++index) {
+                const Token& argument = (*_stream)[index];
+                body.emplace_back(argument.getType(), argument.getValue(), token.getLine(),
+                                  token.getColumn());
+            }
+        }
+        parseTokens(body, file, commands);
+    }
+    _expanding.pop_back();
+
+    if (outermost && _expanded > maxExpansion) {
+        commands.resize(first);
+        error("Macro expansion exceeds " + std::to_string(maxExpansion) + " tokens at line " +
+              std::to_string(line));
+    }
+}
+
+void Parser::parseTokens(const std::vector<Token>& tokens, const std::string& file,
+                         std::vector<std::unique_ptr<ICommand>>& commands) {
+    const std::vector<Token>* stream = _stream;
+    size_t index = _currentIndex;
+    std::string including = _file;
+    size_t forkBase = _forkBase;
+    size_t handlerBase = _handlerBase;
+
+    // The enclosing blocks stay open, but the sequence cannot close them
+    _stream = &tokens;
+    _currentIndex = 0;
+    _file = file;
+    _forkBase = _forkDepth;
+    _handlerBase = _handlerDepth;
+
+    skipNewlines();
+    while (currentToken().getType() != TokenType::END_FILE) {
+        parseStatement(commands);
+        skipNewlines();
+    }
+
+    _stream = stream;
+    _currentIndex = index;
+    _file = including;
+    _forkBase = forkBase;
+    _handlerBase = handlerBase;
+}
+
+std::unique_ptr<ICommand> Parser::parseOnError() {
+    size_t line = currentToken().getLine();
+    advance(); // consume 'onerror'
+
+    std::vector<std::unique_ptr<ICommand>> handler;
+    ++_handlerDepth;
+    parseBlock(handler);
+    --_handlerDepth;
+
+    if (currentToken().getType() != TokenType::ENDONERROR) {
+        error("Missing 'endonerror' for onerror at line " + std::to_string(line));
+        return nullptr;
+    }
+    advance(); // consume 'endonerror'
+
+    return std::make_unique<OnErrorCommand>(_vm, std::move(handler));
+}
+
+std::unique_ptr<ICommand> Parser::parseFork() {
+    size_t line = currentToken().getLine();
+    advance(); // consume 'fork'
+
+    size_t values = 0;
+    if (!parseCount("fork", line, values)) {
+        return nullptr;
+    }
+
+    // Parse the block for the child VM
+    auto child = std::make_unique<VirtualMachine>();
+    child->setChannels(_vm->getChannels());
+    child->setDumpFormat(_vm->getDumpFormat());
+    VirtualMachine* parent = _vm;
+    std::vector<std::unique_ptr<ICommand>> commands;
+
+    _vm = child.get();
+    ++_forkDepth;
+    parseBlock(commands);
+    --_forkDepth;
+    _vm = parent;
+
+    if (currentToken().getType() != TokenType::ENDFORK) {
+        error("Missing 'endfork' for fork at line " + std::to_string(line));
+        return nullptr;
+    }
+    advance(); // consume 'endfork'
+
+    return std::make_unique<ForkCommand>(_vm, std::move(child), std::move(commands), values);
+}
+
+std::unique_ptr<ICommand> Parser::parseChannel(TokenType type) {
+    size_t line = currentToken().getLine();
+    std::string keyword = currentToken().getValue();
+    advance(); // consume 'send' or 'recv'
+
+    if (currentToken().getType() != TokenType::IDENTIFIER) {
+        error("Expected channel name after '" + keyword + "' at line " + std::to_string(line));
+        return nullptr;
+    }
+    std::string name = currentToken().getValue();
+    advance(); // consume channel name
+
+    Channel* channel;
+    try {
+        channel = &_vm->attachChannel(name, type == TokenType::SEND);
+    } catch (const ChannelException& e) {
+        error(std::string(e.what()) + " at line " + std::to_string(line));
+        return nullptr;
+    }
+
+    if (type == TokenType::SEND) {
+        return std::make_unique<SendCommand>(channel);
+    }
+    return std::make_unique<RecvCommand>(channel);
+}
+
+std::unique_ptr<ICommand> Parser::parseUse() {
+    size_t line = currentToken().getLine();
+    advance(); // consume 'use'
+
+    if (currentToken().getType() != TokenType::IDENTIFIER) {
+        error("Expected stack name after 'use' at line " + std::to_string(line));
+        return nullptr;
+    }
+    size_t stack = _vm->stackIndex(currentToken().getValue());
+    advance(); // consume stack name
+
+    return std::make_unique<UseCommand>(_vm, stack);
+}
+
+std::unique_ptr<ICommand> Parser::parseMove() {
+    size_t line = currentToken().getLine();
+    advance(); // consume 'move'
+
+    size_t stacks[2];
+    for (size_t& stack : stacks) {
+        if (currentToken().getType() != TokenType::IDENTIFIER) {
+            error("Expected source and destination stacks after 'move' at line " +
+                  std::to_string(line));
+            return nullptr;
+        }
+        stack = _vm->stackIndex(currentToken().getValue());
+        advance(); // consume stack name
+    }
+
+    size_t values = 0;
+    if (!parseCount("move", line, values)) {
+        return nullptr;
+    }
+
+    return std::make_unique<MoveCommand>(_vm, stacks[0], stacks[1], values);
+}
+
 std::unique_ptr<ICommand> Parser::parseSimpleInstruction(TokenType type) {
+    size_t line = currentToken().getLine();
     advance(); // consume instruction keyword
 
     switch (type) {
         case TokenType::POP:
             return std::make_unique<PopCommand>();
-        case TokenType::DUMP:
-            return std::make_unique<DumpCommand>();
+        case TokenType::DUMP: {
+            size_t values = DumpCommand::all;
+            if (currentToken().getType() == TokenType::INTEGER && !parseCount("dump", line, values)) {
+                return nullptr;
+            }
+            std::string path;
+            if (currentToken().getType() == TokenType::STRING) {
+                path = currentToken().getValue();
+                if (path.empty()) {
+                    error("Expected file name after 'dump' at line " + std::to_string(line));
+                    return nullptr;
+                }
+                advance(); // consume file name
+            }
+            return std::make_unique<DumpCommand>(_vm, values, path);
+        }
         case TokenType::ADD:
             return std::make_unique<AddCommand>();
         case TokenType::SUB:
@@ -226,8 +716,12 @@ std::unique_ptr<ICommand> Parser::parseSimpleInstruction(TokenType type) {
         case TokenType::MOD:
             return std::make_unique<ModCommand>();
         case TokenType::PRINT:
-            return std::make_unique<PrintCommand>();
+            return std::make_unique<PrintCommand>(_vm);
         case TokenType::EXIT:
+            if (_forkDepth > 0) {
+                error("'exit' is not allowed inside fork at line " + std::to_string(line));
+                return nullptr;
+            }
             _hasExitInstruction = true;
             return std::make_unique<ExitCommand>(_vm);
         default:
@@ -0,0 +1,342 @@
+#include "RegisterEngine.hpp"
+#include "VirtualMachine.hpp"
+#include "OperandFactory.hpp"
+#include "AbstractVMException.hpp"
+#include <algorithm>
+#include <iostream>
+#include <thread>
+#include <atomic>
+#include <limits>
+
+RegisterEngine::RegisterEngine(VirtualMachine& vm, IRProgram program)
+    : _vm(vm), _program(std::move(program)), _segments(1),
+      _threads(std::max(1u, std::thread::hardware_concurrency())) {
+    partition();
+}
+
+const IRProgram& RegisterEngine::getProgram() const {
+    return _program;
+}
+
+void RegisterEngine::setThreads(size_t threads) {
+    _threads = std::max<size_t>(threads, 1);
+}
+
+size_t RegisterEngine::getSegmentCount() const {
+    return _segments;
+}
+
+size_t RegisterEngine::getTaskCount() const {
+    return _tasks.size() - 1;
+}
+
+void RegisterEngine::partition() {
+    const std::vector<IRInstruction>& code = _program.code;
+    std::vector<bool> boundary(code.size() + 1, false);
+    std::vector<bool> live(_program.registers, false);
+    size_t liveCount = 0;
+    bool reads = false;
+
+    auto use = [&](uint32_t reg) {
+        if (!live[reg]) {
+            live[reg] = true;
+            ++liveCount;
+        }
+    };
+    auto define = [&](uint32_t reg) {
+        if (live[reg]) {
+            live[reg] = false;
+            --liveCount;
+        }
+    };
+
+    // Backward liveness: a boundary is a point where no register is live
+    for (size_t index = code.size(); index-- > 0;) {
+        const IRInstruction& instruction = code[index];
+
+        switch (instruction.op) {
+            case eIROp::Const:
+            case eIROp::Load:
+                define(instruction.dst);
+                break;
+            case eIROp::Read:
+                define(instruction.dst);
+                reads = true;
+                break;
+            case eIROp::Copy:
+                define(instruction.dst);
+                use(instruction.lhs);
+                break;
+            case eIROp::Arith:
+                define(instruction.dst);
+                use(instruction.lhs);
+                use(instruction.rhs);
+                break;
+            case eIROp::Assert:
+            case eIROp::Print:
+                use(instruction.lhs);
+                break;
+            case eIROp::Dump:
+                for (uint32_t reg = instruction.rhs; reg < instruction.lhs; ++reg) {
+                    use(reg);
+                }
+                break;
+            case eIROp::Exit:
+            case eIROp::Fail:
+                // The final stack is collected across tasks (see takeFinalStack)
+                live.assign(live.size(), false);
+                liveCount = 0;
+                break;
+        }
+        boundary[index] = (liveCount == 0);
+    }
+
+    _tasks.assign(1, 0);
+    for (size_t index = 1; index < code.size(); ++index) {
+        if (!boundary[index]) {
+            continue;
+        }
+        ++_segments;
+        if (!reads && index - _tasks.back() >= minTaskSize) {
+            _tasks.push_back(index);
+        }
+    }
+    _tasks.push_back(code.size());
+}
+
+long double RegisterEngine::checked(eOperandType type, long double value) {
+    if (!fitsType(type, value)) {
+        // Let the operand constructor raise the exact exception
+        OperandFactory factory;
+        delete factory.createOperand(type, value);
+    }
+    return castToType(type, value);
+}
+
+void RegisterEngine::arithmetic(const IRInstruction& instruction, std::vector<long double>& registers) {
+    long double lhs = registers[instruction.lhs];
+    long double rhs = rhsValue(instruction.rhsType, registers[instruction.rhs]);
+
+    if ((instruction.arithmetic == eArithmetic::Div || instruction.arithmetic == eArithmetic::Mod) &&
+        rhs == 0.0) {
+        throw DivisionByZeroException("Division by zero error.");
+    }
+
+    long double value = applyArithmetic(instruction.arithmetic, lhs, rhs);
+    if (!instruction.exact) {
+        value = roundResult(value);
+    }
+    registers[instruction.dst] = checked(instruction.type, value);
+}
+
+void RegisterEngine::assertValue(const IRInstruction& instruction,
+                                 const std::vector<long double>& registers) const {
+    long double value = registers[instruction.lhs];
+
+    if (instruction.type == eOperandType::Float || instruction.type == eOperandType::Double) {
+        // Floating-point values are compared on their text, like toString()
+        std::string actual = formatValue(instruction.type, value);
+        const std::string& expected = _program.expected[instruction.index];
+        if (actual != expected) {
+            throw AssertException("Assert failed: value mismatch. Expected " + expected +
+                                  " but got " + actual);
+        }
+    } else if (value != instruction.value) {
+        throw AssertException("Assert failed: value mismatch. Expected " +
+                              _program.expected[instruction.index] + " but got " +
+                              formatValue(instruction.type, value));
+    }
+}
+
+void RegisterEngine::dump(const IRInstruction& instruction, Context& context) const {
+    const std::vector<eOperandType>& layout = _program.layouts[instruction.index];
+    eDumpFormat format = _vm.getDumpFormat();
+    char buffer[maxEntrySize];
+    char entry[maxEntrySize];
+
+    if (format == eDumpFormat::Binary) {
+        appendBinaryHeader(context.output, instruction.lhs - instruction.rhs);
+        for (uint32_t reg = instruction.rhs; reg < instruction.lhs; ++reg) {
+            appendBinaryValue(context.output, layout[reg - instruction.rhs], context.registers[reg]);
+        }
+        context.flushed = context.output.size();
+        return;
+    }
+
+    for (uint32_t reg = instruction.rhs; reg < instruction.lhs; ++reg) {
+        eOperandType type = layout[reg - instruction.rhs];
+        size_t length = formatValue(buffer, sizeof(buffer), type, context.registers[reg]);
+        if (format == eDumpFormat::Text) {
+            context.output.append(buffer, length);
+            context.output.push_back('\n');
+        } else {
+            context.output.append(entry, formatEntry(entry, format, type, buffer, length));
+        }
+    }
+    context.flushed = context.output.size();
+}
+
+void RegisterEngine::emit(Context& context) {
+    std::cout.write(context.output.data(), static_cast<std::streamsize>(context.flushed));
+    std::cout.flush();
+    std::cout.write(context.output.data() + context.flushed,
+                    static_cast<std::streamsize>(context.output.size() - context.flushed));
+    context.output.clear();
+    context.flushed = 0;
+}
+
+void RegisterEngine::execute(size_t begin, size_t end, Context& context, bool stream) const {
+    std::vector<long double>& registers = context.registers;
+
+    try {
+        for (size_t index = begin; index < end; ++index) {
+            const IRInstruction& instruction = _program.code[index];
+
+            switch (instruction.op) {
+                case eIROp::Const:
+                    registers[instruction.dst] = instruction.value;
+                    break;
+                case eIROp::Load:
+                    registers[instruction.dst] = checked(instruction.type, _vm.getBinding(instruction.index));
+                    break;
+                case eIROp::Read: {
+                    BinaryReader* input = _vm.getInput();
+                    if (!input) {
+                        throw InputException("Read requires an input stream (use --input)");
+                    }
+                    long double value = 0;
+                    switch (instruction.type) {
+                        case eOperandType::Int8:   value = input->read<int8_t>(); break;
+                        case eOperandType::Int16:  value = input->read<int16_t>(); break;
+                        case eOperandType::Int32:  value = input->read<int32_t>(); break;
+                        case eOperandType::Float:  value = input->read<float>(); break;
+                        case eOperandType::Double: value = input->read<double>(); break;
+                    }
+                    registers[instruction.dst] = checked(instruction.type, value);
+                    break;
+                }
+                case eIROp::Arith:
+                    arithmetic(instruction, registers);
+                    break;
+                case eIROp::Copy:
+                    registers[instruction.dst] = registers[instruction.lhs];
+                    break;
+                case eIROp::Assert:
+                    assertValue(instruction, registers);
+                    break;
+                case eIROp::Print:
+                    context.output.push_back(static_cast<char>(registers[instruction.lhs]));
+                    break;
+                case eIROp::Dump:
+                    dump(instruction, context);
+                    if (stream) {
+                        emit(context);
+                    }
+                    break;
+                case eIROp::Exit:
+                    context.exited = true;
+                    return;
+                case eIROp::Fail:
+                    std::rethrow_exception(_program.errors[instruction.index]);
+            }
+        }
+    } catch (...) {
+        context.error = std::current_exception();
+    }
+}
+
+void RegisterEngine::run() {
+    size_t tasks = getTaskCount();
+    std::vector<Context> contexts(tasks);
+
+    _finished.clear();
+    if (tasks == 1 || _threads == 1) {
+        // Sequential: one context over the whole program
+        contexts.resize(1);
+        contexts[0] = Context{std::vector<long double>(_program.registers, 0.0L), "", 0, false, nullptr};
+        execute(0, _program.code.size(), contexts[0], true);
+        tasks = 1;
+    } else {
+        std::atomic<size_t> next(0);
+        std::atomic<size_t> firstError(std::numeric_limits<size_t>::max());
+
+        auto worker = [&]() {
+            for (size_t task = next++; task < tasks; task = next++) {
+                // Tasks after a failed one will not be written
+                if (task > firstError.load()) {
+                    continue;
+                }
+                Context& context = contexts[task];
+                context = Context{std::vector<long double>(_program.registers, 0.0L), "", 0, false, nullptr};
+                execute(_tasks[task], _tasks[task + 1], context, false);
+                if (context.error) {
+                    size_t current = firstError.load();
+                    while (task < current && !firstError.compare_exchange_weak(current, task)) {
+                    }
+                }
+            }
+        };
+
+        std::vector<std::thread> workers;
+        for (size_t thread = 1; thread < std::min(_threads, tasks); ++thread) {
+            workers.emplace_back(worker);
+        }
+        worker();
+        for (std::thread& thread : workers) {
+            thread.join();
+        }
+    }
+
+    // Merge in program order, up to the first error
+    for (size_t task = 0; task < tasks; ++task) {
+        Context& context = contexts[task];
+        emit(context);
+        if (context.error) {
+            std::rethrow_exception(context.error);
+        }
+        if (context.exited) {
+            _vm.setExitCalled();
+            _finished = std::move(contexts);
+            return;
+        }
+    }
+}
+
+std::vector<Scalar> RegisterEngine::takeFinalStack() {
+    const std::vector<IRInstruction>& code = _program.code;
+    std::vector<Scalar> values;
+
+    if (_finished.empty()) {
+        return values;
+    }
+
+    // Programs are straight-line: the first exit is the one reached
+    size_t exit = 0;
+    while (code[exit].op != eIROp::Exit) {
+        ++exit;
+    }
+    const std::vector<eOperandType>& layout = _program.layouts[code[exit].index];
+    std::vector<bool> found(layout.size(), false);
+    size_t missing = layout.size();
+
+    // Each register holds the value of its last write, in the task that made it
+    values.resize(layout.size());
+    for (size_t index = exit; index-- > 0 && missing > 0;) {
+        const IRInstruction& instruction = code[index];
+        bool writes = instruction.op == eIROp::Const || instruction.op == eIROp::Load ||
+                      instruction.op == eIROp::Read || instruction.op == eIROp::Arith ||
+                      instruction.op == eIROp::Copy;
+        if (!writes || instruction.dst >= layout.size() || found[instruction.dst]) {
+            continue;
+        }
+        size_t task = (_finished.size() == 1)
+                          ? 0
+                          : static_cast<size_t>(std::upper_bound(_tasks.begin(), _tasks.end(), index) -
+                                                _tasks.begin() - 1);
+        values[instruction.dst] = Scalar{layout[instruction.dst], _finished[task].registers[instruction.dst]};
+        found[instruction.dst] = true;
+        --missing;
+    }
+    _finished.clear();
+    return values;
+}
@@ -0,0 +1,181 @@
+#include "RegisterIR.hpp"
+#include "Commands.hpp"
+#include "AbstractVMException.hpp"
+#include <algorithm>
+#include <cctype>
+#include <stdexcept>
+
+namespace {
+    /**
+     * @brief Creates an instruction with default fields.
+     * @param op The instruction
+     * @param dst The destination register
+     * @return IRInstruction The instruction
+     */
+    IRInstruction instruction(eIROp op, size_t dst) {
+        return IRInstruction{op, eArithmetic::Add, eOperandType::Int8, eOperandType::Int8,
+                             false, static_cast<uint32_t>(dst), 0, 0, 0, 0};
+    }
+}
+
+IRProgram translateToIR(const std::vector<std::unique_ptr<ICommand>>& program) {
+    IRProgram ir{{}, {}, {}, {}, 0, 0};
+    std::vector<eOperandType> types; // static type of each register
+    std::vector<const ICommand*> commands;
+    const size_t limit = OperandBuffer::getLimit();
+
+    PackedCommand::flatten(program, commands);
+    ir.sourceSize = commands.size();
+
+    // Appends a Fail instruction; the rest of the program is unreachable
+    auto fail = [&ir](std::exception_ptr error) {
+        IRInstruction failure = instruction(eIROp::Fail, 0);
+        failure.index = ir.errors.size();
+        ir.errors.push_back(error);
+        ir.code.push_back(failure);
+    };
+
+    for (const ICommand* command : commands) {
+        eOpcode opcode = command->getOpcode();
+        IRInstruction step = instruction(eIROp::Const, types.size());
+
+        switch (opcode) {
+            case eOpcode::Push: {
+                const IOperand* operand = static_cast<const PushCommand&>(*command).getOperand();
+                step.type = operand->getType();
+                step.value = operand->getValue();
+                break;
+            }
+            case eOpcode::PushSlot: {
+                const auto& push = static_cast<const PushSlotCommand&>(*command);
+                step.op = eIROp::Load;
+                step.type = push.getType();
+                step.index = push.getSlot();
+                break;
+            }
+            case eOpcode::Read:
+                step.op = eIROp::Read;
+                step.type = static_cast<const ReadCommand&>(*command).getType();
+                break;
+            case eOpcode::Pop:
+                if (types.empty()) {
+                    fail(std::make_exception_ptr(EmptyStackException("Pop on empty stack")));
+                    return ir;
+                }
+                types.pop_back();
+                continue;
+            case eOpcode::Dump:
+                if (!static_cast<const DumpCommand&>(*command).getPath().empty()) {
+                    // Files are rewritten by every dump: keep them in program order
+                    throw std::invalid_argument("Register IR does not support dumps to files");
+                }
+                step.op = eIROp::Dump;
+                step.lhs = static_cast<uint32_t>(types.size());
+                step.rhs = static_cast<uint32_t>(
+                    types.size() - std::min(types.size(),
+                                            static_cast<const DumpCommand&>(*command).getCount()));
+                // Only the dumped registers: a dump of the top of a deep stack stays small
+                step.index = ir.layouts.size();
+                ir.layouts.emplace_back(types.begin() + step.rhs, types.end());
+                ir.code.push_back(step);
+                continue;
+            case eOpcode::Assert: {
+                const IOperand* expected = static_cast<const AssertCommand&>(*command).getExpected();
+                if (types.empty()) {
+                    fail(std::make_exception_ptr(EmptyStackException("Assert on empty stack")));
+                    return ir;
+                }
+                if (types.back() != expected->getType()) {
+                    fail(std::make_exception_ptr(AssertException(
+                        "Assert failed: type mismatch. Expected " +
+                        std::string(operandTypeToString(expected->getType())) + " but got " +
+                        std::string(operandTypeToString(types.back())))));
+                    return ir;
+                }
+                step.op = eIROp::Assert;
+                step.type = expected->getType();
+                step.lhs = static_cast<uint32_t>(types.size() - 1);
+                step.value = expected->getValue();
+                step.index = ir.expected.size();
+                ir.expected.push_back(expected->toString());
+                ir.code.push_back(step);
+                continue;
+            }
+            case eOpcode::Print:
+                if (types.empty()) {
+                    fail(std::make_exception_ptr(EmptyStackException("Print on empty stack")));
+                    return ir;
+                }
+                if (types.back() != eOperandType::Int8) {
+                    fail(std::make_exception_ptr(AssertException(
+                        "Print requires int8 value on top of stack, but got " +
+                        std::string(operandTypeToString(types.back())))));
+                    return ir;
+                }
+                step.op = eIROp::Print;
+                step.lhs = static_cast<uint32_t>(types.size() - 1);
+                ir.code.push_back(step);
+                continue;
+            case eOpcode::Exit:
+                // The registers are the final stack
+                step.op = eIROp::Exit;
+                step.lhs = static_cast<uint32_t>(types.size());
+                step.index = ir.layouts.size();
+                ir.layouts.push_back(types);
+                ir.code.push_back(step);
+                return ir;
+            case eOpcode::Add:
+            case eOpcode::Sub:
+            case eOpcode::Mul:
+            case eOpcode::Div:
+            case eOpcode::Mod: {
+                if (types.size() < 2) {
+                    std::string name = opcodeToString(opcode);
+                    name[0] = static_cast<char>(std::toupper(name[0]));
+                    fail(std::make_exception_ptr(InsufficientValuesException(
+                        name + " requires at least 2 values on stack")));
+                    return ir;
+                }
+                step.op = eIROp::Arith;
+                step.arithmetic = toArithmetic(opcode);
+                step.dst = static_cast<uint32_t>(types.size() - 2);
+                step.lhs = step.dst;
+                step.rhs = static_cast<uint32_t>(types.size() - 1);
+                step.rhsType = types.back();
+                step.type = resultType(types[types.size() - 2], step.rhsType);
+                // Integer sums, differences, products and remainders of
+                // int32 values are exact in long double: rounding is a no-op
+                step.exact = isInteger(step.type) && step.arithmetic != eArithmetic::Div;
+                types.pop_back();
+                types.back() = step.type;
+                ir.code.push_back(step);
+                continue;
+            }
+            case eOpcode::Packed:
+                continue;
+            case eOpcode::Fork:
+            case eOpcode::Join:
+            case eOpcode::Send:
+            case eOpcode::Recv:
+            case eOpcode::Use:
+            case eOpcode::Move:
+            case eOpcode::Savepoint:
+            case eOpcode::Rollback:
+            case eOpcode::Commit:
+            case eOpcode::OnError:
+            case eOpcode::DumpDelta:
+                throw std::invalid_argument(std::string("Register IR does not support '") +
+                                            opcodeToString(opcode) + "'");
+        }
+
+        // Pushes: the value goes to the new top register
+        if (types.size() == limit) {
+            fail(std::make_exception_ptr(StackLimitException(OperandBuffer::limitMessage())));
+            return ir;
+        }
+        types.push_back(step.type);
+        ir.registers = std::max(ir.registers, types.size());
+        ir.code.push_back(step);
+    }
+    return ir;
+}
@@ -0,0 +1,127 @@
+#include "SuperwordPass.hpp"
+#include "Commands.hpp"
+
+namespace {
+    /**
+     * @brief Checks if an instruction can be part of a packed expression.
+     * @param opcode The instruction
+     * @return bool True for pushes and arithmetic
+     */
+    bool isExpression(eOpcode opcode) {
+        switch (opcode) {
+            case eOpcode::Push:
+            case eOpcode::PushSlot:
+            case eOpcode::Add:
+            case eOpcode::Sub:
+            case eOpcode::Mul:
+            case eOpcode::Div:
+            case eOpcode::Mod:
+                return true;
+            default:
+                return false;
+        }
+    }
+
+    /**
+     * @struct Tree
+     * @brief A value left on the stack by a run of instructions.
+     */
+    struct Tree {
+        size_t start;   ///< Index of the instruction that starts the expression
+        bool closed;    ///< False if the expression consumes values pushed before the run
+    };
+}
+
+SuperwordPass::SuperwordPass(VirtualMachine* vm) : _vm(vm) {}
+
+int SuperwordPass::shapeOf(const ICommand& command) {
+    eOpcode opcode = command.getOpcode();
+    int type = 0;
+
+    if (opcode == eOpcode::Push) {
+        type = static_cast<int>(static_cast<const PushCommand&>(command).getOperand()->getType());
+    } else if (opcode == eOpcode::PushSlot) {
+        type = static_cast<int>(static_cast<const PushSlotCommand&>(command).getType());
+    }
+    return static_cast<int>(opcode) * 8 + type;
+}
+
+std::vector<SuperwordPass::Region> SuperwordPass::run(std::vector<std::unique_ptr<ICommand>>& program) {
+    std::vector<std::unique_ptr<ICommand>> output;
+    std::vector<Region> regions;
+    size_t index = 0;
+
+    while (index < program.size()) {
+        if (!isExpression(program[index]->getOpcode())) {
+            output.push_back(std::move(program[index++]));
+            continue;
+        }
+
+        // Split the run into the expressions left on the stack at its end
+        size_t runStart = index;
+        size_t runEnd = index;
+        std::vector<Tree> trees;
+
+        for (; runEnd < program.size() && isExpression(program[runEnd]->getOpcode()); ++runEnd) {
+            eOpcode opcode = program[runEnd]->getOpcode();
+
+            if (opcode == eOpcode::Push || opcode == eOpcode::PushSlot) {
+                trees.push_back({runEnd, true});
+            } else if (trees.size() >= 2) {
+                bool closed = trees.back().closed;
+                trees.pop_back();
+                trees.back().closed = trees.back().closed && closed;
+            } else {
+                // Consumes a value from before the run: everything so far
+                // depends on it
+                trees.assign(1, {runStart, false});
+            }
+        }
+
+        // Pack consecutive expressions of the same shape
+        for (size_t tree = 0; tree < trees.size();) {
+            size_t start = trees[tree].start;
+            size_t end = (tree + 1 < trees.size()) ? trees[tree + 1].start : runEnd;
+            size_t length = end - start;
+            size_t lanes = 1;
+
+            while (trees[tree].closed && length >= 2 && tree + lanes < trees.size()) {
+                const Tree& next = trees[tree + lanes];
+                size_t nextEnd = (tree + lanes + 1 < trees.size()) ? trees[tree + lanes + 1].start : runEnd;
+                bool same = next.closed && nextEnd - next.start == length;
+
+                for (size_t offset = 0; same && offset < length; ++offset) {
+                    same = shapeOf(*program[start + offset]) == shapeOf(*program[next.start + offset]);
+                }
+                if (!same) {
+                    break;
+                }
+                ++lanes;
+            }
+
+            if (lanes >= 2) {
+                std::vector<std::unique_ptr<ICommand>> commands;
+                for (size_t offset = 0; offset < lanes * length; ++offset) {
+                    commands.push_back(std::move(program[start + offset]));
+                }
+                output.push_back(std::make_unique<PackedCommand>(_vm, std::move(commands), lanes));
+                regions.push_back({start, start + lanes * length - 1, lanes, length});
+            } else {
+                for (size_t offset = start; offset < end; ++offset) {
+                    output.push_back(std::move(program[offset]));
+                }
+            }
+            tree += lanes;
+        }
+        index = runEnd;
+    }
+
+    program = std::move(output);
+    return regions;
+}
+
+std::string SuperwordPass::describe(const Region& region) {
+    return "superword: instructions " + std::to_string(region.first + 1) + "-" +
+           std::to_string(region.last + 1) + " packed as " + std::to_string(region.lanes) +
+           " lanes x " + std::to_string(region.length) + " instructions";
+}
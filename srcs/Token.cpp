@@ -35,6 +35,23 @@ std::string Token::tokenTypeToString(TokenType type) {
         case TokenType::MOD: return "MOD";
         case TokenType::PRINT: return "PRINT";
         case TokenType::EXIT: return "EXIT";
+        case TokenType::READ: return "READ";
+        case TokenType::FORK: return "FORK";
+        case TokenType::ENDFORK: return "ENDFORK";
+        case TokenType::JOIN: return "JOIN";
+        case TokenType::SEND: return "SEND";
+        case TokenType::RECV: return "RECV";
+        case TokenType::USE: return "USE";
+        case TokenType::MOVE: return "MOVE";
+        case TokenType::SAVEPOINT: return "SAVEPOINT";
+        case TokenType::ROLLBACK: return "ROLLBACK";
+        case TokenType::COMMIT: return "COMMIT";
+        case TokenType::ONERROR: return "ONERROR";
+        case TokenType::ENDONERROR: return "ENDONERROR";
+        case TokenType::DUMPDELTA: return "DUMPDELTA";
+        case TokenType::INCLUDE: return "INCLUDE";
+        case TokenType::MACRO: return "MACRO";
+        case TokenType::ENDMACRO: return "ENDMACRO";
         case TokenType::INT8: return "INT8";
         case TokenType::INT16: return "INT16";
         case TokenType::INT32: return "INT32";
@@ -42,6 +59,9 @@ std::string Token::tokenTypeToString(TokenType type) {
         case TokenType::DOUBLE: return "DOUBLE";
         case TokenType::INTEGER: return "INTEGER";
         case TokenType::DECIMAL: return "DECIMAL";
+        case TokenType::PLACEHOLDER: return "PLACEHOLDER";
+        case TokenType::IDENTIFIER: return "IDENTIFIER";
+        case TokenType::STRING: return "STRING";
         case TokenType::LPAREN: return "LPAREN";
         case TokenType::RPAREN: return "RPAREN";
         case TokenType::NEWLINE: return "NEWLINE";
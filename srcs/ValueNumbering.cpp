@@ -0,0 +1,163 @@
+#include "ValueNumbering.hpp"
+#include <algorithm>
+#include <map>
+#include <tuple>
+#include <cmath>
+
+namespace {
+    /**
+     * @brief Identifies a computed value: kind, operation, type, operands and constant.
+     */
+    using Key = std::tuple<int, int, int, size_t, size_t, long double>;
+}
+
+ValueNumbering::Stats ValueNumbering::run(IRProgram& program) {
+    Stats stats{0, 0};
+
+    stats.reused = reuse(program);
+    stats.removed = eliminate(program);
+    return stats;
+}
+
+size_t ValueNumbering::reuse(IRProgram& program) {
+    std::map<Key, size_t> numbers;                              // value -> number
+    std::vector<size_t> held(program.registers, 0);             // register -> number
+    std::vector<uint32_t> holder;                               // number -> a register holding it
+    std::vector<eOperandType> types(program.registers, eOperandType::Int8); // register -> type
+    size_t reused = 0;
+
+    // Gives a fresh number to a value nothing else can be equal to
+    auto fresh = [&holder]() {
+        holder.push_back(0);
+        return holder.size() - 1;
+    };
+    fresh(); // number 0: initial register contents
+
+    for (IRInstruction& instruction : program.code) {
+        size_t number;
+
+        switch (instruction.op) {
+            case eIROp::Const:
+                // -0.0 and 0.0 are different operands; NaN equals nothing
+                if (std::isnan(instruction.value)) {
+                    number = fresh();
+                    break;
+                }
+                number = numbers.try_emplace(Key(0, std::signbit(instruction.value),
+                                                 static_cast<int>(instruction.type), 0, 0,
+                                                 instruction.value),
+                                             holder.size()).first->second;
+                if (number == holder.size()) {
+                    fresh();
+                }
+                break;
+            case eIROp::Load:
+            case eIROp::Arith: {
+                Key key;
+                if (instruction.op == eIROp::Load) {
+                    key = Key(1, 0, static_cast<int>(instruction.type), instruction.index, 0, 0);
+                } else {
+                    size_t lhs = held[instruction.lhs];
+                    size_t rhs = held[instruction.rhs];
+                    // Integer operands are exact, so add and mul commute
+                    bool commutative = (instruction.arithmetic == eArithmetic::Add ||
+                                        instruction.arithmetic == eArithmetic::Mul) &&
+                                       isInteger(types[instruction.lhs]) &&
+                                       isInteger(instruction.rhsType);
+                    if (commutative && rhs < lhs) {
+                        std::swap(lhs, rhs);
+                    }
+                    key = Key(2, static_cast<int>(instruction.arithmetic),
+                              static_cast<int>(instruction.type), lhs, rhs, 0);
+                }
+
+                auto found = numbers.find(key);
+                if (found != numbers.end() && held[holder[found->second]] == found->second) {
+                    // Already computed successfully and still in a register
+                    number = found->second;
+                    instruction.op = eIROp::Copy;
+                    instruction.lhs = holder[number];
+                    ++reused;
+                } else {
+                    number = fresh();
+                    numbers[key] = number;
+                }
+                break;
+            }
+            case eIROp::Copy:
+                number = held[instruction.lhs];
+                break;
+            case eIROp::Read:
+                number = fresh();
+                break;
+            default:
+                continue;
+        }
+
+        held[instruction.dst] = number;
+        types[instruction.dst] = instruction.type;
+        holder[number] = instruction.dst;
+    }
+    return reused;
+}
+
+size_t ValueNumbering::eliminate(IRProgram& program) {
+    std::vector<bool> live(program.registers, false);
+    std::vector<IRInstruction> code;
+    size_t removed = 0;
+
+    for (auto it = program.code.rbegin(); it != program.code.rend(); ++it) {
+        IRInstruction& instruction = *it;
+
+        switch (instruction.op) {
+            case eIROp::Const:
+            case eIROp::Copy:
+                // Cannot raise an error: removable when the result is unused
+                if (!live[instruction.dst] ||
+                    (instruction.op == eIROp::Copy && instruction.lhs == instruction.dst)) {
+                    ++removed;
+                    continue;
+                }
+                live[instruction.dst] = false;
+                if (instruction.op == eIROp::Copy) {
+                    live[instruction.lhs] = true;
+                }
+                break;
+            case eIROp::Load:
+            case eIROp::Read:
+                live[instruction.dst] = false;
+                break;
+            case eIROp::Arith:
+                live[instruction.dst] = false;
+                live[instruction.lhs] = true;
+                live[instruction.rhs] = true;
+                break;
+            case eIROp::Assert:
+            case eIROp::Print:
+                live[instruction.lhs] = true;
+                break;
+            case eIROp::Dump:
+                for (uint32_t reg = instruction.rhs; reg < instruction.lhs; ++reg) {
+                    live[reg] = true;
+                }
+                break;
+            case eIROp::Exit:
+                // The registers below the exit depth are the final stack
+                live.assign(live.size(), false);
+                std::fill(live.begin(), live.begin() + instruction.lhs, true);
+                break;
+            case eIROp::Fail:
+                live.assign(live.size(), false);
+                break;
+        }
+        code.push_back(instruction);
+    }
+
+    program.code.assign(code.rbegin(), code.rend());
+    return removed;
+}
+
+std::string ValueNumbering::describe(const Stats& stats) {
+    return "gvn: " + std::to_string(stats.reused) + " recomputations reused, " +
+           std::to_string(stats.removed) + " dead instructions removed";
+}
@@ -1,20 +1,71 @@
 #include "AbstractVM.hpp"
 #include <iostream>
 #include <fstream>
+#include <algorithm>
+#include <limits>
+#include <thread>
+#include "StackContainer.hpp"
 
-VirtualMachine::VirtualMachine() : _exitCalled(false), _verbose(false), _collectErrors(false) {}
+VirtualMachine::VirtualMachine()
+    : _stackNames{"main"}, _current(0), _exitCalled(false), _verbose(false),
+      _collectErrors(false), _optimizationLevel(0), _threads(0), _errorHandler(nullptr),
+      _frozen(1, 0), _visibleFrame(1, noFrame), _trackChanges(false), _lowestChange(1, 0),
+      _dumpFormat(eDumpFormat::Text),
+      _fastExit(false), _engineStack(false) {
+    // Stacks take their regions when the VM runs (reserveStacks)
+    _stacks.emplace_back(OperandBuffer(OperandBuffer::deferred));
+}
 
 void VirtualMachine::cleanupStack() {
-    while (!_stack.empty()) {
-        delete _stack.top();
-        _stack.pop();
+    discardSavepoints();
+    for (OperandStack& stack : _stacks) {
+        while (!stack.empty()) {
+            delete stack.top();
+            stack.pop();
+        }
+        StackContainer::of(stack).restore(0, 0);
+    }
+    _current = 0;
+    _lowestChange.assign(_lowestChange.size(), 0);
+    _engineStack = false;
+}
+
+void VirtualMachine::reserveStacks() {
+    for (OperandStack& stack : _stacks) {
+        StackContainer::of(stack).reserveRegion();
+    }
+}
+
+void VirtualMachine::releaseStacks() {
+    for (OperandStack& stack : _stacks) {
+        StackContainer::of(stack).releaseRegion();
     }
 }
 
 VirtualMachine::~VirtualMachine() {
+    discardForks();
     cleanupStack();
 }
 
+void VirtualMachine::discardForks() {
+    while (!_forks.empty()) {
+        try {
+            for (const IOperand* operand : _forks.front().get()) {
+                delete operand;
+            }
+        } catch (const std::exception&) {
+            // Errors of forks that are never joined are not reported
+        }
+        _forks.pop_front();
+    }
+}
+
+void VirtualMachine::closeChannels() {
+    for (Channel* channel : _channels) {
+        channel->close(this);
+    }
+}
+
 void VirtualMachine::validateExit() const {
     if (!_exitCalled) {
         throw AbstractVMException("Error: 'exit' instruction missing.");
@@ -29,57 +80,759 @@ void VirtualMachine::setCollectErrors(bool collect) {
     _collectErrors = collect;
 }
 
+void VirtualMachine::setFastExit(bool fastExit) {
+    _fastExit = fastExit;
+}
+
 void VirtualMachine::setExitCalled() {
     _exitCalled = true;
 }
 
+void VirtualMachine::setInput(std::unique_ptr<BinaryReader> input) {
+    _input = std::move(input);
+}
+
+BinaryReader* VirtualMachine::getInput() const {
+    return _input.get();
+}
+
+void VirtualMachine::setOptimizationLevel(int level) {
+    _optimizationLevel = level;
+}
+
+void VirtualMachine::setDumpFormat(eDumpFormat format) {
+    _dumpFormat = format;
+}
+
+eDumpFormat VirtualMachine::getDumpFormat() const {
+    return _dumpFormat;
+}
+
+void VirtualMachine::setAsyncDumps(size_t memoryLimit) {
+    _dumpQueue.reset();
+    if (memoryLimit != 0) {
+        _dumpQueue = std::make_shared<DumpQueue>(std::cout, memoryLimit);
+    }
+}
+
+DumpQueue* VirtualMachine::getDumpQueue() {
+    return _verbose ? nullptr : _dumpQueue.get();
+}
+
+void VirtualMachine::finishDumps() {
+    if (_dumpQueue) {
+        _dumpQueue->finish();
+    }
+}
+
+size_t VirtualMachine::getThreads() const {
+    return _threads ? _threads : std::max(1u, std::thread::hardware_concurrency());
+}
+
+void VirtualMachine::setThreads(size_t threads) {
+    _threads = threads;
+    if (_engine && threads != 0) {
+        _engine->setThreads(threads);
+    }
+}
+
+const std::vector<std::string>& VirtualMachine::getOptimizationReport() const {
+    return _report;
+}
+
 size_t VirtualMachine::stackSize() const {
-    return _stack.size();
+    return logicalSize(_current);
+}
+
+size_t VirtualMachine::logicalSize(size_t stack) const {
+    return _frozen[stack] + _stacks[stack].size();
+}
+
+size_t VirtualMachine::stackIndex(const std::string& name) {
+    for (size_t index = 0; index < _stackNames.size(); ++index) {
+        if (_stackNames[index] == name) {
+            return index;
+        }
+    }
+
+    _stackNames.push_back(name);
+    _stacks.emplace_back(OperandBuffer(OperandBuffer::deferred));
+    _frozen.push_back(0);
+    _visibleFrame.push_back(noFrame);
+    _lowestChange.push_back(0);
+    return _stackNames.size() - 1;
+}
+
+void VirtualMachine::useStack(size_t index) {
+    _current = index;
+}
+
+void VirtualMachine::moveValues(size_t from, size_t to, size_t count) {
+    OperandStack& source = _stacks[from];
+    OperandStack& destination = _stacks[to];
+
+    if (!_savepoints.empty()) {
+        materialize(from, count);
+    }
+    if (source.size() < count) {
+        throw InsufficientValuesException("Move requires at least " + std::to_string(count) +
+                                          " values on stack '" + _stackNames[from] + "'");
+    }
+    if (_trackChanges) {
+        markChanged(from, logicalSize(from) - count);
+        markChanged(to, logicalSize(to));
+    }
+    if (from == to || count == 0) {
+        return;
+    }
+    if (count == source.size() && destination.empty() && _savepoints.empty()) {
+        // Frozen values stay with their region: only swap without savepoints
+        source.swap(destination);
+        return;
+    }
+
+    auto& values = StackContainer::of(source);
+    auto first = values.end() - static_cast<std::ptrdiff_t>(count);
+    auto& target = StackContainer::of(destination);
+    target.insert(target.end(), first, values.end());
+    values.erase(first, values.end());
 }
 
 void VirtualMachine::run(std::istream& input, bool fromStdin) {
+    if (load(input, fromStdin)) {
+        execute();
+    }
+}
+
+void VirtualMachine::runFile(const std::string& filename) {
+    if (loadFile(filename)) {
+        execute();
+    }
+}
+
+bool VirtualMachine::load(std::istream& input, bool fromStdin, const std::string& path) {
     Lexer lexer(input, fromStdin, _collectErrors);
-    Parser parser(lexer.tokenize(), _collectErrors, this);
+    return load(lexer.tokenize(), path);
+}
+
+bool VirtualMachine::load(const std::vector<Token>& tokens, const std::string& path,
+                          std::vector<size_t>* offsets) {
+    _program.clear();
+    _report.clear();
+    _engine.reset();
+    _channels.clear();
+    _trackChanges = false;
+
+    Parser parser(tokens, _collectErrors, *this);
+    if (!path.empty()) {
+        parser.setPath(path);
+    }
     std::vector<std::unique_ptr<ICommand>> commands = parser.parse();
+    if (offsets) {
+        *offsets = parser.getOffsets();
+    }
 
     // Print collected parser errors if in error collection mode
     if (_collectErrors && parser.hasErrors()) {
         for (const auto& error : parser.getErrors()) {
             std::cerr << "Error: " << error << std::endl;
         }
-        return ;
+        return false;
+    }
+
+    _program = std::move(commands);
+    optimize();
+    return true;
+}
+
+void VirtualMachine::patch(size_t begin, size_t end,
+                           std::vector<std::unique_ptr<ICommand>> commands) {
+    // Undo expression packing, so that commands are at their parsed index
+    if (_optimizationLevel >= 1) {
+        std::vector<std::unique_ptr<ICommand>> program;
+        program.reserve(_program.size());
+        for (std::unique_ptr<ICommand>& command : _program) {
+            if (command->getOpcode() != eOpcode::Packed) {
+                program.push_back(std::move(command));
+                continue;
+            }
+            for (auto& original : static_cast<PackedCommand&>(*command).releaseCommands()) {
+                program.push_back(std::move(original));
+            }
+        }
+        _program = std::move(program);
+    }
+
+    auto first = _program.begin() + static_cast<std::ptrdiff_t>(begin);
+    if (commands.size() == end - begin) {
+        // Same size: no need to shift the rest of the program
+        std::move(commands.begin(), commands.end(), first);
+    } else {
+        first = _program.erase(first, first + static_cast<std::ptrdiff_t>(end - begin));
+        _program.insert(first, std::make_move_iterator(commands.begin()),
+                        std::make_move_iterator(commands.end()));
+    }
+
+    _report.clear();
+    _engine.reset();
+    optimize();
+}
+
+void VirtualMachine::optimize() {
+    IRProgram ir{};
+    bool translated = false;
+
+    // Handlers resume after the failing instruction, which must not be merged with others
+    for (const auto& command : _program) {
+        if (_optimizationLevel >= 1 && command->getOpcode() == eOpcode::OnError) {
+            _report.push_back("optimisation: not used: program has error handlers");
+            return;
+        }
+    }
+
+    if (_optimizationLevel >= 2) {
+        try {
+            ir = translateToIR(_program);
+            translated = true;
+        } catch (const std::invalid_argument& e) {
+            _report.push_back(std::string("ir: not used: ") + e.what());
+        }
+    }
+
+    if (translated) {
+        // The register engine subsumes expression packing
+        _report.push_back("ir: " + std::to_string(ir.sourceSize) + " stack instructions -> " +
+                          std::to_string(ir.code.size()) + " register instructions, " +
+                          std::to_string(ir.registers) + " registers");
+        if (_optimizationLevel >= 3) {
+            ValueNumbering gvn;
+            _report.push_back(ValueNumbering::describe(gvn.run(ir)));
+        }
+        _engine = std::make_unique<RegisterEngine>(*this, std::move(ir));
+        if (_threads != 0) {
+            _engine->setThreads(_threads);
+        }
+        _report.push_back("segments: " + std::to_string(_engine->getSegmentCount()) +
+                          " independent segments in " + std::to_string(_engine->getTaskCount()) +
+                          " tasks");
+    } else if (_optimizationLevel >= 1) {
+        SuperwordPass superword(this);
+        for (const SuperwordPass::Region& region : superword.run(_program)) {
+            _report.push_back(SuperwordPass::describe(region));
+        }
+    }
+}
+
+bool VirtualMachine::loadFile(const std::string& filename) {
+    std::ifstream file(filename);
+    if (!file.is_open()) {
+        throw std::runtime_error("Error: Unable to open file " + filename);
+    }
+    return load(file, false, filename);
+}
+
+void VirtualMachine::execute() {
+    if (_fastExit) {
+        cleanupStack(); // values left by the previous run
+    }
+    _exitCalled = false;
+    _errorHandler = nullptr;
+    for (Channel* channel : _channels) {
+        channel->open(this);
     }
 
     try {
-        executeCommands(commands);
+        reserveStacks();
+        if (_engine && !_verbose) {
+            _engineStack = true;
+            _engine->run();
+        } else {
+            executeCommands(_program);
+        }
         validateExit();
+        finishDumps();
     } catch (const AbstractVMException& e) {
+        try {
+            finishDumps(); // the output comes before the error
+        } catch (const OutputException&) {
+            // The output is cut short; the error being handled is reported
+        }
         if (!_collectErrors) {
+            closeChannels();
+            discardForks();
+            cleanupStack();
             throw;
         } else {
             std::cerr << "Error: " << e.what() << std::endl;
         }
     }
 
-    cleanupStack();
+    closeChannels();
+    discardForks();
+    if (!_fastExit) {
+        cleanupStack();
+    }
 }
 
-void VirtualMachine::runFile(const std::string& filename) {
-    std::ifstream file(filename);
-    if (!file.is_open()) {
-        throw std::runtime_error("Error: Unable to open file " + filename);
+const std::vector<std::unique_ptr<ICommand>>& VirtualMachine::getProgram() const {
+    return _program;
+}
+
+const std::vector<std::string>& VirtualMachine::getStackNames() const {
+    return _stackNames;
+}
+
+const OperandBuffer& VirtualMachine::getStack(size_t index) {
+    if (index == 0 && _engineStack) {
+        // The register engine keeps the final stack in its registers
+        _engineStack = false;
+        std::vector<Scalar> values = _engine->takeFinalStack();
+        StackContainer::of(_stacks[0]).reserve(values.size());
+        for (const Scalar& value : values) {
+            _stacks[0].push(_factory.createOperand(value.type, value.value));
+        }
+    }
+    materialize(index, std::numeric_limits<size_t>::max());
+    return StackContainer::of(_stacks[index]);
+}
+
+size_t VirtualMachine::placeholderSlot(const std::string& name) {
+    for (size_t slot = 0; slot < _slotNames.size(); ++slot) {
+        if (_slotNames[slot] == name) {
+            return slot;
+        }
+    }
+
+    _slotNames.push_back(name);
+    _slotValues.push_back(0);
+    _slotBound.push_back(false);
+    return _slotNames.size() - 1;
+}
+
+void VirtualMachine::bind(const std::string& name, long double value) {
+    size_t slot = placeholderSlot(name);
+    _slotValues[slot] = value;
+    _slotBound[slot] = true;
+}
+
+void VirtualMachine::bind(const std::string& name, const std::string& value) {
+    bind(name, parseBinding(name, value));
+}
+
+long double VirtualMachine::parseBinding(const std::string& name, const std::string& value) {
+    long double number = 0;
+    bool valid = Lexer::isNumber(value); // same grammar as the literals of the program
+
+    if (valid) {
+        try {
+            number = std::stold(value);
+        } catch (const std::exception&) {
+            valid = false; // beyond the range of long double
+        }
     }
-    run(file, false);
+    if (!valid) {
+        throw PlaceholderException("Invalid value '" + value + "' for placeholder $" + name);
+    }
+    return number;
+}
+
+void VirtualMachine::clearBindings() {
+    _slotBound.assign(_slotBound.size(), false);
+}
+
+long double VirtualMachine::getBinding(size_t slot) const {
+    if (!_slotBound[slot]) {
+        throw PlaceholderException("Unbound placeholder $" + _slotNames[slot]);
+    }
+    return _slotValues[slot];
 }
 
-void VirtualMachine::executeCommands(std::vector<std::unique_ptr<ICommand>>& commands) {
-    for (const auto& command : commands) {
-        command->execute(_stack);
-        if (_verbose) {
-            std::cout << "Executed command. Stack size: " << _stack.size() << std::endl;
+void VirtualMachine::executeCommands(const std::vector<std::unique_ptr<ICommand>>& commands) {
+    size_t index = 0;
+
+    // The try block costs nothing until an instruction throws
+    while (index < commands.size()) {
+        try {
+            for (; index < commands.size(); ++index) {
+                executeCommand(*commands[index]);
+                if (_verbose) {
+                    std::cout << "Executed command. Stack size: " << stackSize() << std::endl;
+                }
+                if (_exitCalled) {
+                    return;
+                }
+            }
+        } catch (const AbstractVMException& e) {
+            if (!_errorHandler) {
+                throw;
+            }
+            handleError(e);
+            if (_exitCalled) {
+                return;
+            }
+            ++index; // resume after the failing instruction
         }
+    }
+}
+
+void VirtualMachine::handleError(const AbstractVMException& error) {
+    const std::vector<std::unique_ptr<ICommand>>& handler = *_errorHandler;
+
+    if (_trackChanges) {
+        markChanged(_current, logicalSize(_current));
+    }
+    _stacks[_current].push(_factory.createOperand(eOperandType::Int8,
+                                                  static_cast<long double>(errorCode(error))));
+    for (const auto& command : handler) {
+        executeCommand(*command);
         if (_exitCalled) {
+            return;
+        }
+    }
+}
+
+void VirtualMachine::setErrorHandler(const std::vector<std::unique_ptr<ICommand>>* handler) {
+    _errorHandler = handler;
+}
+
+
+std::vector<const IOperand*> VirtualMachine::runBlock(const std::vector<std::unique_ptr<ICommand>>& commands,
+                                                      const std::vector<const IOperand*>& arguments) {
+    try {
+        reserveStacks();
+        auto& stack = StackContainer::of(_stacks[_current]);
+        stack.insert(stack.end(), arguments.data(), arguments.data() + arguments.size());
+    } catch (...) {
+        for (const IOperand* argument : arguments) {
+            delete argument;
+        }
+        releaseStacks();
+        throw;
+    }
+    _errorHandler = nullptr;
+    for (Channel* channel : _channels) {
+        channel->open(this);
+    }
+
+    try {
+        executeCommands(commands);
+    } catch (...) {
+        closeChannels();
+        discardForks();
+        cleanupStack();
+        releaseStacks();
+        throw;
+    }
+    closeChannels();
+    discardForks();
+
+    // The block's result is the stack it ended on
+    materialize(_current, std::numeric_limits<size_t>::max());
+    OperandStack& stack = _stacks[_current];
+    std::vector<const IOperand*> results(stack.size());
+    for (size_t index = results.size(); index-- > 0;) {
+        results[index] = stack.top();
+        stack.pop();
+    }
+    cleanupStack();
+    releaseStacks(); // the child VM stays idle until the fork runs again
+    return results;
+}
+
+void VirtualMachine::inheritBindings(const VirtualMachine& parent) {
+    for (size_t slot = 0; slot < _slotNames.size(); ++slot) {
+        _slotBound[slot] = false;
+        for (size_t other = 0; other < parent._slotNames.size(); ++other) {
+            if (parent._slotNames[other] == _slotNames[slot] && parent._slotBound[other]) {
+                _slotValues[slot] = parent._slotValues[other];
+                _slotBound[slot] = true;
+            }
+        }
+    }
+}
+
+void VirtualMachine::inheritDumps(const VirtualMachine& parent) {
+    _dumpQueue = parent._verbose ? nullptr : parent._dumpQueue;
+}
+
+void VirtualMachine::executeCommand(ICommand& command) {
+    if (!_savepoints.empty()) {
+        materialize(_current, requiredDepth(command));
+    }
+    if (_trackChanges) {
+        trackChange(command);
+    }
+    command.execute(_stacks[_current]);
+    if (OperandBuffer::faulted()) {
+        settleStacks();
+    }
+}
+
+void VirtualMachine::settleStacks() {
+    std::exception_ptr error;
+    bool passed = false;
+
+    // Every stack is settled, even after an error: none keeps its spare area open
+    OperandBuffer::clearFault();
+    for (OperandStack& stack : _stacks) {
+        try {
+            passed = StackContainer::of(stack).settle() || passed;
+        } catch (const StackLimitException&) {
+            error = std::current_exception();
+        }
+    }
+    if (passed) {
+        throw StackLimitException(OperandBuffer::limitMessage());
+    }
+    if (error) {
+        std::rethrow_exception(error);
+    }
+}
+
+void VirtualMachine::trackChange(const ICommand& command) {
+    size_t depth;
+
+    switch (command.getOpcode()) {
+        case eOpcode::Dump: {
+            const auto& dump = static_cast<const DumpCommand&>(command);
+            if (dump.getCount() == DumpCommand::all && dump.getPath().empty()) {
+                takeLowestChange(); // a full dump is a new reference for dumpdelta
+            }
+            return;
+        }
+        case eOpcode::DumpDelta:
+        case eOpcode::Assert:
+        case eOpcode::Print:
+        case eOpcode::Exit:
+        case eOpcode::Use:
+        case eOpcode::Move: // moveValues() records its own changes
+        case eOpcode::Savepoint:
+        case eOpcode::Rollback: // rollback() records its own changes
+        case eOpcode::Commit:
+        case eOpcode::OnError:
+            return;
+        case eOpcode::Push:
+        case eOpcode::PushSlot:
+        case eOpcode::Read:
+        case eOpcode::Recv:
+        case eOpcode::Join:
+            depth = 0;
+            break;
+        case eOpcode::Pop:
+        case eOpcode::Send:
+            depth = 1;
+            break;
+        case eOpcode::Add:
+        case eOpcode::Sub:
+        case eOpcode::Mul:
+        case eOpcode::Div:
+        case eOpcode::Mod:
+            depth = 2;
             break;
+        case eOpcode::Fork:
+            depth = static_cast<const ForkCommand&>(command).getCount();
+            break;
+        default: // packed commands may rewrite the whole stack
+            depth = std::numeric_limits<size_t>::max();
+            break;
+    }
+
+    size_t size = logicalSize(_current);
+    markChanged(_current, size - std::min(depth, size));
+}
+
+void VirtualMachine::markChanged(size_t stack, size_t position) {
+    _lowestChange[stack] = std::min(_lowestChange[stack], position);
+}
+
+void VirtualMachine::enableChangeTracking() {
+    _trackChanges = true;
+}
+
+size_t VirtualMachine::takeLowestChange() {
+    size_t lowest = _lowestChange[_current];
+
+    _lowestChange[_current] = logicalSize(_current);
+    return lowest;
+}
+
+size_t VirtualMachine::requiredDepth(const ICommand& command) {
+    switch (command.getOpcode()) {
+        case eOpcode::Push:
+        case eOpcode::PushSlot:
+        case eOpcode::Read:
+        case eOpcode::Recv:
+        case eOpcode::Exit:
+        case eOpcode::Join:
+        case eOpcode::Use:
+        case eOpcode::Move: // moveValues() materializes its source
+        case eOpcode::Savepoint:
+        case eOpcode::Rollback:
+        case eOpcode::Commit:
+            return 0;
+        case eOpcode::Pop:
+        case eOpcode::Assert:
+        case eOpcode::Print:
+        case eOpcode::Send:
+            return 1;
+        case eOpcode::Add:
+        case eOpcode::Sub:
+        case eOpcode::Mul:
+        case eOpcode::Div:
+        case eOpcode::Mod:
+            return 2;
+        case eOpcode::Fork:
+            return static_cast<const ForkCommand&>(command).getCount();
+        case eOpcode::Dump:
+            return static_cast<const DumpCommand&>(command).getCount();
+        default: // dumpdelta and packed commands see the whole stack
+            return std::numeric_limits<size_t>::max();
+    }
+}
+
+void VirtualMachine::materialize(size_t stack, size_t depth) {
+    auto& live = StackContainer::of(_stacks[stack]);
+    size_t& frozen = _frozen[stack];
+
+    if (live.size() >= depth || frozen == 0) {
+        return;
+    }
+
+    // Copy from the top of the visible frozen values, frame by frame
+    size_t count = std::min(depth - live.size(), frozen);
+    live.insert(live.begin(), count, nullptr);
+    for (size_t offset = count; offset-- > 0;) {
+        const Frame& frame = _savepoints[_visibleFrame[stack]].frames[stack];
+        --frozen;
+        live[offset] = live.base()[frame.first + (frozen - frame.base)]->clone();
+        if (frozen == frame.base) {
+            _visibleFrame[stack] = frame.parent;
+        }
+    }
+}
+
+void VirtualMachine::savepoint() {
+    Savepoint saved{std::vector<Frame>(_stacks.size()), _current};
+
+    for (size_t stack = 0; stack < _stacks.size(); ++stack) {
+        auto& live = StackContainer::of(_stacks[stack]);
+        size_t first = static_cast<size_t>(live.begin() - live.base());
+
+        saved.frames[stack] = Frame{first, first + live.size(), _frozen[stack], _visibleFrame[stack]};
+        if (!live.empty()) {
+            _visibleFrame[stack] = _savepoints.size();
+        }
+        _frozen[stack] += live.size();
+        live.freeze();
+    }
+    _savepoints.push_back(std::move(saved));
+}
+
+void VirtualMachine::rollback() {
+    if (_savepoints.empty()) {
+        throw SavepointException("Rollback without a savepoint");
+    }
+
+    Savepoint& saved = _savepoints.back();
+    for (size_t stack = 0; stack < _stacks.size(); ++stack) {
+        auto& live = StackContainer::of(_stacks[stack]);
+        _lowestChange[stack] = 0;
+        for (const IOperand* operand : live) {
+            delete operand;
+        }
+        live.clear();
+        if (stack >= saved.frames.size()) {
+            continue;
+        }
+        const Frame& frame = saved.frames[stack];
+        live.restore(frame.first, frame.last);
+        _frozen[stack] = frame.base;
+        _visibleFrame[stack] = frame.parent;
+    }
+    _current = saved.current;
+    _savepoints.pop_back();
+}
+
+void VirtualMachine::commit() {
+    if (_savepoints.empty()) {
+        throw SavepointException("Commit without a savepoint");
+    }
+
+    Savepoint& saved = _savepoints.back();
+    for (size_t stack = 0; stack < saved.frames.size(); ++stack) {
+        const Frame& frame = saved.frames[stack];
+        auto& live = StackContainer::of(_stacks[stack]);
+        OperandBuffer::iterator values = live.base();
+        size_t visible = _frozen[stack] > frame.base ? _frozen[stack] - frame.base : 0;
+        size_t start = static_cast<size_t>(live.begin() - values);
+        size_t size = live.size();
+
+        // Values already copied to the stack are no longer needed
+        for (size_t index = frame.first + visible; index < frame.last; ++index) {
+            delete values[index];
+        }
+
+        // Join the visible values and the live ones, moving the shorter part
+        if (visible < size) {
+            std::copy_backward(values + frame.first, values + frame.first + visible, values + start);
+            live.restore(start - visible, start + size);
+        } else {
+            std::copy(values + start, values + start + size, values + frame.first + visible);
+            live.restore(frame.first, frame.first + visible + size);
+        }
+        _frozen[stack] = std::min(_frozen[stack], frame.base);
+        if (_visibleFrame[stack] == _savepoints.size() - 1) {
+            _visibleFrame[stack] = frame.parent;
+        }
+    }
+    _savepoints.pop_back();
+}
+
+void VirtualMachine::discardSavepoints() {
+    for (Savepoint& saved : _savepoints) {
+        for (size_t stack = 0; stack < saved.frames.size(); ++stack) {
+            OperandBuffer::iterator values = StackContainer::of(_stacks[stack]).base();
+            for (size_t index = saved.frames[stack].first; index < saved.frames[stack].last; ++index) {
+                delete values[index];
+            }
         }
     }
+    _savepoints.clear();
+    _frozen.assign(_frozen.size(), 0);
+    _visibleFrame.assign(_visibleFrame.size(), noFrame);
+}
+
+void VirtualMachine::setChannels(std::shared_ptr<ChannelRegistry> channels) {
+    _channelRegistry = std::move(channels);
+}
+
+std::shared_ptr<ChannelRegistry> VirtualMachine::getChannels() {
+    if (!_channelRegistry) {
+        _channelRegistry = std::make_shared<ChannelRegistry>();
+    }
+    return _channelRegistry;
+}
+
+Channel& VirtualMachine::attachChannel(const std::string& name, bool sender) {
+    Channel& channel = getChannels()->get(name);
+
+    channel.attach(this, sender);
+    if (std::find(_channels.begin(), _channels.end(), &channel) == _channels.end()) {
+        _channels.push_back(&channel);
+    }
+    return channel;
+}
+
+void VirtualMachine::startFork(std::future<std::vector<const IOperand*>> result) {
+    _forks.push_back(std::move(result));
+}
+
+std::vector<const IOperand*> VirtualMachine::joinFork() {
+    if (_forks.empty()) {
+        throw ForkException("Join without a pending fork");
+    }
+
+    std::future<std::vector<const IOperand*>> result = std::move(_forks.front());
+    _forks.pop_front();
+    return result.get();
 }
\ No newline at end of file
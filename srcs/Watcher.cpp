@@ -0,0 +1,271 @@
+#include "Watcher.hpp"
+#include "VirtualMachine.hpp"
+#include "Lexer.hpp"
+#include "Parser.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <string_view>
+#include <thread>
+#ifdef LINUX
+# include <sys/inotify.h>
+# include <unistd.h>
+#endif
+
+Watcher::Watcher(VirtualMachine& vm, const std::string& path)
+    : _vm(vm), _path(path), _structural(0), _exits(0), _loaded(false), _notify(-1) {}
+
+Watcher::~Watcher() {
+#ifdef LINUX
+    if (_notify >= 0) {
+        close(_notify);
+    }
+#endif
+}
+
+void Watcher::run() {
+    for (;;) {
+        if (update()) {
+            try {
+                _vm.execute();
+            } catch (const std::exception& e) {
+                std::cerr << "Error: " << e.what() << std::endl;
+            }
+        }
+        wait();
+    }
+}
+
+void Watcher::wait() {
+    std::filesystem::path path(_path);
+#ifdef LINUX
+    // Editors often save to a new file renamed over the old one: watch the directory
+    std::filesystem::path directory = path.parent_path().empty() ? "." : path.parent_path();
+
+    if (_notify < 0) {
+        _notify = inotify_init1(IN_CLOEXEC);
+        if (_notify < 0 ||
+            inotify_add_watch(_notify, directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO) < 0) {
+            throw std::runtime_error("Unable to watch " + directory.string());
+        }
+    }
+
+    alignas(inotify_event) char buffer[4096];
+    for (;;) {
+        ssize_t length = read(_notify, buffer, sizeof(buffer));
+        if (length <= 0) {
+            throw std::runtime_error("Unable to watch " + directory.string());
+        }
+        for (ssize_t offset = 0; offset < length;) {
+            const inotify_event* event = reinterpret_cast<const inotify_event*>(buffer + offset);
+            if (event->len > 0 && path.filename() == event->name) {
+                return;
+            }
+            offset += static_cast<ssize_t>(sizeof(inotify_event) + event->len);
+        }
+    }
+#else
+    std::error_code error;
+    std::filesystem::file_time_type modified = std::filesystem::last_write_time(path, error);
+    std::uintmax_t size = std::filesystem::file_size(path, error);
+
+    for (;;) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        if (std::filesystem::last_write_time(path, error) != modified ||
+            std::filesystem::file_size(path, error) != size) {
+            return;
+        }
+    }
+#endif
+}
+
+std::vector<Token> Watcher::lex(const std::string& text) {
+    std::istringstream input(text);
+    Lexer lexer(input, false, true);
+    std::vector<Token> tokens = lexer.tokenize();
+
+    tokens.pop_back(); // END_FILE
+    return tokens;
+}
+
+bool Watcher::isStructural(const std::vector<Token>& tokens) {
+    for (const Token& token : tokens) {
+        switch (token.getType()) {
+            case TokenType::FORK:
+            case TokenType::ENDFORK:
+            case TokenType::ONERROR:
+            case TokenType::ENDONERROR:
+            case TokenType::INCLUDE:
+            case TokenType::MACRO:
+            case TokenType::ENDMACRO:
+                return true;
+            default:
+                break;
+        }
+    }
+    return false;
+}
+
+size_t Watcher::countExits(const std::vector<Token>& tokens) {
+    size_t exits = 0;
+
+    for (const Token& token : tokens) {
+        exits += token.getType() == TokenType::EXIT;
+    }
+    return exits;
+}
+
+std::vector<Token> Watcher::tokens(size_t first, size_t count) const {
+    std::vector<Token> tokens;
+
+    // Lines were lexed alone, at line 1: number them like the whole file
+    for (size_t line = first; line < first + count; ++line) {
+        for (const Token& token : _lines[line]) {
+            tokens.emplace_back(token.getType(), token.getValue(), token.getLine() + line,
+                                token.getColumn());
+        }
+    }
+    tokens.emplace_back(TokenType::END_FILE, "", first + count + 1, 1);
+    return tokens;
+}
+
+bool Watcher::update() {
+    std::ifstream file(_path, std::ios::binary);
+    if (!file.is_open()) {
+        std::cerr << "Error: Unable to open file " << _path << std::endl;
+        return false;
+    }
+    std::string content(static_cast<size_t>(std::filesystem::file_size(_path)), '\0');
+    file.read(content.data(), static_cast<std::streamsize>(content.size()));
+    content.resize(static_cast<size_t>(file.gcount()));
+
+    // Each line with its newline, so that adding a final newline is a change
+    std::vector<size_t> starts(1, 0);
+    starts.reserve(_hashes.size() + 2);
+    for (const char* begin = content.data(), * end = begin + content.size(); begin < end;) {
+        const void* newline = std::memchr(begin, '\n', static_cast<size_t>(end - begin));
+        begin = newline ? static_cast<const char*>(newline) + 1 : end;
+        starts.push_back(static_cast<size_t>(begin - content.data()));
+    }
+    auto text = [&](size_t line) {
+        return std::string_view(content.data() + starts[line], starts[line + 1] - starts[line]);
+    };
+    std::vector<uint64_t> hashes(starts.size() - 1);
+    for (size_t line = 0; line < hashes.size(); ++line) {
+        hashes[line] = std::hash<std::string_view>()(text(line));
+    }
+
+    // The changed lines are those between the common prefix and suffix
+    size_t common = std::min(hashes.size(), _hashes.size());
+    size_t prefix = 0;
+    while (prefix < common && hashes[prefix] == _hashes[prefix]) {
+        ++prefix;
+    }
+    size_t suffix = 0;
+    while (suffix < common - prefix &&
+           hashes[hashes.size() - 1 - suffix] == _hashes[_hashes.size() - 1 - suffix]) {
+        ++suffix;
+    }
+    size_t removed = _hashes.size() - prefix - suffix;
+    size_t count = hashes.size() - prefix - suffix;
+
+    std::vector<std::vector<Token>> lines(count);
+    for (size_t line = 0; line < count; ++line) {
+        lines[line] = lex(std::string(text(prefix + line)));
+    }
+
+    bool structural = _structural > 0;
+    size_t begin = 0;
+    size_t end = 0;
+    for (size_t line = 0; line < prefix + removed; ++line) {
+        (line < prefix ? begin : end) += _commands[line];
+    }
+    end += begin;
+    for (size_t line = prefix; line < prefix + removed; ++line) {
+        _structural -= isStructural(_lines[line]);
+        _exits -= countExits(_lines[line]);
+    }
+    for (const std::vector<Token>& line : lines) {
+        _structural += isStructural(line);
+        _exits += countExits(line);
+    }
+    structural = structural || _structural > 0;
+
+    auto first = static_cast<std::ptrdiff_t>(prefix);
+    auto last = static_cast<std::ptrdiff_t>(prefix + removed);
+    _hashes = std::move(hashes);
+    if (count == removed) {
+        // Lines edited in place: no need to shift the following ones
+        std::move(lines.begin(), lines.end(), _lines.begin() + first);
+        std::fill(_commands.begin() + first, _commands.begin() + last, 0);
+    } else {
+        _lines.erase(_lines.begin() + first, _lines.begin() + last);
+        _lines.insert(_lines.begin() + first, std::make_move_iterator(lines.begin()),
+                      std::make_move_iterator(lines.end()));
+        _commands.erase(_commands.begin() + first, _commands.begin() + last);
+        _commands.insert(_commands.begin() + first, count, 0);
+    }
+
+    // Straight-line programs are patched; others are parsed again
+    bool patched = _loaded && !structural;
+    bool loaded = false;
+    try {
+        loaded = patched ? patch(prefix, count, begin, end) : reload();
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+    }
+    _loaded = loaded;
+    if (patched && _exits == 0) {
+        std::cerr << "Error: Program must end with 'exit' instruction" << std::endl;
+        loaded = false;
+    }
+    return loaded;
+}
+
+bool Watcher::patch(size_t first, size_t count, size_t begin, size_t end) {
+    Parser parser(tokens(first, count), true, _vm);
+    std::vector<std::unique_ptr<ICommand>> commands = parser.parseStatements();
+
+    if (parser.hasErrors()) {
+        for (const std::string& error : parser.getErrors()) {
+            std::cerr << "Error: " << error << std::endl;
+        }
+        return false;
+    }
+    countCommands(first, parser.getOffsets());
+    _vm.patch(begin, end, std::move(commands));
+    return true;
+}
+
+bool Watcher::reload() {
+    std::vector<size_t> offsets;
+
+    if (!_vm.load(tokens(0, _lines.size()), _path, &offsets)) {
+        return false;
+    }
+    _commands.assign(_lines.size(), 0);
+    countCommands(0, offsets);
+    return true;
+}
+
+void Watcher::countCommands(size_t first, const std::vector<size_t>& offsets) {
+    // Token lines are not reliable here: a keyword ending a line takes the next one
+    if (offsets.empty()) {
+        return;
+    }
+    size_t line = first;
+    size_t end = _lines[first].size();
+
+    for (size_t offset : offsets) {
+        while (offset >= end) {
+            end += _lines[++line].size();
+        }
+        ++_commands[line];
+    }
+}
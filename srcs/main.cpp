@@ -1,22 +1,347 @@
+#include <charconv>
+#include <climits>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
 #include <iostream>
 #include <fstream>
+#include <string>
+#include <sstream>
+#include <utility>
+#include <vector>
+#include <thread>
 #include "VirtualMachine.hpp"
+#include "BatchEngine.hpp"
+#include "Watcher.hpp"
+#include "LanguageServer.hpp"
+
+namespace {
+    /**
+     * @brief Prints the command line usage on the error stream.
+     * @param name The program name (argv[0])
+     */
+    void printUsage(const char* name) {
+        std::cerr << "Usage: " << name << " [options] [file [values...]]" << std::endl
+                  << "Options:" << std::endl
+                  << "  --input <path>     Binary input stream consumed by 'read'" << std::endl
+                  << "  --input-fd <fd>    Same, from an open file descriptor" << std::endl
+                  << "  --set <name>=<v>   Bind placeholder $name to v" << std::endl
+                  << "  --batch <path>     Run the program once per line of path, binding" << std::endl
+                  << "                     the values of the line to $1, $2, ..." << std::endl
+                  << "  -O0 ... -O3        Optimisation level (default 0)" << std::endl
+                  << "  --threads <n>      Threads running independent segments at -O2 and" << std::endl
+                  << "                     above and formatting large dumps (default: one" << std::endl
+                  << "                     per core)" << std::endl
+                  << "  --stack-limit <n>  Maximum number of values of a stack, up to 2^33" << std::endl
+                  << "                     (default 33422848)" << std::endl
+                  << "  --report           Print the optimisations applied to the program" << std::endl
+                  << "  --stage <path>     Run another program concurrently, sharing channels" << std::endl
+                  << "                     with the main one (repeatable); -O, --threads," << std::endl
+                  << "                     --set and the dump options apply to every" << std::endl
+                  << "                     stage, the input and the values after the" << std::endl
+                  << "                     file only to the main program" << std::endl
+                  << "  --dump-format=<f>  Output of 'dump': text (default), binary, jsonl" << std::endl
+                  << "                     or csv" << std::endl
+                  << "  --async-dump[=<m>] Write dumps on a background thread, with at most" << std::endl
+                  << "                     m MiB of pending snapshots (default 64)" << std::endl
+                  << "  --watch            Run the file again each time it changes" << std::endl
+                  << "  --lsp              Serve diagnostics and stack hovers to an editor" << std::endl
+                  << "                     (Language Server Protocol on stdin/stdout)" << std::endl
+                  << "  --fast-exit        Exit without freeing the final stack and the" << std::endl
+                  << "                     program (default)" << std::endl
+                  << "  --no-fast-exit     Free them before exiting" << std::endl
+                  << "Values after the file are bound to $1, $2, ..." << std::endl;
+    }
+
+    /**
+     * @brief Ends the process once the output is flushed, without running destructors.
+     *
+     * Freeing a deep final stack and a large program takes time
+     * proportional to their size, for memory the system reclaims anyway.
+     *
+     * @param status The process exit status
+     */
+    [[noreturn]] void exitNow(int status) {
+        std::cout.flush();
+        std::cerr.flush();
+        std::fflush(nullptr);
+        std::_Exit(status);
+    }
+
+    /**
+     * @brief Parses the number given to an option.
+     * @param text The option value
+     * @param max Largest value accepted
+     * @param value Receives the number
+     * @return bool False unless the whole text is a decimal number up to max
+     */
+    bool parseCount(const std::string& text, size_t max, size_t& value) {
+        const char* end = text.data() + text.size();
+        auto [stop, error] = std::from_chars(text.data(), end, value);
+
+        return !text.empty() && error == std::errc() && stop == end && value <= max;
+    }
+    /**
+     * @brief Runs the loaded program over the input sets of a batch file.
+     *
+     * Each line of the file is one lane; its whitespace-separated values are
+     * bound to $1, $2, ... and checked like the values given after the file.
+     * A line with fewer values leaves the others to --set, as a direct run
+     * would. The final stack of each lane is printed like 'dump' under a
+     * "[lane N]" header, and lane errors go to stderr.
+     *
+     * @param vm The VM holding the loaded program
+     * @param path Path of the batch file
+     * @return int The process exit status
+     * @throws std::runtime_error if a value is invalid, naming its line
+     */
+    int runBatch(VirtualMachine& vm, const std::string& path) {
+        std::ifstream file(path);
+        if (!file.is_open()) {
+            throw std::runtime_error("Error: Unable to open batch file " + path);
+        }
+
+        std::vector<std::vector<long double>> columns;
+        std::vector<std::vector<bool>> present;
+        std::string line;
+        size_t lanes = 0;
+
+        while (std::getline(file, line)) {
+            std::istringstream values(line);
+            std::string value;
+            size_t position = 0;
+
+            while (values >> value) {
+                if (position == columns.size()) {
+                    columns.emplace_back(lanes, 0.0L);
+                    present.emplace_back(lanes, false);
+                }
+                try {
+                    std::string name = std::to_string(position + 1);
+                    columns[position].push_back(VirtualMachine::parseBinding(name, value));
+                } catch (const PlaceholderException& e) {
+                    throw std::runtime_error("Batch file " + path + " line " + std::to_string(lanes + 1) +
+                                             ": " + e.what());
+                }
+                present[position++].push_back(true);
+            }
+            for (; position < columns.size(); ++position) {
+                columns[position].push_back(0.0L);
+                present[position].push_back(false);
+            }
+            ++lanes;
+        }
+
+        BatchEngine batch(vm);
+        for (size_t position = 0; position < columns.size(); ++position) {
+            batch.bind(std::to_string(position + 1), std::move(columns[position]),
+                       std::move(present[position]));
+        }
+
+        std::vector<BatchEngine::LaneResult> results = batch.run();
+        for (size_t lane = 0; lane < results.size(); ++lane) {
+            if (results[lane].error) {
+                try {
+                    std::rethrow_exception(results[lane].error);
+                } catch (const std::exception& e) {
+                    std::cerr << "Error: lane " << lane << ": " << e.what() << std::endl;
+                }
+                continue;
+            }
+            std::cout << "[lane " << lane << "]" << '\n';
+            const std::vector<Scalar>& stack = results[lane].stack;
+            for (const Scalar& value : stack) {
+                std::cout << formatValue(value.type, value.value) << '\n';
+            }
+        }
+        std::cout.flush();
+        return 0;
+    }
+
+    /**
+     * @brief Runs a pipeline stage, reporting its errors on stderr.
+     * @param stage The VM holding the stage program
+     */
+    void runStage(VirtualMachine& stage) {
+        try {
+            stage.execute();
+        } catch (const std::exception& e) {
+            std::cerr << "Error: " << e.what() << std::endl;
+        }
+    }
+}
 
 int main(int argc, char** argv) {
     try {
         VirtualMachine vm;
+        const char* filename = nullptr;
+        int position = 0;
+        const char* batchFile = nullptr;
+        bool report = false;
+        auto channels = std::make_shared<ChannelRegistry>();
+        std::vector<std::unique_ptr<VirtualMachine>> stages;
+        std::vector<const char*> stageFiles;
+        eDumpFormat dumpFormat = eDumpFormat::Text;
+        int level = 0;
+        size_t threadCount = 0;
+        size_t asyncLimit = 0;
+        std::vector<std::pair<std::string, std::string>> bindings;
+        bool watch = false;
+        bool fastExit = true;
 
         vm.setCollectErrors(true); // Enable error collection mode
-        if (argc == 2) {
+        vm.setChannels(channels);
+        for (int i = 1; i < argc; ++i) {
+            std::string arg = argv[i];
+
+            size_t count = 0;
+
+            if (arg == "--input" && i + 1 < argc) {
+                vm.setInput(std::make_unique<BinaryReader>(argv[++i]));
+            } else if (arg == "--input-fd" && i + 1 < argc) {
+                if (!parseCount(argv[++i], INT_MAX, count)) {
+                    printUsage(argv[0]);
+                    return 1;
+                }
+                vm.setInput(std::make_unique<BinaryReader>(static_cast<int>(count)));
+            } else if (arg == "--batch" && i + 1 < argc) {
+                batchFile = argv[++i];
+            } else if (arg == "-O0" || arg == "-O1" || arg == "-O2" || arg == "-O3") {
+                level = arg[2] - '0';
+                vm.setOptimizationLevel(level);
+            } else if (arg == "--threads" && i + 1 < argc) {
+                if (!parseCount(argv[++i], SIZE_MAX, count)) {
+                    printUsage(argv[0]);
+                    return 1;
+                }
+                threadCount = count;
+                vm.setThreads(threadCount);
+            } else if (arg == "--stack-limit" && i + 1 < argc) {
+                if (!parseCount(argv[++i], SIZE_MAX, count) || !OperandBuffer::setLimit(count)) {
+                    printUsage(argv[0]);
+                    return 1;
+                }
+            } else if (arg == "--lsp") {
+                // Serves until the editor exits
+                LanguageServer server(std::cin, std::cout);
+                return server.run();
+            } else if (arg == "--fast-exit" || arg == "--no-fast-exit") {
+                fastExit = (arg == "--fast-exit");
+            } else if (arg == "--watch") {
+                watch = true;
+            } else if (arg == "--report") {
+                report = true;
+            } else if (arg == "--stage" && i + 1 < argc) {
+                stageFiles.push_back(argv[++i]);
+            } else if (arg == "--async-dump") {
+                asyncLimit = DumpQueue::defaultMemoryLimit;
+                vm.setAsyncDumps(asyncLimit);
+            } else if (arg.rfind("--async-dump=", 0) == 0) {
+                if (!parseCount(arg.substr(13), SIZE_MAX >> 20, count)) {
+                    printUsage(argv[0]);
+                    return 1;
+                }
+                asyncLimit = count << 20;
+                vm.setAsyncDumps(asyncLimit);
+            } else if (arg.rfind("--dump-format=", 0) == 0) {
+                if (!parseDumpFormat(arg.substr(14), dumpFormat)) {
+                    printUsage(argv[0]);
+                    return 1;
+                }
+                vm.setDumpFormat(dumpFormat);
+            } else if (arg == "--set" && i + 1 < argc) {
+                std::string binding = argv[++i];
+                size_t equals = binding.find('=');
+                if (equals == std::string::npos) {
+                    printUsage(argv[0]);
+                    return 1;
+                }
+                bindings.emplace_back(binding.substr(0, equals), binding.substr(equals + 1));
+                vm.bind(bindings.back().first, bindings.back().second);
+            } else if (!filename && arg.rfind("--", 0) != 0) {
+                filename = argv[i];
+            } else if (filename) {
+                vm.bind(std::to_string(++position), arg);
+            } else {
+                printUsage(argv[0]);
+                return 1;
+            }
+        }
+
+        if (((batchFile || !stageFiles.empty()) && !filename) ||
+            (watch && (!filename || batchFile || !stageFiles.empty()))) {
+            printUsage(argv[0]);
+            return 1;
+        }
+
+        // The watcher runs the program again: it frees the stack after each run
+        vm.setFastExit(fastExit && !watch);
+        if (watch) {
+            // Runs until interrupted
+            Watcher watcher(vm, filename);
+            watcher.run();
+        }
+
+        if (filename) {
             // Run from file
-            vm.runFile(argv[1]);
-        } else if (argc == 1) {
+            if (!vm.loadFile(filename)) {
+                return batchFile ? 1 : 0;
+            }
+            for (const char* stageFile : stageFiles) {
+                stages.push_back(std::make_unique<VirtualMachine>());
+                stages.back()->setCollectErrors(true);
+                stages.back()->setFastExit(fastExit);
+                stages.back()->setChannels(channels);
+                stages.back()->setDumpFormat(dumpFormat);
+                stages.back()->setOptimizationLevel(level);
+                stages.back()->setThreads(threadCount);
+                stages.back()->setAsyncDumps(asyncLimit);
+                for (const auto& [name, value] : bindings) {
+                    stages.back()->bind(name, value);
+                }
+                if (!stages.back()->loadFile(stageFile)) {
+                    return 1;
+                }
+            }
+            if (report) {
+                for (const std::string& line : vm.getOptimizationReport()) {
+                    std::cerr << line << std::endl;
+                }
+            }
+            if (batchFile) {
+                // Run once per input set
+                int status = runBatch(vm, batchFile);
+                if (fastExit) {
+                    exitNow(status);
+                }
+                return status;
+            }
+
+            // Stages run on their own threads, the main program on this one
+            std::vector<std::thread> threads;
+            for (const auto& stage : stages) {
+                threads.emplace_back(runStage, std::ref(*stage));
+            }
+            std::exception_ptr error;
+            try {
+                vm.execute();
+            } catch (...) {
+                error = std::current_exception();
+            }
+            for (std::thread& thread : threads) {
+                thread.join();
+            }
+            if (error) {
+                std::rethrow_exception(error);
+            }
+        } else {
             // Run from stdin
             std::cout << "Reading from stdin. End with ';;'" << std::endl;
             vm.run(std::cin, true);
-        } else {
-            std::cerr << "Usage: " << argv[0] << " [file]" << std::endl;
-            return 1;
+        }
+
+        if (fastExit) {
+            exitNow(0);
         }
 
         return 0;
@@ -0,0 +1,117 @@
+/**
+ * @file channel_bench.cpp
+ * @brief Throughput benchmark of value passing between VMs.
+ *
+ * Measures a Channel on its own (one producer thread, one consumer thread)
+ * and a two-stage pipeline of VirtualMachine instances exchanging values
+ * with 'send' and 'recv', for several channel capacities.
+ *
+ * Usage: channel_bench [values]
+ */
+
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <sstream>
+#include <thread>
+#include "AbstractVM.hpp"
+
+namespace {
+    /**
+     * @brief Prints a throughput line.
+     * @param label What was measured
+     * @param values Number of values passed
+     * @param seconds Elapsed time
+     */
+    void report(const std::string& label, size_t values, double seconds) {
+        std::cout << label << ": " << values << " values in " << seconds * 1000.0 << " ms, "
+                  << static_cast<double>(values) / seconds / 1e6 << " M values/s" << std::endl;
+    }
+
+    /**
+     * @brief Passes values through a channel between two threads.
+     * @param values Number of values
+     * @param capacity Channel capacity
+     * @return double Elapsed seconds
+     */
+    double benchChannel(size_t values, size_t capacity) {
+        Channel channel("bench", capacity);
+        int producer = 0;
+        int consumer = 0;
+        long double sum = 0;
+
+        channel.attach(&producer, true);
+        channel.attach(&consumer, false);
+
+        auto start = std::chrono::steady_clock::now();
+        std::thread thread([&]() {
+            for (size_t index = 0; index < values; ++index) {
+                channel.send(Scalar{eOperandType::Int32, static_cast<long double>(index)});
+            }
+        });
+        for (size_t index = 0; index < values; ++index) {
+            sum += channel.receive().value;
+        }
+        thread.join();
+        auto end = std::chrono::steady_clock::now();
+
+        if (sum != static_cast<long double>(values) * (values - 1) / 2) {
+            std::cerr << "channel_bench: wrong sum" << std::endl;
+            std::exit(1);
+        }
+        return std::chrono::duration<double>(end - start).count();
+    }
+
+    /**
+     * @brief Runs a producer VM sending values to a consumer VM.
+     * @param values Number of values
+     * @param capacity Channel capacity
+     * @return double Elapsed seconds of the two execute() calls
+     */
+    double benchPipeline(size_t values, size_t capacity) {
+        std::ostringstream producerSource;
+        std::ostringstream consumerSource;
+
+        for (size_t index = 0; index < values; ++index) {
+            producerSource << "push int32(" << index % 1000 << ")\nsend values\n";
+            consumerSource << "recv values\npop\n";
+        }
+        producerSource << "exit\n";
+        consumerSource << "exit\n";
+
+        auto channels = std::make_shared<ChannelRegistry>(capacity);
+        VirtualMachine producer;
+        VirtualMachine consumer;
+        std::istringstream producerInput(producerSource.str());
+        std::istringstream consumerInput(consumerSource.str());
+
+        producer.setChannels(channels);
+        consumer.setChannels(channels);
+        producer.load(producerInput);
+        consumer.load(consumerInput);
+
+        auto start = std::chrono::steady_clock::now();
+        std::thread thread([&]() { producer.execute(); });
+        consumer.execute();
+        thread.join();
+        auto end = std::chrono::steady_clock::now();
+
+        return std::chrono::duration<double>(end - start).count();
+    }
+}
+
+int main(int argc, char** argv) {
+    size_t values = argc > 1 ? std::stoul(argv[1]) : 1000000;
+
+    try {
+        for (size_t capacity : {16, 256, 1024, 65536}) {
+            std::string suffix = " (capacity " + std::to_string(capacity) + ")";
+            report("channel" + suffix, values, benchChannel(values, capacity));
+            report("vm pipeline" + suffix, values / 10, benchPipeline(values / 10, capacity));
+        }
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,835 @@
+/**
+ * @file complexity_fuzz.cpp
+ * @brief Algorithmic-complexity fuzzing of the lexer, the parser and the VM.
+ *
+ * Each input is lexed with Lexer, parsed with VirtualMachine::load() (the
+ * Parser, macro expansion included) and executed, as VirtualMachine::run()
+ * does, in error collection mode. The cost of each stage is measured in CPU
+ * instructions when the system exposes a hardware counter, and in time
+ * otherwise, and divided by the input size.
+ *
+ * An input is reported when a stage costs much more per byte than on the
+ * examples, or when its cost grows faster than the input: the input is
+ * repeated, and each of its lines is repeated, 2, 4 and 8 times, and the
+ * growth exponent of each stage is estimated. Linear stages have an
+ * exponent near 1; an error recovery rescanning the input, for instance,
+ * has an exponent near 2.
+ *
+ * Mutations rarely build long structures, so main() also grows a few
+ * generated programs (chains of distinct macros, uses of many macros,
+ * nested savepoints, runs of ranged and incremental dumps) from 16 KiB to
+ * 128 KiB and checks that each stage stays linear.
+ *
+ * Strings are replaced by a path that does not exist, so that 'include'
+ * and 'dump "file"' cannot touch the file system.
+ *
+ * Built with -fsanitize=fuzzer (make complexity_libfuzzer), libFuzzer calls
+ * LLVMFuzzerTestOneInput and saves the reported inputs, as the harness
+ * aborts on them. Built alone (make complexity_fuzz), main() mutates the
+ * files given (by default those of examples/) with a simple random mutator.
+ *
+ * Usage: complexity_fuzz [--runs n] [--seed s] [--max-len n] [files or directories...]
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <streambuf>
+#include <utility>
+#include <vector>
+#include "AbstractVM.hpp"
+
+#ifdef __linux__
+# include <linux/perf_event.h>
+# include <sys/ioctl.h>
+# include <sys/syscall.h>
+# include <unistd.h>
+#endif
+
+namespace {
+    /**
+     * @enum eStage
+     * @brief The stages measured.
+     */
+    enum eStage {
+        Lex,        ///< Lexer::tokenize()
+        Parse,      ///< VirtualMachine::load()
+        Execute,    ///< VirtualMachine::execute()
+        StageCount  ///< Number of stages
+    };
+
+    /**
+     * @brief Names of the stages in reports.
+     */
+    const char* const stageNames[StageCount] = {"lexer", "parser", "vm"};
+
+    /**
+     * @brief Path given to 'include' and 'dump', in place of the strings of the input.
+     */
+    const char* const sandboxPath = "/nonexistent/avm-complexity-fuzz";
+
+    /**
+     * @brief Growth exponent above which a stage is reported.
+     */
+    constexpr double maxExponent = 1.5;
+
+    /**
+     * @brief Cost per byte above which a stage is reported, as a multiple of the examples'.
+     */
+    constexpr double maxCostRatio = 100.0;
+
+    /**
+     * @brief Cost of a growth step above which probing stops, in nanoseconds.
+     */
+    constexpr double probeBudget = 500e6;
+
+    /**
+     * @class Counter
+     * @brief Reads the instructions executed by this thread, or the time.
+     */
+    class Counter {
+    public:
+        /**
+         * @brief Constructor, which opens the hardware counter if there is one.
+         */
+        Counter()
+            : _fd(-1) {
+#ifdef __linux__
+            perf_event_attr attributes{};
+            attributes.type = PERF_TYPE_HARDWARE;
+            attributes.size = sizeof(attributes);
+            attributes.config = PERF_COUNT_HW_INSTRUCTIONS;
+            attributes.exclude_kernel = 1;
+            attributes.exclude_hv = 1;
+            _fd = static_cast<int>(syscall(SYS_perf_event_open, &attributes, 0, -1, -1, 0));
+#endif
+        }
+
+        /**
+         * @brief Destructor, which closes the counter.
+         */
+        ~Counter() {
+#ifdef __linux__
+            if (_fd >= 0) {
+                close(_fd);
+            }
+#endif
+        }
+
+        /**
+         * @brief Checks if instructions are counted.
+         * @return bool True for instructions, false for nanoseconds
+         */
+        bool countsInstructions() const {
+            return _fd >= 0;
+        }
+
+        /**
+         * @brief Gets the unit of the values returned by now().
+         * @return const char* "instructions" or "ns"
+         */
+        const char* unit() const {
+            return countsInstructions() ? "instructions" : "ns";
+        }
+
+        /**
+         * @brief Reads the counter.
+         * @return double Instructions executed, or nanoseconds elapsed, since an arbitrary origin
+         */
+        double now() const {
+#ifdef __linux__
+            uint64_t count = 0;
+            if (_fd >= 0 && read(_fd, &count, sizeof(count)) == sizeof(count)) {
+                return static_cast<double>(count);
+            }
+#endif
+            return std::chrono::duration<double, std::nano>(
+                       std::chrono::steady_clock::now().time_since_epoch()).count();
+        }
+
+    private:
+        int _fd;    ///< The perf event, or -1
+    };
+
+    /**
+     * @brief Stream buffer discarding everything written to it.
+     */
+    class NullBuffer : public std::streambuf {
+    protected:
+        /**
+         * @brief Discards a character.
+         * @param c The character
+         * @return int The character (success)
+         */
+        int overflow(int c) override {
+            return c;
+        }
+
+        /**
+         * @brief Discards characters.
+         * @param text The characters
+         * @param count Their number
+         * @return std::streamsize The number (success)
+         */
+        std::streamsize xsputn(const char* text, std::streamsize count) override {
+            (void)text;
+            return count;
+        }
+    };
+
+    /**
+     * @brief Discards std::cout and std::cerr while alive.
+     */
+    class Silence {
+    public:
+        /**
+         * @brief Constructor, which starts discarding.
+         */
+        Silence()
+            : _output(std::cout.rdbuf(&_sink)), _errors(std::cerr.rdbuf(&_sink)) {
+        }
+
+        /**
+         * @brief Destructor, which restores the streams.
+         */
+        ~Silence() {
+            std::cout.rdbuf(_output);
+            std::cerr.rdbuf(_errors);
+        }
+
+    private:
+        NullBuffer _sink;           ///< Receives the output
+        std::streambuf* _output;    ///< Buffer of std::cout before
+        std::streambuf* _errors;    ///< Buffer of std::cerr before
+    };
+
+    /**
+     * @struct Cost
+     * @brief Cost of each stage for one input.
+     */
+    struct Cost {
+        double stages[StageCount] = {};     ///< Instructions or nanoseconds
+    };
+
+    /**
+     * @brief Runs the stages once.
+     * @param counter The counter
+     * @param text The input
+     * @return Cost The cost of each stage
+     */
+    Cost measureOnce(const Counter& counter, const std::string& text) {
+        Cost cost;
+        Silence silence;
+        std::istringstream input(text);
+
+        double start = counter.now();
+        Lexer lexer(input, false, true);
+        std::vector<Token> tokens = lexer.tokenize();
+        cost.stages[Lex] = counter.now() - start;
+
+        for (Token& token : tokens) {
+            if (token.getType() == TokenType::STRING) {
+                token = Token(TokenType::STRING, sandboxPath, token.getLine(), token.getColumn());
+            }
+        }
+
+        try {
+            VirtualMachine vm;
+            vm.setCollectErrors(true);
+
+            start = counter.now();
+            bool loaded = vm.load(tokens);
+            cost.stages[Parse] = counter.now() - start;
+            if (loaded) {
+                start = counter.now();
+                vm.execute();
+                cost.stages[Execute] = counter.now() - start;
+            }
+        } catch (const std::exception&) {
+            // Errors outside the VM's own (allocation, ...) end the input
+        }
+        return cost;
+    }
+
+    /**
+     * @brief Runs the stages three times and keeps the lowest cost of each.
+     * @param counter The counter
+     * @param text The input
+     * @return Cost The cost of each stage
+     */
+    Cost measure(const Counter& counter, const std::string& text) {
+        Cost best = measureOnce(counter, text);
+
+        for (int run = 1; run < 3; ++run) {
+            Cost cost = measureOnce(counter, text);
+            for (size_t stage = 0; stage < StageCount; ++stage) {
+                best.stages[stage] = std::min(best.stages[stage], cost.stages[stage]);
+            }
+        }
+        return best;
+    }
+
+    /**
+     * @brief Repeats a whole input.
+     * @param text The input
+     * @param count Number of copies
+     * @return std::string The copies, each ending with a newline
+     */
+    std::string repeatInput(const std::string& text, size_t count) {
+        std::string unit = (text.empty() || text.back() == '\n') ? text : text + "\n";
+        std::string result;
+
+        result.reserve(unit.size() * count);
+        for (size_t copy = 0; copy < count; ++copy) {
+            result += unit;
+        }
+        return result;
+    }
+
+    /**
+     * @brief Repeats each line of an input.
+     * @param text The input
+     * @param count Number of copies of each line
+     * @return std::string The input with its lines repeated in place
+     */
+    std::string repeatLines(const std::string& text, size_t count) {
+        std::istringstream input(text);
+        std::string line;
+        std::string result;
+
+        while (std::getline(input, line)) {
+            for (size_t copy = 0; copy < count; ++copy) {
+                result += line + "\n";
+            }
+        }
+        return result;
+    }
+
+    /**
+     * @struct Finding
+     * @brief A stage whose cost is out of proportion with an input.
+     */
+    struct Finding {
+        eStage stage;           ///< The stage
+        std::string detail;     ///< What was measured
+    };
+
+    /**
+     * @class Detector
+     * @brief Measures inputs and finds the disproportionate ones.
+     */
+    class Detector {
+    public:
+        /**
+         * @brief Constructor, which calibrates the cost per byte on reference programs.
+         *
+         * The baseline of a stage is the median cost per byte of the
+         * programs reaching it (a program failing to load never executes).
+         *
+         * @param reference Programs of normal cost
+         */
+        explicit Detector(const std::vector<std::string>& reference) {
+            std::vector<double> samples[StageCount];
+
+            for (const std::string& text : reference) {
+                Cost cost = measure(_counter, text);
+                for (size_t stage = 0; stage < StageCount; ++stage) {
+                    if (cost.stages[stage] > 0 && !text.empty()) {
+                        samples[stage].push_back(cost.stages[stage] / static_cast<double>(text.size()));
+                    }
+                }
+            }
+            for (size_t stage = 0; stage < StageCount; ++stage) {
+                std::vector<double>& values = samples[stage];
+                if (values.empty()) {
+                    _baseline[stage] = 1.0;
+                    continue;
+                }
+                std::nth_element(values.begin(), values.begin() + values.size() / 2, values.end());
+                _baseline[stage] = values[values.size() / 2];
+            }
+        }
+
+        /**
+         * @brief Gets the counter used.
+         * @return const Counter& The counter
+         */
+        const Counter& getCounter() const {
+            return _counter;
+        }
+
+        /**
+         * @brief Gets the cost per byte of the reference programs.
+         * @param stage The stage
+         * @return double Instructions or nanoseconds per byte
+         */
+        double getBaseline(eStage stage) const {
+            return _baseline[stage];
+        }
+
+        /**
+         * @brief Measures an input and its growth.
+         * @param text The input
+         * @param probe True to estimate the growth exponents (slower)
+         * @param costPerByte Receives the highest cost per byte over the stages, relative to the baseline
+         * @return std::vector<Finding> The stages out of proportion
+         */
+        std::vector<Finding> check(const std::string& text, bool probe, double& costPerByte) {
+            std::vector<Finding> findings;
+            size_t size = std::max<size_t>(text.size(), 1);
+            Cost cost = measure(_counter, text);
+
+            costPerByte = 0;
+            for (size_t stage = 0; stage < StageCount; ++stage) {
+                double ratio = cost.stages[stage] / static_cast<double>(size) / _baseline[stage];
+                costPerByte = std::max(costPerByte, ratio);
+                // Small inputs pay fixed costs (VM setup, threads): judge from 64 bytes
+                if (size >= 64 && ratio > maxCostRatio) {
+                    findings.push_back(Finding{static_cast<eStage>(stage),
+                                               describeRatio(cost.stages[stage], size, ratio)});
+                }
+            }
+            if (probe && findings.empty()) {
+                probeGrowth("repeating the input", [&](size_t count) { return repeatInput(text, count); }, 256,
+                            findings);
+                probeGrowth("repeating the lines", [&](size_t count) { return repeatLines(text, count); }, 256,
+                            findings);
+            }
+            return findings;
+        }
+
+        /**
+         * @brief Measures the growth of a generated program.
+         * @param name Name of the program in reports
+         * @param build Function generating the program with a number of repetitions
+         * @return std::vector<Finding> The stages growing faster than the program
+         */
+        std::vector<Finding> checkGenerated(const std::string& name,
+                                            const std::function<std::string(size_t)>& build) {
+            std::vector<Finding> findings;
+
+            probeGrowth("growing the " + name, build, 16384, findings);
+            return findings;
+        }
+
+    private:
+        Counter _counter;                       ///< Instructions or time
+        double _baseline[StageCount] = {};      ///< Cost per byte of the reference programs
+
+        /**
+         * @brief Describes a cost per byte.
+         * @param cost Cost of the stage
+         * @param size Input size
+         * @param ratio Cost per byte relative to the baseline
+         * @return std::string The description
+         */
+        std::string describeRatio(double cost, size_t size, double ratio) const {
+            std::ostringstream text;
+            text << cost / static_cast<double>(size) << " " << _counter.unit() << "/byte over " << size
+                 << " bytes, " << ratio << " x the examples";
+            return text.str();
+        }
+
+        /**
+         * @brief Estimates the growth exponents of the stages for one way of growing the input.
+         *
+         * The input is first grown to at least minSize bytes, then doubled
+         * three times, unless a step gets too expensive. The exponent is
+         * taken from the second size measured to the last: a grown input can
+         * behave differently from the original (repeated pushes let a
+         * failing instruction succeed), and the first doubling settles it.
+         *
+         * @param model The growth in reports
+         * @param grow Function growing the input by a factor
+         * @param minSize Size of the smallest input measured
+         * @param findings Receives the stages growing too fast
+         */
+        void probeGrowth(const std::string& model, const std::function<std::string(size_t)>& grow,
+                         size_t minSize, std::vector<Finding>& findings) {
+            size_t base = 1;
+            std::string small = grow(base);
+            while (!small.empty() && small.size() < minSize) {
+                base *= 2;
+                small = grow(base);
+            }
+            if (small.empty()) {
+                return;
+            }
+
+            std::vector<std::pair<size_t, Cost>> points{{small.size(), measure(_counter, small)}};
+            for (size_t factor = 2; factor <= 8; factor *= 2) {
+                std::string large = grow(base * factor);
+                points.emplace_back(large.size(), measure(_counter, large));
+                double total = 0;
+                for (double stage : points.back().second.stages) {
+                    total += stage;
+                }
+                if (!_counter.countsInstructions() && total > probeBudget) {
+                    break;
+                }
+            }
+
+            const auto& [firstSize, first] = points[points.size() > 2 ? 1 : 0];
+            const auto& [lastSize, last] = points.back();
+
+            for (size_t stage = 0; stage < StageCount; ++stage) {
+                // Below 1M instructions (or 1 ms) the measures are noise
+                constexpr double floor = 1e6;
+                if (last.stages[stage] < floor || first.stages[stage] <= 0) {
+                    continue;
+                }
+                double exponent = std::log(last.stages[stage] / first.stages[stage]) /
+                                  std::log(static_cast<double>(lastSize) / static_cast<double>(firstSize));
+                if (exponent > maxExponent) {
+                    std::ostringstream detail;
+                    detail << "growth exponent " << exponent << " when " << model << ": "
+                           << first.stages[stage] << " " << _counter.unit() << " for " << firstSize
+                           << " bytes, " << last.stages[stage] << " for " << lastSize << " bytes";
+                    findings.push_back(Finding{static_cast<eStage>(stage), detail.str()});
+                }
+            }
+        }
+    };
+
+    /**
+     * @brief Prints the findings of an input.
+     * @param text The input
+     * @param findings Its findings
+     */
+    void report(const std::string& text, const std::vector<Finding>& findings) {
+        for (const Finding& finding : findings) {
+            std::cerr << "super-linear " << stageNames[finding.stage] << ": " << finding.detail << std::endl;
+        }
+        if (text.size() <= 400) {
+            std::cerr << "input:" << std::endl << text << (text.empty() || text.back() == '\n' ? "" : "\n")
+                      << "---" << std::endl;
+        }
+    }
+
+    /**
+     * @brief Reads the .avm files given, or those of examples/.
+     * @param paths Files and directories
+     * @return std::vector<std::string> The file contents
+     */
+    std::vector<std::string> readSeeds(std::vector<std::string> paths) {
+        std::vector<std::string> files;
+        std::vector<std::string> seeds;
+
+        if (paths.empty() && std::filesystem::is_directory("examples")) {
+            paths.push_back("examples");
+        }
+        for (const std::string& path : paths) {
+            if (!std::filesystem::is_directory(path)) {
+                files.push_back(path);
+                continue;
+            }
+            for (const auto& entry : std::filesystem::directory_iterator(path)) {
+                if (entry.path().extension() == ".avm") {
+                    files.push_back(entry.path().string());
+                }
+            }
+        }
+        std::sort(files.begin(), files.end());
+        for (const std::string& file : files) {
+            std::ifstream input(file);
+            std::ostringstream text;
+            text << input.rdbuf();
+            seeds.push_back(text.str());
+        }
+        return seeds;
+    }
+
+    /**
+     * @brief Gets the detector shared by the libFuzzer entry point, calibrated on examples/.
+     * @return Detector& The detector
+     */
+    Detector& sharedDetector() {
+        static Detector detector(readSeeds({}));
+        return detector;
+    }
+}
+
+/**
+ * @brief libFuzzer entry point: aborts on inputs with super-linear cost.
+ *
+ * Growth is probed on the inputs costing the most per byte so far and on
+ * one input in 64, to keep the executions fast.
+ *
+ * @param data The input
+ * @param size Its size
+ * @return int 0
+ */
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size) {
+    static double highest = 0;
+    static size_t inputs = 0;
+    Detector& detector = sharedDetector();
+    std::string text(reinterpret_cast<const char*>(data), size);
+    double costPerByte = 0;
+
+    std::vector<Finding> findings = detector.check(text, false, costPerByte);
+    if (findings.empty() && (costPerByte > highest || ++inputs % 64 == 0)) {
+        highest = std::max(highest, costPerByte);
+        findings = detector.check(text, true, costPerByte);
+    }
+    if (!findings.empty()) {
+        report(text, findings);
+        std::abort(); // libFuzzer saves the input
+    }
+    return 0;
+}
+
+#ifdef AVM_FUZZ_MAIN
+namespace {
+    /**
+     * @class Mutator
+     * @brief Random edits of inputs, biased towards the tokens of the language.
+     */
+    class Mutator {
+    public:
+        /**
+         * @brief Constructor.
+         * @param seed Seed of the random sequence
+         */
+        explicit Mutator(unsigned seed)
+            : _random(seed) {
+        }
+
+        /**
+         * @brief Edits an input.
+         * @param text The input
+         * @param other Another input, for splicing
+         * @param maxLength Maximum size of the result
+         * @return std::string The edited input
+         */
+        std::string mutate(std::string text, const std::string& other, size_t maxLength) {
+            static const char* const fragments[] = {
+                "push ", "pop\n", "add\n", "mul\n", "div\n", "dump\n", "dump 3\n", "assert ", "int8(", "int16(",
+                "int32(", "float(", "double(", ")", "(", "\n", " ", ";", ";;", "\"", "1", "-", ".", "42",
+                "macro m a\n", "endmacro\n", "m int32(1)\n", "macro a\n", "macro b\n", "a\n", "b\n",
+                "fork 1\n", "endfork\n", "join\n", "onerror\n", "endonerror\n", "savepoint\n", "rollback\n",
+                "commit\n", "dumpdelta\n", "use s\n", "move main s 1\n", "include \"f\"\n", "exit\n", "$1",
+                "read int8\n", "send c\n", "recv c\n"};
+            size_t edits = 1 + number(3);
+
+            for (size_t edit = 0; edit < edits; ++edit) {
+                size_t position = number(text.size() + 1);
+                size_t length = text.empty() ? 0 : 1 + number(std::min<size_t>(text.size() - position + 1, 64));
+                length = std::min(length, text.size() - position);
+
+                switch (number(5)) {
+                    case 0:
+                        text.insert(position, fragments[number(std::size(fragments))]);
+                        break;
+                    case 1:
+                        text.erase(position, length);
+                        break;
+                    case 2:
+                        text.insert(position, text.substr(position, length));
+                        break;
+                    case 3:
+                        if (!text.empty()) {
+                            text[std::min(position, text.size() - 1)] = static_cast<char>(number(128));
+                        }
+                        break;
+                    default: {
+                        size_t from = number(other.size() + 1);
+                        text.insert(position, other.substr(from, number(256)));
+                        break;
+                    }
+                }
+            }
+            if (text.size() > maxLength) {
+                text.resize(maxLength);
+            }
+            return text;
+        }
+
+    private:
+        std::mt19937 _random;   ///< Random sequence
+
+        /**
+         * @brief Draws a number.
+         * @param bound Upper bound (excluded, at least 1)
+         * @return size_t A number in [0, bound)
+         */
+        size_t number(size_t bound) {
+            return std::uniform_int_distribution<size_t>(0, std::max<size_t>(bound, 1) - 1)(_random);
+        }
+    };
+
+    /**
+     * @brief Generates chains of distinct macros, each using the previous one.
+     *
+     * Chains restart every 500 macros, below Parser::maxNesting, and the
+     * last macro of each chain is used once: the expansion is linear.
+     *
+     * @param count Number of macros
+     * @return std::string The program
+     */
+    std::string macroChains(size_t count) {
+        constexpr size_t chain = 500;
+        std::ostringstream text;
+
+        for (size_t index = 0; index < count; ++index) {
+            text << "macro m" << index << "\n";
+            if (index % chain != 0) {
+                text << "m" << index - 1 << "\n";
+            }
+            text << "push int32(" << index << ")\npop\nendmacro\n";
+        }
+        for (size_t index = 0; index < count; ++index) {
+            if ((index + 1) % chain == 0 || index + 1 == count) {
+                text << "m" << index << "\n";
+            }
+        }
+        text << "exit\n";
+        return text.str();
+    }
+
+    /**
+     * @brief Generates distinct macros with a parameter, each used once.
+     * @param count Number of macros
+     * @return std::string The program
+     */
+    std::string macroUses(size_t count) {
+        std::ostringstream text;
+
+        for (size_t index = 0; index < count; ++index) {
+            text << "macro m" << index << " v\npush v\npop\nendmacro\n";
+        }
+        for (size_t index = 0; index < count; ++index) {
+            text << "m" << index << " int32(" << index << ")\n";
+        }
+        text << "exit\n";
+        return text.str();
+    }
+
+    /**
+     * @brief Generates nested savepoints, then closes them with rollbacks and commits.
+     * @param count Number of savepoints
+     * @return std::string The program
+     */
+    std::string savepointRun(size_t count) {
+        std::ostringstream text;
+
+        text << "push int32(0)\n";
+        for (size_t index = 0; index < count; ++index) {
+            text << "savepoint\npush int32(" << index << ")\n";
+        }
+        for (size_t index = 0; index < count; ++index) {
+            text << (index % 2 ? "rollback\n" : "commit\n");
+        }
+        text << "exit\n";
+        return text.str();
+    }
+
+    /**
+     * @brief Generates a growing stack dumped after each push with a ranged and an incremental dump.
+     * @param count Number of pushes
+     * @return std::string The program
+     */
+    std::string dumpRun(size_t count) {
+        std::ostringstream text;
+
+        text << "push int32(0)\n";
+        for (size_t index = 0; index < count; ++index) {
+            text << "push int32(" << index << ")\ndump 2\ndumpdelta\n";
+        }
+        text << "exit\n";
+        return text.str();
+    }
+
+    /**
+     * @brief Generated programs whose cost must grow linearly, by name.
+     */
+    const std::pair<const char*, std::string (*)(size_t)> generated[] = {
+        {"macro chains", macroChains},
+        {"macro uses", macroUses},
+        {"savepoint run", savepointRun},
+        {"dump run", dumpRun}};
+}
+
+int main(int argc, char** argv) {
+    size_t runs = 500;
+    unsigned seed = 1;
+    size_t maxLength = 4096;
+    std::vector<std::string> paths;
+
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+
+        if (arg == "--runs" && i + 1 < argc) {
+            runs = std::stoul(argv[++i]);
+        } else if (arg == "--seed" && i + 1 < argc) {
+            seed = static_cast<unsigned>(std::stoul(argv[++i]));
+        } else if (arg == "--max-len" && i + 1 < argc) {
+            maxLength = std::stoul(argv[++i]);
+        } else if (arg.rfind("--", 0) != 0) {
+            paths.push_back(arg);
+        } else {
+            std::cerr << "Usage: " << argv[0] << " [--runs n] [--seed s] [--max-len n] [files or directories...]"
+                      << std::endl;
+            return 1;
+        }
+    }
+
+    std::vector<std::string> corpus = readSeeds(paths);
+    if (corpus.empty()) {
+        corpus.push_back("push int32(1)\nexit\n");
+    }
+    // Calibrate on the examples, not on suspicious seeds given on the command line
+    std::vector<std::string> examples = readSeeds({});
+    Detector detector(examples.empty() ? corpus : examples);
+    Mutator mutator(seed);
+    std::mt19937 random(seed);
+    size_t reported = 0;
+
+    std::cout << "cost per byte of the examples (" << detector.getCounter().unit() << "):";
+    for (size_t stage = 0; stage < StageCount; ++stage) {
+        std::cout << " " << stageNames[stage] << " " << detector.getBaseline(static_cast<eStage>(stage));
+    }
+    std::cout << std::endl;
+
+    for (const auto& [name, build] : generated) {
+        std::vector<Finding> findings = detector.checkGenerated(name, build);
+
+        if (!findings.empty()) {
+            ++reported;
+            std::cerr << name << ":" << std::endl;
+            report(build(4), findings);
+        }
+    }
+
+    // The seeds, then mutations of the corpus; inputs costing more per byte join it
+    size_t seeds = corpus.size();
+    double highestCost = 0;
+    for (size_t run = 0; run < seeds + runs; ++run) {
+        std::string text = (run < seeds) ? corpus[run]
+                                         : mutator.mutate(corpus[random() % corpus.size()],
+                                                          corpus[random() % corpus.size()], maxLength);
+        double costPerByte = 0;
+        std::vector<Finding> findings = detector.check(text, true, costPerByte);
+
+        if (!findings.empty()) {
+            ++reported;
+            report(text, findings);
+        } else if (costPerByte > highestCost && run >= seeds) {
+            corpus.push_back(text);
+        }
+        highestCost = std::max(highestCost, costPerByte);
+    }
+
+    std::cout << std::size(generated) << " generated programs, " << seeds + runs << " inputs, " << corpus.size()
+              << " in the corpus, highest cost per byte "
+              << highestCost << " x the examples: " << reported << " super-linear input(s)" << std::endl;
+    return reported ? 1 : 0;
+}
+#endif
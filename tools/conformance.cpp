@@ -0,0 +1,742 @@
+/**
+ * @file conformance.cpp
+ * @brief Differential test of the execution engines against the reference loop.
+ *
+ * Runs each program with the reference ICommand loop (-O0) and with every
+ * other engine: the optimisation levels, the parallel segments of -O2 and
+ * -O3, asynchronous dumps and the batch engine (for the programs it
+ * accepts). The standard output (byte for byte, whatever the dump format),
+ * the error stream, the error raised (class and message) and the final
+ * stacks must be identical to the reference.
+ *
+ * Programs are the files given on the command line (by default those of
+ * examples/, in each dump format) followed by randomly generated ones,
+ * each run with a dump format, a binary input stream for 'read' and
+ * placeholder bindings. A program on which an engine differs is shrunk,
+ * line by line, to a minimal program on which it still differs, and
+ * printed with both outcomes.
+ *
+ * Usage: conformance [--random n] [--seed s] [--length l] [files...]
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cxxabi.h>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <sstream>
+#include <typeinfo>
+#include <unistd.h>
+#include "AbstractVM.hpp"
+
+namespace {
+    /**
+     * @struct Engine
+     * @brief One way of running a program.
+     */
+    struct Engine {
+        const char* name;       ///< Name in reports
+        int level;              ///< Optimisation level
+        size_t threads;         ///< Threads running independent segments
+        bool asyncDumps;        ///< True to write the output on a background thread
+        bool batch;             ///< True to run one lane of BatchEngine
+    };
+
+    /**
+     * @brief The engines compared; the first one is the reference.
+     */
+    const Engine engines[] = {
+        {"O0", 0, 1, false, false},
+        {"O1", 1, 1, false, false},
+        {"O2", 2, 1, false, false},
+        {"O2 threads=4", 2, 4, false, false},
+        {"O3", 3, 1, false, false},
+        {"O3 threads=4", 3, 4, false, false},
+        {"O0 async-dump", 0, 1, true, false},
+        {"O2 async-dump", 2, 1, true, false},
+        {"batch", 0, 1, false, true},
+    };
+
+    /**
+     * @struct Case
+     * @brief A program and what it runs with.
+     */
+    struct Case {
+        std::string source;                                     ///< The program text
+        std::string path;                                       ///< Path of the program, to resolve its includes
+        eDumpFormat format = eDumpFormat::Text;                 ///< Output of 'dump'
+        std::string input;                                      ///< Bytes of the input stream of 'read'
+        std::vector<std::pair<std::string, std::string>> bindings; ///< Placeholder values, bound in order
+    };
+
+    /**
+     * @brief Gets the name of a dump format.
+     * @param format The format
+     * @return const char* Its name, as given to --dump-format
+     */
+    const char* formatName(eDumpFormat format) {
+        static const char* const names[] = {"text", "binary", "jsonl", "csv"};
+        return names[static_cast<int>(format)];
+    }
+
+    /**
+     * @brief Path of the file holding the input stream of the case being run.
+     * @return const std::string& A file in the temporary directory, per process
+     */
+    const std::string& inputPath() {
+        static const std::string path =
+            (std::filesystem::temp_directory_path() / ("avm_conformance_" + std::to_string(getpid()) + ".bin"))
+                .string();
+        return path;
+    }
+
+    /**
+     * @struct Outcome
+     * @brief What a program did on one engine.
+     */
+    struct Outcome {
+        bool skipped = false;   ///< True if the engine does not accept the program
+        std::string output;     ///< Standard output
+        std::string errors;     ///< Error stream
+        std::string error;      ///< Class and message of the error raised, if any
+        std::string stacks;     ///< Final stacks, one line per non-empty stack
+
+        /**
+         * @brief Compares two outcomes.
+         * @param other The other outcome
+         * @return bool True if the program behaved the same
+         */
+        bool operator==(const Outcome& other) const {
+            return output == other.output && errors == other.errors && error == other.error &&
+                   stacks == other.stacks;
+        }
+    };
+
+    /**
+     * @brief Gets the name of the dynamic class of an exception.
+     * @param error The exception
+     * @return std::string The demangled class name
+     */
+    std::string className(const std::exception& error) {
+        int status = 0;
+        const char* mangled = typeid(error).name();
+        std::unique_ptr<char, void (*)(void*)> name(abi::__cxa_demangle(mangled, nullptr, nullptr, &status),
+                                                   std::free);
+        return status == 0 ? name.get() : mangled;
+    }
+
+    /**
+     * @brief Redirects std::cout and std::cerr to strings while alive.
+     */
+    class Capture {
+    public:
+        /**
+         * @brief Constructor, which starts the redirection.
+         */
+        Capture()
+            : _output(std::cout.rdbuf(_outputText.rdbuf())), _errors(std::cerr.rdbuf(_errorText.rdbuf())) {
+        }
+
+        /**
+         * @brief Destructor, which restores the streams.
+         */
+        ~Capture() {
+            std::cout.rdbuf(_output);
+            std::cerr.rdbuf(_errors);
+        }
+
+        /**
+         * @brief Moves the captured text to an outcome.
+         * @param outcome The outcome
+         */
+        void take(Outcome& outcome) {
+            std::cout.flush();
+            std::cerr.flush();
+            outcome.output = _outputText.str();
+            outcome.errors = _errorText.str();
+        }
+
+    private:
+        std::ostringstream _outputText;     ///< Captured standard output
+        std::ostringstream _errorText;      ///< Captured error stream
+        std::streambuf* _output;            ///< Buffer of std::cout before the capture
+        std::streambuf* _errors;            ///< Buffer of std::cerr before the capture
+    };
+
+    /**
+     * @brief Runs a program on an engine.
+     * @param engine The engine
+     * @param program The program and what it runs with
+     * @return Outcome What the program did
+     */
+    Outcome run(const Engine& engine, const Case& program) {
+        Outcome outcome;
+        Capture capture;
+
+        try {
+            VirtualMachine vm;
+            std::istringstream input(program.source);
+
+            vm.setOptimizationLevel(engine.level);
+            vm.setThreads(engine.threads);
+            if (engine.asyncDumps) {
+                vm.setAsyncDumps(DumpQueue::defaultMemoryLimit);
+            }
+            vm.setFastExit(true); // keeps the final stacks for getStack()
+            vm.setDumpFormat(program.format);
+            if (!program.input.empty()) {
+                std::ofstream(inputPath(), std::ios::binary).write(program.input.data(),
+                                                                   static_cast<std::streamsize>(program.input.size()));
+                vm.setInput(std::make_unique<BinaryReader>(inputPath()));
+            }
+            for (const auto& [name, value] : program.bindings) {
+                vm.bind(name, value);
+            }
+            vm.load(input, false, program.path);
+
+            if (engine.batch) {
+                std::unique_ptr<BatchEngine> batch;
+                try {
+                    batch = std::make_unique<BatchEngine>(vm);
+                } catch (const std::invalid_argument&) {
+                    outcome.skipped = true;
+                    return outcome;
+                }
+                BatchEngine::LaneResult lane = batch->run().front();
+                if (lane.error) {
+                    std::rethrow_exception(lane.error);
+                }
+                for (const Scalar& value : lane.stack) {
+                    outcome.stacks += (outcome.stacks.empty() ? "main:" : "") + std::string(" ") +
+                                      operandTypeToString(value.type) + "(" +
+                                      formatValue(value.type, value.value) + ")";
+                }
+            } else {
+                vm.execute();
+                for (size_t index = 0; index < vm.getStackNames().size(); ++index) {
+                    const OperandBuffer& values = vm.getStack(index);
+                    if (values.empty()) {
+                        continue;
+                    }
+                    outcome.stacks += (outcome.stacks.empty() ? "" : "\n") + vm.getStackNames()[index] + ":";
+                    for (const IOperand* value : values) {
+                        outcome.stacks += " " + std::string(operandTypeToString(value->getType())) + "(" +
+                                          value->toString() + ")";
+                    }
+                }
+            }
+        } catch (const std::exception& e) {
+            outcome.error = className(e) + ": " + e.what();
+        }
+        capture.take(outcome);
+        return outcome;
+    }
+
+    /**
+     * @brief Splits a program into lines.
+     * @param source The program text
+     * @return std::vector<std::string> The lines, without newlines
+     */
+    std::vector<std::string> splitLines(const std::string& source) {
+        std::vector<std::string> lines;
+        std::istringstream input(source);
+        std::string line;
+
+        while (std::getline(input, line)) {
+            lines.push_back(line);
+        }
+        return lines;
+    }
+
+    /**
+     * @brief Joins lines into a program.
+     * @param lines The lines
+     * @return std::string The program text
+     */
+    std::string joinLines(const std::vector<std::string>& lines) {
+        std::string source;
+
+        for (const std::string& line : lines) {
+            source += line + "\n";
+        }
+        return source;
+    }
+
+    /**
+     * @brief Checks if an engine differs from the reference on a program.
+     * @param engine The engine
+     * @param program The program and what it runs with
+     * @return bool True if the outcomes differ
+     */
+    bool differs(const Engine& engine, const Case& program) {
+        Outcome outcome = run(engine, program);
+        return !outcome.skipped && !(outcome == run(engines[0], program));
+    }
+
+    /**
+     * @brief Removes lines of a program as long as an engine still differs on it.
+     *
+     * Tries to remove chunks of half the program, then of a quarter, and so
+     * on down to single lines, keeping every removal after which the engine
+     * still differs from the reference. Chunks of one and two lines are
+     * tried at every offset.
+     *
+     * @param engine The engine
+     * @param program A program on which the engine differs
+     * @return Case A program on which it differs, without removable lines, with the same input
+     */
+    Case shrink(const Engine& engine, const Case& program) {
+        std::vector<std::string> lines = splitLines(program.source);
+        Case candidate = program;
+
+        for (size_t chunk = std::max<size_t>(lines.size() / 2, 1); chunk > 0;) {
+            bool removed = false;
+            for (size_t start = 0; start < lines.size();) {
+                std::vector<std::string> kept(lines.begin(), lines.begin() + start);
+                kept.insert(kept.end(), lines.begin() + std::min(start + chunk, lines.size()), lines.end());
+                candidate.source = joinLines(kept);
+                if (differs(engine, candidate)) {
+                    lines = std::move(kept);
+                    removed = true;
+                } else {
+                    start += (chunk > 2) ? chunk : 1; // small chunks at every offset: push/pop pairs
+                }
+            }
+            if (!removed) {
+                chunk /= 2;
+            }
+        }
+        candidate.source = joinLines(lines);
+        return candidate;
+    }
+
+    /**
+     * @brief Makes output readable in reports: bytes other than printable ASCII and newlines as \\xNN.
+     * @param text The output
+     * @return std::string The escaped output
+     */
+    std::string escape(const std::string& text) {
+        static const char digits[] = "0123456789abcdef";
+        std::string escaped;
+
+        for (char c : text) {
+            auto byte = static_cast<unsigned char>(c);
+            if (c == '\n' || (byte >= 0x20 && byte < 0x7f && c != '\\')) {
+                escaped += c;
+            } else {
+                escaped += std::string("\\x") + digits[byte >> 4] + digits[byte & 0xf];
+            }
+        }
+        return escaped;
+    }
+
+    /**
+     * @brief Prints an outcome, indented.
+     * @param label Name of the engine
+     * @param outcome The outcome
+     */
+    void printOutcome(const std::string& label, const Outcome& outcome) {
+        const std::string output = escape(outcome.output);
+        const std::pair<const char*, const std::string*> fields[] = {
+            {"stdout", &output}, {"stderr", &outcome.errors},
+            {"error", &outcome.error}, {"stacks", &outcome.stacks}};
+
+        std::cout << "  " << label << ":" << std::endl;
+        for (const auto& [name, text] : fields) {
+            std::cout << "    " << name << ":";
+            for (const std::string& line : splitLines(*text)) {
+                std::cout << "\n      " << line;
+            }
+            std::cout << std::endl;
+        }
+    }
+
+    /**
+     * @struct Totals
+     * @brief Counts printed at the end of the run.
+     */
+    struct Totals {
+        size_t programs = 0;    ///< Programs checked
+        size_t errors = 0;      ///< Programs raising an error on the reference engine
+        size_t skipped = 0;     ///< Runs of engines not accepting the program
+        size_t mismatches = 0;  ///< Runs differing from the reference
+    };
+
+    /**
+     * @brief Runs a program on every engine and reports the differences.
+     * @param name Name of the program in reports
+     * @param program The program and what it runs with
+     * @param totals Counts updated with the program
+     */
+    void check(const std::string& name, const Case& program, Totals& totals) {
+        Outcome reference = run(engines[0], program);
+
+        ++totals.programs;
+        totals.errors += !reference.error.empty();
+        for (const Engine& engine : engines) {
+            Outcome outcome = run(engine, program);
+            totals.skipped += outcome.skipped;
+            if (outcome.skipped || outcome == reference) {
+                continue;
+            }
+
+            ++totals.mismatches;
+            Case minimal = shrink(engine, program);
+            std::cout << "MISMATCH " << name << " on " << engine.name << std::endl
+                      << "  dump format: " << formatName(minimal.format) << std::endl
+                      << "  input: " << escape(minimal.input) << std::endl;
+            for (const auto& [binding, value] : minimal.bindings) {
+                std::cout << "  $" << binding << " = " << value << std::endl;
+            }
+            std::cout << "  minimal program:" << std::endl;
+            for (const std::string& line : splitLines(minimal.source)) {
+                std::cout << "    " << line << std::endl;
+            }
+            Outcome expected = run(engines[0], minimal);
+            Outcome actual = run(engine, minimal);
+            auto first = std::mismatch(expected.output.begin(), expected.output.end(), actual.output.begin(),
+                                       actual.output.end());
+            if (first.first != expected.output.end() || first.second != actual.output.end()) {
+                std::cout << "  stdout differs at byte " << (first.first - expected.output.begin()) << std::endl;
+            }
+            printOutcome(engines[0].name, expected);
+            printOutcome(engine.name, actual);
+        }
+    }
+
+    /**
+     * @class Generator
+     * @brief Generates random programs using most of the instructions.
+     *
+     * Stack depths are tracked so that most instructions succeed, but
+     * programs also hit overflows, divisions by zero, failed assertions and
+     * missing exits. Half of the programs only use the instructions of the
+     * batch or register engines, which fall back to the reference loop (or
+     * are skipped) on the others. Each program also draws its dump format, an
+     * input stream for 'read' (up to 256 random bytes, mostly small) and values for the
+     * placeholders $a, $b and $c, some of which are left unbound.
+     */
+    class Generator {
+    public:
+        /**
+         * @enum eProfile
+         * @brief Instructions a generated program may use.
+         */
+        enum class eProfile {
+            Batch,      ///< Stack and arithmetic instructions, without output
+            Register,   ///< The same plus dump and print
+            Full        ///< All the instructions
+        };
+
+        /**
+         * @brief Constructor.
+         * @param seed Seed of the random sequence
+         */
+        explicit Generator(unsigned seed)
+            : _random(seed) {
+        }
+
+        /**
+         * @brief Generates a program.
+         * @param length Approximate number of instructions
+         * @return Case The program and what it runs with
+         */
+        Case generate(size_t length) {
+            static const eDumpFormat formats[] = {eDumpFormat::Binary, eDumpFormat::Jsonl, eDumpFormat::Csv};
+            Case program;
+
+            _lines.clear();
+            _depth = {0, 0};
+            _current = 0;
+            _savepoints = 0;
+            _forks = 0;
+            _profile = static_cast<eProfile>(std::min(number(0, 3), 2LL)); // a quarter, a quarter, half
+
+            if (_profile == eProfile::Full && chance(0.1)) {
+                // Errors are handled: the program is not optimised
+                add("onerror");
+                add("pop");
+                add("endonerror");
+            }
+            while (_lines.size() < length) {
+                step();
+            }
+            for (; _forks > 0; --_forks) {
+                add("join");
+                _depth[_current] += 2;
+            }
+            if (chance(0.9)) {
+                add("exit");
+            }
+            program.source = joinLines(_lines);
+
+            if (chance(0.45)) {
+                program.format = formats[number(0, 2)];
+            }
+            for (long long size = chance(0.05) ? 0 : number(1, 256); size > 0; --size) {
+                program.input += static_cast<char>(chance(0.7) ? number(0, 3) : number(0, 255));
+            }
+            for (const char* name : {"a", "b", "c"}) {
+                if (chance(0.97)) {
+                    program.bindings.emplace_back(name, bound());
+                }
+            }
+            return program;
+        }
+
+    private:
+        std::mt19937 _random;                   ///< Random sequence
+        std::vector<std::string> _lines;        ///< Program being generated
+        std::vector<size_t> _depth;             ///< Depth of main and aux
+        size_t _current;                        ///< Stack in use (0 main, 1 aux)
+        size_t _savepoints;                     ///< Open savepoints
+        size_t _forks;                          ///< Forks not joined yet
+        eProfile _profile;                      ///< Instructions used by the program
+
+        /**
+         * @brief Draws a number.
+         * @param low Smallest value
+         * @param high Largest value
+         * @return long long The number
+         */
+        long long number(long long low, long long high) {
+            return std::uniform_int_distribution<long long>(low, high)(_random);
+        }
+
+        /**
+         * @brief Draws an event.
+         * @param probability Its probability
+         * @return bool True if it happens
+         */
+        bool chance(double probability) {
+            return std::uniform_real_distribution<double>(0.0, 1.0)(_random) < probability;
+        }
+
+        /**
+         * @brief Appends a line.
+         * @param line The line
+         */
+        void add(const std::string& line) {
+            _lines.push_back(line);
+        }
+
+        /**
+         * @brief Draws a typed literal, sometimes near the limits of its type.
+         * @return std::string The literal, such as int16(-300)
+         */
+        std::string literal() {
+            static const char* const types[] = {"int8", "int16", "int32", "float", "double"};
+            static const long long limits[] = {127, 32767, 2147483647};
+            size_t type = static_cast<size_t>(number(0, 4));
+
+            if (type < 3) {
+                long long limit = limits[type];
+                long long value = chance(0.05) ? (chance(0.5) ? limit - number(0, 2) : -limit - number(0, 1))
+                                              : number(-std::min(limit, 1000LL), std::min(limit, 1000LL));
+                return std::string(types[type]) + "(" + std::to_string(value) + ")";
+            }
+            std::ostringstream value;
+            value.precision(static_cast<int>(number(1, 9)));
+            value << std::fixed << static_cast<double>(number(-1000000, 1000000)) / std::pow(10.0, number(0, 6));
+            return std::string(types[type]) + "(" + value.str() + ")";
+        }
+
+        /**
+         * @brief Draws a value for a placeholder.
+         * @return std::string The value, an integer or a decimal, as given to --set
+         */
+        std::string bound() {
+            if (chance(0.5)) {
+                return std::to_string(number(-100, 100));
+            }
+            std::ostringstream value;
+            value.precision(static_cast<int>(number(1, 4)));
+            value << std::fixed << static_cast<double>(number(-10000, 10000)) / 100.0;
+            return value.str();
+        }
+
+        /**
+         * @brief Draws a push, sometimes of a placeholder or of the input stream.
+         * @return std::string The instruction, such as push int16(-300), push double($b) or read int8
+         */
+        std::string push() {
+            static const char* const types[] = {"int8", "int16", "int32", "float", "double"};
+            long long kind = number(0, 99);
+
+            if (kind < 8) {
+                return std::string("push ") + types[number(0, 4)] + "($" + static_cast<char>('a' + number(0, 2)) + ")";
+            }
+            if (kind < 16 && _profile != eProfile::Batch) {
+                return std::string("read ") + types[number(0, 4)];
+            }
+            return "push " + literal();
+        }
+
+        /**
+         * @brief Checks if the profile of the program allows a kind of step.
+         * @param kind The kind drawn by step()
+         * @return bool False if a push is appended instead
+         */
+        bool allowed(long long kind) const {
+            switch (_profile) {
+                case eProfile::Batch:
+                    return kind < 65 || (kind >= 75 && kind < 77) || kind >= 93;
+                case eProfile::Register:
+                    return kind < 69 || (kind >= 72 && kind < 77) || kind >= 93;
+                case eProfile::Full:
+                    break;
+            }
+            return true;
+        }
+
+        /**
+         * @brief Appends one instruction or block.
+         */
+        void step() {
+            size_t& depth = _depth[_current];
+            long long kind = number(0, 99);
+
+            // Asserts of drawn values and mistakes end the program: keep them rare
+            bool fails = (kind >= 75 && kind < 77) || kind >= 93;
+            if (depth < 2 || kind < 30 || !allowed(kind) || (fails && !chance(0.1))) {
+                add(push());
+                ++depth;
+            } else if (kind < 60) {
+                static const char* const operations[] = {"add", "sub", "mul", "div", "mod", "add", "mul"};
+                add(operations[number(0, 6)]);
+                --depth;
+            } else if (kind < 65) {
+                add("pop");
+                --depth;
+            } else if (kind < 69) {
+                add(chance(0.5) ? "dump" : "dump " + std::to_string(number(0, static_cast<long long>(depth))));
+            } else if (kind < 72) {
+                add("dumpdelta");
+            } else if (kind < 75) {
+                add("push int8(" + std::to_string(number(32, 126)) + ")");
+                add("print");
+                ++depth;
+            } else if (kind < 77) {
+                add("assert " + literal());
+            } else if (kind < 81) {
+                // Named stacks
+                size_t other = 1 - _current;
+                if (chance(0.5)) {
+                    size_t count = static_cast<size_t>(number(0, static_cast<long long>(depth)));
+                    add(std::string("move ") + (_current ? "aux main " : "main aux ") + std::to_string(count));
+                    depth -= count;
+                    _depth[other] += count;
+                } else {
+                    add(other ? "use aux" : "use main");
+                    _current = other;
+                }
+            } else if (kind < 86) {
+                if (_savepoints > 0 && chance(0.6)) {
+                    add(chance(0.5) ? "commit" : "rollback");
+                    --_savepoints;
+                    _depth = {0, 0}; // unknown after a rollback: push before using
+                } else {
+                    add("savepoint");
+                    ++_savepoints;
+                }
+            } else if (kind < 90 && depth >= 2) {
+                // The child multiplies its two values and adds a constant
+                // A dumping child follows a dump of the parent, which may still be queued;
+                // it is joined at once, which needs no older fork pending
+                bool dumps = _forks == 0 && chance(0.3);
+                if (dumps) {
+                    add("dump");
+                }
+                add("fork 2");
+                add("mul");
+                add("push " + literal());
+                add("add");
+                if (dumps) {
+                    add("dump");
+                }
+                add("endfork");
+                depth -= 2;
+                if (dumps) {
+                    add("join");
+                    ++depth;
+                } else {
+                    ++_forks;
+                }
+            } else if (kind < 93 && _forks > 0) {
+                add("join");
+                ++depth;
+                --_forks;
+            } else {
+                static const char* const mistakes[] = {"pop", "add", "assert int32(0)", "div"};
+                add(mistakes[number(0, 3)]);
+            }
+        }
+    };
+}
+
+int main(int argc, char** argv) {
+    size_t randomCount = 200;
+    unsigned seed = 1;
+    size_t length = 40;
+    std::vector<std::string> files;
+
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+
+        if (arg == "--random" && i + 1 < argc) {
+            randomCount = std::stoul(argv[++i]);
+        } else if (arg == "--seed" && i + 1 < argc) {
+            seed = static_cast<unsigned>(std::stoul(argv[++i]));
+        } else if (arg == "--length" && i + 1 < argc) {
+            length = std::stoul(argv[++i]);
+        } else if (arg.rfind("--", 0) != 0) {
+            files.push_back(arg);
+        } else {
+            std::cerr << "Usage: " << argv[0] << " [--random n] [--seed s] [--length l] [files...]"
+                      << std::endl;
+            return 1;
+        }
+    }
+    if (files.empty() && std::filesystem::is_directory("examples")) {
+        for (const auto& entry : std::filesystem::directory_iterator("examples")) {
+            if (entry.path().extension() == ".avm") {
+                files.push_back(entry.path().string());
+            }
+        }
+        std::sort(files.begin(), files.end());
+    }
+
+    Totals totals;
+    for (const std::string& file : files) {
+        std::ifstream input(file);
+        if (!input.is_open()) {
+            std::cerr << "Error: Unable to open " << file << std::endl;
+            return 1;
+        }
+        std::ostringstream source;
+        source << input.rdbuf();
+        for (eDumpFormat format : {eDumpFormat::Text, eDumpFormat::Binary, eDumpFormat::Jsonl, eDumpFormat::Csv}) {
+            Case program;
+            program.source = source.str();
+            program.path = file;
+            program.format = format;
+            check(file + " (" + formatName(format) + ")", program, totals);
+        }
+    }
+
+    Generator generator(seed);
+    for (size_t index = 0; index < randomCount; ++index) {
+        check("random #" + std::to_string(index) + " (seed " + std::to_string(seed) + ")",
+              generator.generate(length), totals);
+    }
+
+    std::filesystem::remove(inputPath());
+    std::cout << totals.programs << " programs (" << totals.errors << " raising an error), "
+              << std::size(engines) << " engines (" << totals.skipped << " runs skipped): "
+              << totals.mismatches << " mismatch(es)" << std::endl;
+    return totals.mismatches ? 1 : 0;
+}
@@ -0,0 +1,112 @@
+/**
+ * @file dump_bench.cpp
+ * @brief Speedup curve of text dump formatting for 1 to N threads.
+ *
+ * Builds a stack of mixed int32 and double operands, writes it as a text
+ * dump to /dev/null with 1, 2, ... N formatting threads, and checks that
+ * each output is byte-identical to the single-threaded one. Then compares
+ * the cost of the JSON Lines and CSV formats with plain text.
+ *
+ * Usage: dump_bench [values [max threads]]
+ */
+
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <thread>
+#include "AbstractVM.hpp"
+
+namespace {
+    /**
+     * @brief Formats a dump with a number of threads.
+     * @param output The stream written to
+     * @param values The stack values, oldest first
+     * @param threads Number of formatting threads
+     * @param format Text, Jsonl or Csv
+     * @return double Elapsed seconds
+     */
+    double benchDump(std::ostream& output, const OperandBuffer& values, size_t threads,
+                     eDumpFormat format = eDumpFormat::Text) {
+        auto start = std::chrono::steady_clock::now();
+        writeTextDump(output, values.begin(), values.end(), threads, format);
+        auto end = std::chrono::steady_clock::now();
+
+        return std::chrono::duration<double>(end - start).count();
+    }
+
+    /**
+     * @brief Formats a dump in memory.
+     * @param values The stack values, oldest first
+     * @param threads Number of formatting threads
+     * @return std::string The dump
+     */
+    std::string dumpText(const OperandBuffer& values, size_t threads) {
+        std::ostringstream output;
+        writeTextDump(output, values.begin(), values.end(), threads);
+        return output.str();
+    }
+}
+
+int main(int argc, char** argv) {
+    size_t count = argc > 1 ? std::stoul(argv[1]) : 4000000;
+    size_t maxThreads = argc > 2 ? std::stoul(argv[2])
+                                 : std::max(1u, std::thread::hardware_concurrency());
+    OperandFactory factory;
+    OperandBuffer values;
+
+    try {
+        for (size_t index = 0; index < count; ++index) {
+            if (index % 2) {
+                values.push_back(factory.createOperand(eOperandType::Double,
+                                                       std::to_string(index * 0.37 - 1e5)));
+            } else {
+                values.push_back(factory.createOperand(eOperandType::Int32,
+                                                       std::to_string(index * 7919 % 2000003)));
+            }
+        }
+
+        std::string reference = dumpText(values, 1);
+        std::ofstream sink("/dev/null", std::ios::binary);
+        double base = 0;
+
+        std::cout << count << " values, " << reference.size() << " bytes" << std::endl;
+        for (size_t threads = 1; threads <= maxThreads; ++threads) {
+            if (dumpText(values, threads) != reference) {
+                std::cerr << "dump_bench: output differs with " << threads << " threads" << std::endl;
+                return 1;
+            }
+            double seconds = benchDump(sink, values, threads);
+            if (threads == 1) {
+                base = seconds;
+            }
+            std::cout << threads << " thread(s): " << seconds * 1000.0 << " ms, speedup "
+                      << base / seconds << std::endl;
+        }
+
+        // Best of several runs, on one thread
+        const std::pair<const char*, eDumpFormat> formats[] = {
+            {"text", eDumpFormat::Text}, {"jsonl", eDumpFormat::Jsonl}, {"csv", eDumpFormat::Csv}};
+        double text = 0;
+        for (const auto& [name, format] : formats) {
+            double best = benchDump(sink, values, 1, format);
+            for (int run = 1; run < 5; ++run) {
+                best = std::min(best, benchDump(sink, values, 1, format));
+            }
+            if (format == eDumpFormat::Text) {
+                text = best;
+            }
+            std::cout << name << ": " << best * 1000.0 << " ms, " << best / text << " x text"
+                      << std::endl;
+        }
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return 1;
+    }
+
+    for (const IOperand* value : values) {
+        delete value;
+    }
+    return 0;
+}